@@ -21,19 +21,8 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	int numLights;
 } ubo;
 
-layout(set = 1, binding = 0) uniform GameObjectBufferData {
-  mat4 modelMatrix;
-  mat4 normalMatrix;
-} gameObject;
-
-
 layout (set = 1, binding = 1) uniform sampler2D diffuseMap;
 
-layout(push_constant) uniform Push {
-	mat4 modelMatrix;
-	mat3 normalMatrix;
-} push;
-
 void main() { 
 	vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
 	vec3 specularLight = vec3(0.0);
@@ -4,6 +4,8 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 color;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 uv;
+layout(location = 4) in mat4 modelMatrix;
+layout(location = 8) in mat4 normalMatrix;
 
 layout(location = 0) out vec4 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
@@ -24,21 +26,11 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	int numLights;
 } ubo;
 
-layout(set = 1, binding = 0) uniform GameObjectBufferData {
-  mat4 modelMatrix;
-  mat4 normalMatrix;
-} gameObject;
-
-layout(push_constant) uniform Push {
-	mat4 modelMatrix;
-	mat3 normalMatrix;
-} push;
-
 void main() {
-	vec4 positionWorld = gameObject.modelMatrix * vec4(position, 1.0f);
+	vec4 positionWorld = modelMatrix * vec4(position, 1.0f);
   	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * positionWorld;
 
-  	fragNormalWorld = normalize(mat3(gameObject.normalMatrix) * normal);
+  	fragNormalWorld = normalize(mat3(normalMatrix) * normal);
 	fragPosWorld = positionWorld.xyz;
 	fragColor = color;
 	fragUv = uv;
@@ -0,0 +1,55 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragUv;
+
+struct PointLight {
+	vec4 position;
+	vec4 color;
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	mat4 inverseViewMatrix;
+	vec4 ambientLightColor;
+	PointLight pointLights[10];
+	int numLights;
+} ubo;
+
+struct GameObjectBufferData {
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer GameObjectBuffer {
+	GameObjectBufferData objects[];
+} gameObjects;
+
+// object index of each instance of the draw
+layout(std430, set = 1, binding = 1) readonly buffer InstanceBuffer {
+	uint objectIndices[];
+} instances;
+
+layout(push_constant) uniform Push {
+	uint textureIndex;
+} push;
+
+void main() {
+	uint objectIndex = instances.objectIndices[gl_InstanceIndex];
+	GameObjectBufferData gameObject = gameObjects.objects[objectIndex];
+	vec4 positionWorld = gameObject.modelMatrix * vec4(position, 1.0f);
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * positionWorld;
+
+	fragNormalWorld = normalize(mat3(gameObject.normalMatrix) * normal);
+	fragPosWorld = positionWorld.xyz;
+	fragColor = color;
+	fragUv = uv;
+}
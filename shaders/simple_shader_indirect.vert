@@ -0,0 +1,65 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragUv;
+layout(location = 4) flat out uint fragTextureIndex;
+
+struct PointLight {
+	vec4 position;
+	vec4 color;
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	mat4 inverseViewMatrix;
+	vec4 ambientLightColor;
+	PointLight pointLights[10];
+	int numLights;
+} ubo;
+
+struct GameObjectBufferData {
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer GameObjectBuffer {
+	GameObjectBufferData objects[];
+} gameObjects;
+
+struct DrawObject {
+	uint objectIndex;
+	uint textureIndex;
+	uint firstIndex;
+	uint indexCount;
+	int vertexOffset;
+	uint padding0;
+	uint padding1;
+	uint padding2;
+	vec4 boundingSphere;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer DrawObjectBuffer {
+	DrawObject draws[];
+} drawObjects;
+
+void main() {
+	// firstInstance of each indirect draw is the index of its draw object
+	DrawObject draw = drawObjects.draws[gl_InstanceIndex];
+	GameObjectBufferData gameObject = gameObjects.objects[draw.objectIndex];
+	vec4 positionWorld = gameObject.modelMatrix * vec4(position, 1.0f);
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * positionWorld;
+
+	fragNormalWorld = normalize(mat3(gameObject.normalMatrix) * normal);
+	fragPosWorld = positionWorld.xyz;
+	fragColor = color;
+	fragUv = uv;
+	fragTextureIndex = draw.textureIndex;
+}
@@ -18,8 +18,11 @@
 #include "gameobject.h"
 #include "iostream"
 #include "keyboard_movement_controller.h"
+#include "layout_cache.h"
+#include "release_queue.h"
 #include "model.h"
 #include "swapchain.h"
+#include "textures/texture_cache.h"
 #include "window.h"
 
 // std
@@ -54,6 +57,7 @@ Application::Application() {
 Application::~Application() {}
 
 void Application::OnStart() {
+	auto startupTime = std::chrono::high_resolution_clock::now();
 	for (int32_t i = 0; i < uboBuffers.size(); i++) {
 		uboBuffers[i] = std::make_unique<Buffer>(
 			lvrDevice,
@@ -66,26 +70,25 @@ void Application::OnStart() {
 		uboBuffers[i]->map();
 	}
 
-	auto globalSetLayout =
+	// the systems reflect the same layout for set 0 of their shaders and get this one back
+	auto &globalSetLayout = lvrDevice.layoutCache().getSetLayout(
 		DescriptorSetLayout::Builder(lvrDevice)
 			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-			.build();
+			.getBindings());
 
 	for (int32_t i = 0; i < globalDescriptorSets.size(); i++) {
 		auto bufferInfo = uboBuffers[i]->descriptorInfo();
-		DescriptorWriter(*globalSetLayout, *globalPool)
+		DescriptorWriter(globalSetLayout, *globalPool)
 			.writeBuffer(0, &bufferInfo)
 			.build(globalDescriptorSets[i]);
 	}
 	simpleRenderSystem = std::make_unique<SimpleRenderSystem>(
 		lvrDevice,
 		lvrRenderer.getSwapChainRenderPass(),
-		globalSetLayout->getDescriptorSetLayout());
+		gameObjectManager);
 
-	pointLightSystem = std::make_unique<PointLightSystem>(
-		lvrDevice,
-		lvrRenderer.getSwapChainRenderPass(),
-		globalSetLayout->getDescriptorSetLayout());
+	pointLightSystem =
+		std::make_unique<PointLightSystem>(lvrDevice, lvrRenderer.getSwapChainRenderPass());
 
 	// particleSystem =
 	// 	std::make_unique<ParticleSystem>(lvrDevice, lvrRenderer.getSwapChainRenderPass());
@@ -95,9 +98,23 @@ void Application::OnStart() {
 		lvrRenderer.getSwapChainRenderPass(),
 		(VkExtent3D){1280, 720, 1});
 
-	viewerObject.transform.translation.z = -2.5f;
+	viewerObject.translation().z = -2.5f;
 
 	auto currentTime = std::chrono::high_resolution_clock::now();
+	std::cout << "startup: "
+			  << std::chrono::duration<double, std::milli>(currentTime - startupTime).count()
+			  << " ms, " << lvrDevice.getPipelineCreationMs() << " ms of it creating pipelines"
+			  << std::endl;
+	auto layoutStatistics = lvrDevice.layoutCache().getStatistics();
+	std::cout << "layouts: " << layoutStatistics.setLayoutCount << " set layouts for "
+			  << layoutStatistics.setLayoutRequests << " requests, "
+			  << layoutStatistics.pipelineLayoutCount << " pipeline layouts for "
+			  << layoutStatistics.pipelineLayoutRequests << " requests" << std::endl;
+	auto textureStatistics = lvrDevice.textureCache().getStatistics();
+	std::cout << "textures: " << textureStatistics.textureCount << " for "
+			  << textureStatistics.hits + textureStatistics.misses << " loads, "
+			  << textureStatistics.memoryUsage / (1024 * 1024) << " of "
+			  << textureStatistics.budget / (1024 * 1024) << " MiB budget" << std::endl;
 	while (!lvrWIndow.shouldClose()) {
 		auto newTime = std::chrono::high_resolution_clock::now();
 		float frameTime =
@@ -108,19 +125,23 @@ void Application::OnStart() {
 		OnUpdate(frameTime);
 	}
 
+	modelLoader.waitIdle();
 	vkDeviceWaitIdle(lvrDevice.device());
+	// what is still held back may use the systems and pools destroyed before the device
+	lvrDevice.releaseQueue().flush();
 }
 
 void Application::OnUpdate(float dt) {
 	glfwPollEvents();
-	auto oldView = viewerObject.transform;
+	modelLoader.update();
+	auto oldView = viewerObject.getTransform();
 
 	cameraController.moveInPlaneXZ(lvrWIndow.getGLFWWindow(), dt, viewerObject);
-	if ((oldView.translation != viewerObject.transform.translation) ||
-		(oldView.rotation != viewerObject.transform.rotation)) {
+	auto view = viewerObject.getTransform();
+	if ((oldView.translation != view.translation) || (oldView.rotation != view.rotation)) {
 		frameRayIndex = 0;
 	}
-	camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+	camera.setViewYXZ(view.translation, view.rotation);
 
 	float aspect = lvrRenderer.getAspectRatio();
 
@@ -128,8 +149,14 @@ void Application::OnUpdate(float dt) {
 
 	if (auto commandBuffer = lvrRenderer.beginFrame()) {
 		if (auto computeCommandBuffer = computeShaderManager.beginCompute()) {
+			lvrDevice.releaseQueue().update();
+			shaderHotReload.update();
+			lvrDevice.textureCache().update();
 			int32_t frameIndex = lvrRenderer.getFrameIndex();
 			framePools[frameIndex]->resetPool();
+			gpuTimer.collect(frameIndex);
+			gpuTimer.begin(commandBuffer, GpuTimer::Queue::Graphics, frameIndex);
+			gpuTimer.begin(computeCommandBuffer, GpuTimer::Queue::Compute, frameIndex);
 
 			FrameInfo frameInfo{
 				frameIndex,
@@ -138,7 +165,9 @@ void Application::OnUpdate(float dt) {
 				camera,
 				globalDescriptorSets[frameIndex],
 				*framePools[frameIndex],
-				gameObjectManager.gameObjects};
+				gameObjectManager,
+				jobSystem,
+				lvrRenderer.getSecondaryCommandBuffers()};
 
 			// update
 
@@ -148,6 +177,8 @@ void Application::OnUpdate(float dt) {
 			ubo.viewMatrix = camera.getView();
 			if (lvrWIndow.getExtent().width != raytracingSystem->getExtent().width ||
 				lvrWIndow.getExtent().height != raytracingSystem->getExtent().height) {
+				// the last frames' compute and graphics work may still use its images and sets
+				lvrDevice.releaseQueue().retire(std::move(raytracingSystem));
 				raytracingSystem = std::make_unique<RayTracingSystem>(
 					lvrDevice,
 					lvrRenderer.getSwapChainRenderPass(),
@@ -160,69 +191,82 @@ void Application::OnUpdate(float dt) {
 
 			uboBuffers[frameIndex]->writeToBuffer(&ubo);
 			uboBuffers[frameIndex]->flush();
-			gameObjectManager.updateBuffer(frameIndex);
+			gameObjectManager.updateBuffer(frameIndex, jobSystem);
 
-			lvrRenderer.beginSwapChainRenderPass(commandBuffer);
+			// everything uploaded so far goes out in one batch, ahead of the work that reads it
+			lvrDevice.uploadQueue().submit();
+
+			simpleRenderSystem->cullGameObjects(frameInfo);
+			lvrRenderer.beginSwapChainRenderPass(
+				commandBuffer,
+				VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
 			// particleSystem->dispatchCompute(frameInfo, computeCommandBuffer);
 			raytracingSystem->dispatchCompute(frameInfo, computeCommandBuffer);
+			gpuTimer.end(computeCommandBuffer, GpuTimer::Queue::Compute, frameIndex);
 			computeCommandBuffer = computeShaderManager.endCompute();
 			lvrRenderer.submitComputeCommandBuffers(computeCommandBuffer);
 			// particleSystem->renderParticles(frameInfo);
-			raytracingSystem->renderRays(frameInfo);
-
+			// secondaries run in the order they are queued, the lights blend over the objects
+			recordSecondary(frameInfo, [&](FrameInfo& info) { raytracingSystem->renderRays(info); });
 			simpleRenderSystem->renderGameObjects(frameInfo);
-			pointLightSystem->render(frameInfo);
+			recordSecondary(frameInfo, [&](FrameInfo& info) { pointLightSystem->render(info); });
 			lvrRenderer.endSwapChainRenderPass(commandBuffer);
+			gpuTimer.end(commandBuffer, GpuTimer::Queue::Graphics, frameIndex);
 			lvrRenderer.endFrame();
 		}
 	}
 	frameRayIndex++;
 }
 
-void Application::loadGameObjects() {
-	std::shared_ptr<Model> smoothModel =
-		Model::createModelFromFile(lvrDevice, "models/smooth_vase.obj");
+void Application::recordSecondary(
+	FrameInfo& frameInfo, const std::function<void(FrameInfo&)>& record) {
+	auto& secondaryCommandBuffers = frameInfo.secondaryCommandBuffers;
+	FrameInfo secondaryFrameInfo = frameInfo;
+	secondaryFrameInfo.commandBuffer = secondaryCommandBuffers.begin(jobSystem.getThreadIndex());
+	record(secondaryFrameInfo);
+	secondaryCommandBuffers.end(secondaryFrameInfo.commandBuffer);
+	secondaryCommandBuffers.add(secondaryFrameInfo.commandBuffer);
+}
 
-	auto& smoothObject = gameObjectManager.createGameObject();
-	smoothObject.model = smoothModel;
-	smoothObject.transform.translation = {-0.5f, 0.5f, 0.0f};
-	smoothObject.transform.scale = {0.5f, 0.5f, 0.5f};
+void Application::streamModel(GameObject gameObject, const std::string& filepath) {
+	// the model shows up a few frames after this call, the object may have been destroyed by then
+	modelLoader.loadAsync(filepath, [this, gameObject](std::shared_ptr<Model> model) mutable {
+		if (gameObjectManager.isAlive(gameObject)) {
+			gameObject.model() = std::move(model);
+		}
+	});
+}
 
-	std::shared_ptr<Model> flatModel =
-		Model::createModelFromFile(lvrDevice, "models/flat_vase.obj");
+void Application::loadGameObjects() {
+	auto smoothObject = gameObjectManager.createGameObject();
+	streamModel(smoothObject, "models/smooth_vase.obj");
+	smoothObject.translation() = {-0.5f, 0.5f, 0.0f};
+	smoothObject.scale() = {0.5f, 0.5f, 0.5f};
 
 	std::shared_ptr<Texture> marbleTexture =
 		Texture::createTextureFromFile(lvrDevice, "textures/missing.png");
-	auto& flatObject = gameObjectManager.createGameObject();
-	flatObject.model = flatModel;
-	flatObject.diffuseMap = marbleTexture;
-	flatObject.transform.translation = {0.5f, 0.5f, 0.0f};
-	flatObject.transform.scale = {0.5f, 0.5f, 0.5f};
-
-	std::shared_ptr<Model> cubeModel =
-		Model::createModelFromFile(lvrDevice, "models/colored_cube.obj");
-
-	auto& cubeObject = gameObjectManager.createGameObject();
-	cubeObject.model = cubeModel;
-	cubeObject.transform.translation = {0.0f, 1.0f, 0.0f};
-	cubeObject.transform.scale = {0.5f, 0.5f, 0.5f};
-
-	std::shared_ptr<Model> quadModel = Model::createModelFromFile(lvrDevice, "models/quad.obj");
-
-	auto& quadObject = gameObjectManager.createGameObject();
-	quadObject.model = quadModel;
-	quadObject.transform.translation = {0.0f, 0.5f, 0.0f};
-	quadObject.transform.scale = {1.5f, 1.5f, 1.5f};
-
-	std::shared_ptr<Model> humanModel =
-		Model::createModelFromFile(lvrDevice, "models/FinalBaseMesh.obj");
-
-	auto& humanObject = gameObjectManager.createGameObject();
-	humanObject.model = humanModel;
-	humanObject.transform.translation = {0.0f, 0.5f, 0.0f};
-	humanObject.transform.rotation = {0.0f, 0.0f, 0.5 * glm::two_pi<float>()};
-	humanObject.transform.scale = {0.1f, 0.1f, 0.1};
+	auto flatObject = gameObjectManager.createGameObject();
+	streamModel(flatObject, "models/flat_vase.obj");
+	flatObject.diffuseMap() = marbleTexture;
+	flatObject.translation() = {0.5f, 0.5f, 0.0f};
+	flatObject.scale() = {0.5f, 0.5f, 0.5f};
+
+	auto cubeObject = gameObjectManager.createGameObject();
+	streamModel(cubeObject, "models/colored_cube.obj");
+	cubeObject.translation() = {0.0f, 1.0f, 0.0f};
+	cubeObject.scale() = {0.5f, 0.5f, 0.5f};
+
+	auto quadObject = gameObjectManager.createGameObject();
+	streamModel(quadObject, "models/quad.obj");
+	quadObject.translation() = {0.0f, 0.5f, 0.0f};
+	quadObject.scale() = {1.5f, 1.5f, 1.5f};
+
+	auto humanObject = gameObjectManager.createGameObject();
+	streamModel(humanObject, "models/FinalBaseMesh.obj");
+	humanObject.translation() = {0.0f, 0.5f, 0.0f};
+	humanObject.rotation() = {0.0f, 0.0f, 0.5 * glm::two_pi<float>()};
+	humanObject.scale() = {0.1f, 0.1f, 0.1};
 
 	std::vector<glm::vec3> lightColors{
 		{1.f, .1f, .1f},
@@ -234,15 +278,14 @@ void Application::loadGameObjects() {
 	};
 
 	for (int32_t i = 0; i < lightColors.size(); i++) {
-		auto& pointLight = gameObjectManager.makePointLight(0.2f);
-		pointLight.color = glm::vec4(lightColors[i], 1.0f);
+		auto pointLight = gameObjectManager.makePointLight(0.2f);
+		pointLight.color() = glm::vec4(lightColors[i], 1.0f);
 		auto rotateLight = glm::rotate(
 			glm::mat4(1.0f),
 			(i * glm::two_pi<float>()) / lightColors.size(),
 			{0.0f, -1.0f, 0.0f});
 
-		pointLight.transform.translation =
-			glm::vec3(rotateLight * glm::vec4(-1.0f, -1.0f, -1.0f, 1.0f));
+		pointLight.translation() = glm::vec3(rotateLight * glm::vec4(-1.0f, -1.0f, -1.0f, 1.0f));
 	}
 }
 
@@ -8,19 +8,25 @@
 #include "descriptors.h"
 #include "device.h"
 #include "gameobject.h"
+#include "gpu_timer.h"
 #include "keyboard_movement_controller.h"
+#include "model_loader.h"
 #include "renderer.h"
 #include "shaders/compute_shader_manager.h"
+#include "shaders/shader_hot_reload.h"
 #include "shaders/systems/particle_system.h"
 #include "shaders/systems/point_light_system.h"
 #include "shaders/systems/ray_tracing_system.h"
 #include "shaders/systems/simplerendersystem.h"
 #include "swapchain.h"
+#include "utils/job_system.h"
 #include "window.h"
 
 // std
 
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace lvr {
@@ -41,22 +47,31 @@ class Application {
 
    private:
 	void loadGameObjects();
+	void streamModel(GameObject gameObject, const std::string& filepath);
+	// Records `record` into a secondary command buffer of this thread and queues it for the
+	// render pass
+	void recordSecondary(FrameInfo& frameInfo, const std::function<void(FrameInfo&)>& record);
 
 	Window lvrWIndow{WIDTH, HEIGHT, "LVR"};
 	Device lvrDevice{lvrWIndow};
-	Renderer lvrRenderer{lvrWIndow, lvrDevice};
+	ModelLoader modelLoader{lvrDevice};
+	utils::JobSystem jobSystem{};
+	Renderer lvrRenderer{lvrWIndow, lvrDevice, jobSystem.getThreadCount()};
 	ComputeShaderManager computeShaderManager{lvrDevice};
+	GpuTimer gpuTimer{lvrDevice};
 	std::unique_ptr<SimpleRenderSystem> simpleRenderSystem;
 	std::unique_ptr<PointLightSystem> pointLightSystem;
 	// std::unique_ptr<ParticleSystem> particleSystem;
 	std::unique_ptr<RayTracingSystem> raytracingSystem;
+	// destroyed before the systems, stops rebuilding their pipelines first
+	ShaderHotReload shaderHotReload{lvrDevice};
 
 	std::unique_ptr<DescriptorPool> globalPool{};
 	std::vector<std::unique_ptr<DescriptorPool>> framePools;
 	GameObjectManager gameObjectManager{lvrDevice};
 	Camera camera{};
 
-	GameObject& viewerObject = gameObjectManager.createGameObject();
+	GameObject viewerObject = gameObjectManager.createGameObject();
 
 	KeyboardMovementController cameraController{};
 
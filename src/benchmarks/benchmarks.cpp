@@ -0,0 +1,43 @@
+#include "benchmarks.h"
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace lvr::benchmarks {
+
+namespace {
+
+const std::vector<std::pair<std::string, std::function<void()>>> &getBenchmarks() {
+	static const std::vector<std::pair<std::string, std::function<void()>>> benchmarks{
+		{"mesh_cache", runMeshCache},
+		{"vertex_dedup", runVertexDedup},
+		{"game_objects", runGameObjects},
+		{"transforms", runTransforms},
+	};
+	return benchmarks;
+}
+
+}  // namespace
+
+bool run(const std::string &name) {
+	bool found = false;
+	for (const auto &[benchmarkName, benchmark] : getBenchmarks()) {
+		if (name == "all" || name == benchmarkName) {
+			std::cout << "== " << benchmarkName << " ==" << std::endl;
+			benchmark();
+			found = true;
+		}
+	}
+	return found;
+}
+
+void listBenchmarks() {
+	std::cout << "Available benchmarks: all";
+	for (const auto &[benchmarkName, benchmark] : getBenchmarks()) {
+		std::cout << ", " << benchmarkName;
+	}
+	std::cout << std::endl;
+}
+
+}  // namespace lvr::benchmarks
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace lvr::benchmarks {
+
+// Runs the named benchmark (or every benchmark for "all"), returns false for unknown names.
+bool run(const std::string &name);
+void listBenchmarks();
+
+void runMeshCache();
+void runVertexDedup();
+void runGameObjects();
+void runTransforms();
+
+// Average wall time in milliseconds of `iterations` calls to `fn`, after one warm up call.
+template <typename Fn>
+double measureMs(uint32_t iterations, Fn &&fn) {
+	fn();
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; i++) {
+		fn();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+}  // namespace lvr::benchmarks
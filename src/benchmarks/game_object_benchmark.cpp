@@ -0,0 +1,107 @@
+#include <vulkan/vulkan_core.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "benchmarks.h"
+#include "device.h"
+#include "gameobject.h"
+#include "swapchain.h"
+#include "utils/job_system.h"
+#include "window.h"
+
+namespace lvr::benchmarks {
+
+namespace {
+
+template <typename Fn>
+double elapsedMs(Fn &&fn) {
+	auto start = std::chrono::high_resolution_clock::now();
+	fn();
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}  // namespace
+
+// Creation, per frame buffer upload and destroy/recreate churn of game objects past the initial
+// object buffer capacity, so the timings include the buffer growth.
+void runGameObjects() {
+	Window window{320, 240, "LVR benchmark"};
+	Device device{window};
+	utils::JobSystem jobSystem{};
+	constexpr uint32_t iterations = 20;
+	std::cout << "update threads: " << jobSystem.getThreadCount() << std::endl;
+
+	for (uint32_t count : {1000u, 10000u, 100000u}) {
+		GameObjectManager gameObjectManager{device};
+		std::vector<GameObject> gameObjects{};
+		gameObjects.reserve(count);
+
+		double createMs = elapsedMs([&]() {
+			for (uint32_t i = 0; i < count; i++) {
+				auto gameObject = gameObjectManager.createGameObject();
+				gameObject.translation() = {static_cast<float>(i % 100), 0.0f, i / 100.0f};
+				gameObjects.push_back(gameObject);
+			}
+		});
+
+		// first upload per frame grows the buffers, keep that out of the steady state timing
+		for (int frame = 0; frame < SwapChain::MAX_FRAMES_IN_FLIGHT; frame++) {
+			gameObjectManager.updateBuffer(frame, jobSystem);
+		}
+		int frameIndex = 0;
+		double staticMs = measureMs(iterations, [&]() {
+			gameObjectManager.updateBuffer(frameIndex, jobSystem);
+			frameIndex = (frameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+		});
+		// every tenth object moves each frame
+		uint32_t written = 0;
+		double movingMs = measureMs(iterations, [&]() {
+			for (uint32_t i = 0; i < count; i += 10) {
+				gameObjects[i].rotation().y += 0.01f;
+			}
+			gameObjectManager.updateBuffer(frameIndex, jobSystem);
+			written = gameObjectManager.getUpdateStatistics().objectsWritten;
+			frameIndex = (frameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+		});
+		double fullMs = measureMs(iterations, [&]() {
+			for (uint32_t i = 0; i < count; i++) {
+				gameObjectManager.markTransformDirty(i);
+			}
+			gameObjectManager.updateBuffer(frameIndex, jobSystem);
+			frameIndex = (frameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+		});
+
+		double churnMs = elapsedMs([&]() {
+			for (uint32_t i = 0; i < count; i += 2) {
+				gameObjectManager.destroyGameObject(gameObjects[i]);
+			}
+			for (uint32_t i = 0; i < count; i += 2) {
+				gameObjects[i] = gameObjectManager.createGameObject();
+			}
+		});
+
+		char line[256];
+		snprintf(
+			line,
+			sizeof(line),
+			"%7u objects  create %8.3f ms  update static %7.3f ms  moving %7.3f ms (%u written)  "
+			"all %7.3f ms  churn %8.3f ms  capacity %u",
+			count,
+			createMs,
+			staticMs,
+			movingMs,
+			written,
+			fullMs,
+			churnMs,
+			gameObjectManager.getCapacity(0));
+		std::cout << line << std::endl;
+	}
+
+	device.uploadQueue().submit();
+	vkDeviceWaitIdle(device.device());
+}
+
+}  // namespace lvr::benchmarks
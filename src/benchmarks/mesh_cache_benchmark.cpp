@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "benchmarks.h"
+#include "mesh_cache.h"
+#include "model.h"
+
+namespace lvr::benchmarks {
+
+// Compares a cold OBJ parse + dedup against mapping the binary mesh cache for the bundled models.
+// The cached path touches every vertex so the page faults of the mapping are part of the timing.
+void runMeshCache() {
+	const std::vector<std::string> models{
+		"models/smooth_vase.obj",
+		"models/flat_vase.obj",
+		"models/colored_cube.obj",
+		"models/quad.obj",
+		"models/FinalBaseMesh.obj"};
+	constexpr uint32_t iterations = 5;
+
+	for (const auto &path : models) {
+		if (!std::filesystem::exists(path)) {
+			std::cout << path << ": missing, skipped" << std::endl;
+			continue;
+		}
+
+		Model::Builder builder{};
+		double objMs = measureMs(iterations, [&]() { builder.loadModel(path); });
+		MeshCache::store(path, builder.vertices, builder.indices);
+
+		size_t cachedVertices = 0;
+		volatile float sink = 0.0f;
+		double cachedMs = measureMs(iterations, [&]() {
+			auto cached = MeshCache::load(path);
+			if (!cached) return;
+			cachedVertices = cached->vertices().size();
+			float sum = 0.0f;
+			for (const auto &vertex : cached->vertices()) {
+				sum += vertex.position.x;
+			}
+			sink = sum;
+		});
+
+		if (cachedVertices != builder.vertices.size()) {
+			std::cout << path << ": cache mismatch (" << cachedVertices << " vs "
+					  << builder.vertices.size() << " vertices)" << std::endl;
+			continue;
+		}
+
+		char line[256];
+		snprintf(
+			line,
+			sizeof(line),
+			"%-28s %9zu verts  obj %9.3f ms  cached %8.3f ms  x%.1f",
+			path.c_str(),
+			builder.vertices.size(),
+			objMs,
+			cachedMs,
+			cachedMs > 0.0 ? objMs / cachedMs : 0.0);
+		std::cout << line << std::endl;
+	}
+}
+
+}  // namespace lvr::benchmarks
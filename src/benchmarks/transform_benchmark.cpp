@@ -0,0 +1,76 @@
+#include <glm/gtc/constants.hpp>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "benchmarks.h"
+#include "gameobject.h"
+#include "transform_kernel.h"
+
+namespace lvr::benchmarks {
+
+// Throughput of building model and normal matrices for a million random transforms: the per object
+// TransformComponent calls updateBuffer used to make, the scalar batch and the SIMD batch.
+void runTransforms() {
+	constexpr uint32_t count = 1'000'000;
+	constexpr uint32_t iterations = 10;
+
+	std::mt19937 random{42};
+	std::uniform_real_distribution<float> position{-100.0f, 100.0f};
+	std::uniform_real_distribution<float> angle{-glm::pi<float>(), glm::pi<float>()};
+	std::uniform_real_distribution<float> size{0.1f, 4.0f};
+	std::vector<glm::vec3> translations(count);
+	std::vector<glm::vec3> rotations(count);
+	std::vector<glm::vec3> scales(count);
+	for (uint32_t i = 0; i < count; i++) {
+		translations[i] = {position(random), position(random), position(random)};
+		rotations[i] = {angle(random), angle(random), angle(random)};
+		scales[i] = {size(random), size(random), size(random)};
+	}
+	std::vector<GameObjectBufferData> matrices(count);
+
+	double componentMs = measureMs(iterations, [&]() {
+		for (uint32_t i = 0; i < count; i++) {
+			TransformComponent transform{translations[i], scales[i], rotations[i]};
+			matrices[i].modelMatrix = transform.mat4();
+			matrices[i].normalMatrix = transform.normalMatrix();
+		}
+	});
+	double scalarMs = measureMs(iterations, [&]() {
+		computeTransformMatricesScalar(
+			translations.data(),
+			rotations.data(),
+			scales.data(),
+			count,
+			matrices.data(),
+			sizeof(GameObjectBufferData));
+	});
+	double batchMs = measureMs(iterations, [&]() {
+		computeTransformMatrices(
+			translations.data(),
+			rotations.data(),
+			scales.data(),
+			count,
+			matrices.data(),
+			sizeof(GameObjectBufferData));
+	});
+
+	auto print = [&](const char *name, double ms) {
+		char line[256];
+		snprintf(
+			line,
+			sizeof(line),
+			"%-22s %8.3f ms per million  %7.1f M transforms/s  x%.2f",
+			name,
+			ms,
+			count / (ms * 1000.0),
+			ms > 0.0 ? componentMs / ms : 0.0);
+		std::cout << line << std::endl;
+	};
+	print("TransformComponent", componentMs);
+	print("batch scalar", scalarMs);
+	print(hasSimdTransformKernel() ? "batch avx2" : "batch (no avx2 build)", batchMs);
+}
+
+}  // namespace lvr::benchmarks
@@ -0,0 +1,161 @@
+#include <glm/gtx/hash.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "benchmarks.h"
+#include "model.h"
+#include "tiny_obj_loader.h"
+#include "utils/utils.h"
+
+namespace lvr::benchmarks {
+
+namespace {
+
+struct LegacyVertexHash {
+	size_t operator()(const Model::Vertex &vertex) const {
+		size_t seed = 0;
+		utils::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+		return seed;
+	}
+};
+
+// The per index std::unordered_map<Vertex, uint32_t> dedup that Model::Builder used to run,
+// kept as the reference for both timing and output equality.
+void legacyDeduplicate(
+	const tinyobj::attrib_t &attrib,
+	const std::vector<tinyobj::shape_t> &shapes,
+	Model::Builder &builder) {
+	builder.vertices.clear();
+	builder.indices.clear();
+
+	std::unordered_map<Model::Vertex, uint32_t, LegacyVertexHash> uniqueVertices{};
+	for (const auto &shape : shapes) {
+		for (const auto &index : shape.mesh.indices) {
+			Model::Vertex vertex{};
+			if (index.vertex_index >= 0) {
+				vertex.position = {
+					attrib.vertices[3 * index.vertex_index + 0],
+					attrib.vertices[3 * index.vertex_index + 1],
+					attrib.vertices[3 * index.vertex_index + 2]};
+				vertex.color = {
+					attrib.colors[3 * index.vertex_index + 0],
+					attrib.colors[3 * index.vertex_index + 1],
+					attrib.colors[3 * index.vertex_index + 2],
+					1.0f};
+			}
+			if (index.normal_index >= 0) {
+				vertex.normal = {
+					attrib.normals[3 * index.normal_index + 0],
+					attrib.normals[3 * index.normal_index + 1],
+					attrib.normals[3 * index.normal_index + 2]};
+			}
+			if (index.texcoord_index >= 0) {
+				vertex.uv = {
+					attrib.texcoords[2 * index.texcoord_index + 0],
+					attrib.texcoords[2 * index.texcoord_index + 1],
+				};
+			}
+
+			if (uniqueVertices.count(vertex) == 0) {
+				uniqueVertices[vertex] = static_cast<uint32_t>(builder.vertices.size());
+				builder.vertices.push_back(vertex);
+			}
+			builder.indices.push_back(uniqueVertices[vertex]);
+		}
+	}
+}
+
+// Regular grid of quads with shared positions, normals and uvs, roughly the index layout of a
+// large scanned mesh.
+void makeGrid(uint32_t size, tinyobj::attrib_t &attrib, std::vector<tinyobj::shape_t> &shapes) {
+	for (uint32_t y = 0; y <= size; y++) {
+		for (uint32_t x = 0; x <= size; x++) {
+			attrib.vertices.insert(
+				attrib.vertices.end(),
+				{static_cast<float>(x), 0.0f, static_cast<float>(y)});
+			attrib.colors.insert(attrib.colors.end(), {1.0f, 1.0f, 1.0f});
+			attrib.texcoords.insert(
+				attrib.texcoords.end(),
+				{static_cast<float>(x) / size, static_cast<float>(y) / size});
+		}
+	}
+	attrib.normals = {0.0f, 1.0f, 0.0f};
+
+	shapes.resize(1);
+	auto &indices = shapes[0].mesh.indices;
+	indices.reserve(static_cast<size_t>(size) * size * 6);
+	auto corner = [&](uint32_t x, uint32_t y) {
+		int index = static_cast<int>(y * (size + 1) + x);
+		indices.push_back({index, 0, index});
+	};
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			corner(x, y);
+			corner(x + 1, y);
+			corner(x + 1, y + 1);
+			corner(x, y);
+			corner(x + 1, y + 1);
+			corner(x, y + 1);
+		}
+	}
+}
+
+void compare(
+	const std::string &name,
+	const tinyobj::attrib_t &attrib,
+	const std::vector<tinyobj::shape_t> &shapes,
+	uint32_t iterations) {
+	Model::Builder legacy{};
+	Model::Builder current{};
+	double legacyMs =
+		measureMs(iterations, [&]() { legacyDeduplicate(attrib, shapes, legacy); });
+	double currentMs = measureMs(iterations, [&]() { current.buildFromObj(attrib, shapes); });
+
+	bool identical =
+		legacy.indices == current.indices && legacy.vertices == current.vertices;
+
+	char line[256];
+	snprintf(
+		line,
+		sizeof(line),
+		"%-28s %10zu idx  legacy %9.3f ms  flat %9.3f ms  x%.1f  %s",
+		name.c_str(),
+		current.indices.size(),
+		legacyMs,
+		currentMs,
+		currentMs > 0.0 ? legacyMs / currentMs : 0.0,
+		identical ? "identical" : "MISMATCH");
+	std::cout << line << std::endl;
+}
+
+}  // namespace
+
+void runVertexDedup() {
+	const std::vector<std::string> models{
+		"models/smooth_vase.obj",
+		"models/flat_vase.obj",
+		"models/FinalBaseMesh.obj"};
+
+	for (const auto &path : models) {
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
+			std::cout << path << ": failed to load, skipped" << std::endl;
+			continue;
+		}
+		compare(path, attrib, shapes, 5);
+	}
+
+	tinyobj::attrib_t gridAttrib;
+	std::vector<tinyobj::shape_t> gridShapes;
+	makeGrid(1024, gridAttrib, gridShapes);
+	compare("synthetic grid 1024x1024", gridAttrib, gridShapes, 2);
+}
+
+}  // namespace lvr::benchmarks
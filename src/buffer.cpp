@@ -35,26 +35,36 @@ Buffer::Buffer(
 	uint32_t instanceCount,
 	VkBufferUsageFlags usageFlags,
 	VkMemoryPropertyFlags memoryPropertyFlags,
-	VkDeviceSize minOffsetAlignment)
+	VkDeviceSize minOffsetAlignment,
+	VkSharingMode sharingMode)
 	: lvrDevice{device},
 	  instanceSize{instanceSize},
 	  instanceCount{instanceCount},
 	  usageFlags{usageFlags},
-	  memoryPropertyFlags{memoryPropertyFlags} {
+	  memoryPropertyFlags{memoryPropertyFlags},
+	  sharingMode{sharingMode} {
 	alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
 	bufferSize = alignmentSize * instanceCount;
-	device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+	device.createBuffer(
+		bufferSize,
+		usageFlags,
+		memoryPropertyFlags,
+		buffer,
+		allocation,
+		sharingMode);
 }
 
 Buffer::~Buffer() {
 	unmap();
 	vkDestroyBuffer(lvrDevice.device(), buffer, nullptr);
-	vkFreeMemory(lvrDevice.device(), memory, nullptr);
+	lvrDevice.allocator().free(allocation);
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
  *
+ * @note Host visible memory stays mapped by the allocator, so this only hands out the pointer
+ *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
@@ -62,21 +72,20 @@ Buffer::~Buffer() {
  * @return VkResult of the buffer mapping call
  */
 VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-	assert(buffer && memory && "Called map on buffer before create");
-	return vkMapMemory(lvrDevice.device(), memory, offset, size, 0, &mapped);
+	assert(buffer && allocation.memory && "Called map on buffer before create");
+	if (allocation.mapped == nullptr) {
+		return VK_ERROR_MEMORY_MAP_FAILED;
+	}
+	mapped = static_cast<char *>(allocation.mapped) + offset;
+	return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The underlying memory block stays mapped until the allocator releases it
  */
-void Buffer::unmap() {
-	if (mapped) {
-		vkUnmapMemory(lvrDevice.device(), memory);
-		mapped = nullptr;
-	}
-}
+void Buffer::unmap() { mapped = nullptr; }
 
 /**
  * Copies the specified data to the mapped buffer. Default value writes whole buffer range
@@ -111,12 +120,7 @@ void Buffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the flush call
  */
 VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-	VkMappedMemoryRange mappedRange = {};
-	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	mappedRange.memory = memory;
-	mappedRange.offset = offset;
-	mappedRange.size = size;
-	return vkFlushMappedMemoryRanges(lvrDevice.device(), 1, &mappedRange);
+	return lvrDevice.allocator().flush(allocation, size, offset);
 }
 
 /**
@@ -131,12 +135,7 @@ VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-	VkMappedMemoryRange mappedRange = {};
-	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	mappedRange.memory = memory;
-	mappedRange.offset = offset;
-	mappedRange.size = size;
-	return vkInvalidateMappedMemoryRanges(lvrDevice.device(), 1, &mappedRange);
+	return lvrDevice.allocator().invalidate(allocation, size, offset);
 }
 
 /**
@@ -12,7 +12,8 @@ class Buffer {
 		uint32_t instanceCount,
 		VkBufferUsageFlags usageFlags,
 		VkMemoryPropertyFlags memoryPropertyFlags,
-		VkDeviceSize minOffsetAlignment = 1);
+		VkDeviceSize minOffsetAlignment = 1,
+		VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
 	~Buffer();
 
 	Buffer(const Buffer&) = delete;
@@ -36,10 +37,13 @@ class Buffer {
 	void* getMappedMemory() const { return mapped; }
 	uint32_t getInstanceCount() const { return instanceCount; }
 	VkDeviceSize getInstanceSize() const { return instanceSize; }
-	VkDeviceSize getAlignmentSize() const { return instanceSize; }
+	VkDeviceSize getAlignmentSize() const { return alignmentSize; }
 	VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
 	VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
 	VkDeviceSize getBufferSize() const { return bufferSize; }
+	// VK_SHARING_MODE_CONCURRENT buffers are usable from every queue family without ownership
+	// transfers
+	VkSharingMode getSharingMode() const { return sharingMode; }
 
    private:
 	static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
@@ -47,7 +51,7 @@ class Buffer {
 	Device& lvrDevice;
 	void* mapped = nullptr;
 	VkBuffer buffer = VK_NULL_HANDLE;
-	VkDeviceMemory memory = VK_NULL_HANDLE;
+	Allocation allocation{};
 
 	VkDeviceSize bufferSize;
 	uint32_t instanceCount;
@@ -55,6 +59,7 @@ class Buffer {
 	VkDeviceSize alignmentSize;
 	VkBufferUsageFlags usageFlags;
 	VkMemoryPropertyFlags memoryPropertyFlags;
+	VkSharingMode sharingMode;
 };
 
 }  // namespace lvr
\ No newline at end of file
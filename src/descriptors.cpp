@@ -4,6 +4,8 @@
 #include <cassert>
 #include <stdexcept>
 
+#include "swapchain.h"
+
 namespace lvr {
 
 // *************** Descriptor Set Layout Builder *********************
@@ -23,18 +25,33 @@ DescriptorSetLayout::Builder &DescriptorSetLayout::Builder::addBinding(
 	return *this;
 }
 
+DescriptorSetLayout::Builder &DescriptorSetLayout::Builder::setBindingFlags(
+	uint32_t binding, VkDescriptorBindingFlags flags) {
+	assert(bindings.count(binding) == 1 && "Binding flags set for a missing binding");
+	bindingFlags[binding] = flags;
+	return *this;
+}
+
 std::unique_ptr<DescriptorSetLayout> DescriptorSetLayout::Builder::build() const {
-	return std::make_unique<DescriptorSetLayout>(lvrDevice, bindings);
+	return std::make_unique<DescriptorSetLayout>(lvrDevice, bindings, bindingFlags);
 }
 
 // *************** Descriptor Set Layout *********************
 
 DescriptorSetLayout::DescriptorSetLayout(
-	Device &lvrDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+	Device &lvrDevice,
+	std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+	std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags)
 	: lvrDevice{lvrDevice}, bindings{bindings} {
 	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+	std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
+	bool updateAfterBind = false;
 	for (auto kv : bindings) {
 		setLayoutBindings.push_back(kv.second);
+		auto flags = bindingFlags.find(kv.first);
+		setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
+		updateAfterBind |= (setLayoutBindingFlags.back() &
+							VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
 	}
 
 	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
@@ -42,6 +59,17 @@ DescriptorSetLayout::DescriptorSetLayout(
 	descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
 	descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	if (!bindingFlags.empty()) {
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+		descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+	}
+	if (updateAfterBind) {
+		descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	}
+
 	if (vkCreateDescriptorSetLayout(
 			lvrDevice.device(),
 			&descriptorSetLayoutInfo,
@@ -127,10 +155,123 @@ void DescriptorPool::freeDescriptors(std::vector<VkDescriptorSet> &descriptors)
 
 void DescriptorPool::resetPool() { vkResetDescriptorPool(lvrDevice.device(), descriptorPool, 0); }
 
+// *************** Descriptor Cache *********************
+
+DescriptorCache::DescriptorCache(Device &lvrDevice) : lvrDevice{lvrDevice} {}
+
+size_t DescriptorCache::KeyHash::operator()(const std::vector<uint64_t> &key) const {
+	uint64_t hash = 14695981039346656037ull;
+	for (uint64_t word : key) {
+		hash = (hash ^ word) * 1099511628211ull;
+		hash ^= hash >> 29;
+	}
+	return static_cast<size_t>(hash);
+}
+
+bool DescriptorCache::lookup(
+	DescriptorSetLayout &setLayout,
+	std::vector<VkWriteDescriptorSet> &writes,
+	VkDescriptorSet &set) {
+	key.clear();
+	key.push_back(reinterpret_cast<uint64_t>(setLayout.getDescriptorSetLayout()));
+	for (auto &write : writes) {
+		key.push_back((static_cast<uint64_t>(write.dstBinding) << 32) | write.dstArrayElement);
+		key.push_back(write.descriptorType);
+		if (write.pBufferInfo != nullptr) {
+			key.push_back(reinterpret_cast<uint64_t>(write.pBufferInfo->buffer));
+			key.push_back(write.pBufferInfo->offset);
+			key.push_back(write.pBufferInfo->range);
+		}
+		if (write.pImageInfo != nullptr) {
+			key.push_back(reinterpret_cast<uint64_t>(write.pImageInfo->sampler));
+			key.push_back(reinterpret_cast<uint64_t>(write.pImageInfo->imageView));
+			key.push_back(write.pImageInfo->imageLayout);
+		}
+	}
+
+	auto it = entries.find(key);
+	if (it != entries.end()) {
+		it->second.lastUsedFrame = frame;
+		set = it->second.set;
+		statistics.hits++;
+		return true;
+	}
+
+	Entry entry{};
+	if (!allocate(setLayout.getDescriptorSetLayout(), entry.set, entry.poolIndex)) {
+		return false;
+	}
+	entry.lastUsedFrame = frame;
+	entries.emplace(key, entry);
+	set = entry.set;
+	statistics.misses++;
+
+	for (auto &write : writes) {
+		write.dstSet = set;
+	}
+	vkUpdateDescriptorSets(lvrDevice.device(), writes.size(), writes.data(), 0, nullptr);
+	return true;
+}
+
+bool DescriptorCache::allocate(
+	VkDescriptorSetLayout setLayout, VkDescriptorSet &set, uint32_t &poolIndex) {
+	// newest pool first, older ones only have room where sets were evicted
+	for (size_t i = pools.size(); i-- > 0;) {
+		if (pools[i]->allocateDescriptor(setLayout, set)) {
+			poolIndex = static_cast<uint32_t>(i);
+			return true;
+		}
+	}
+
+	pools.push_back(
+		DescriptorPool::Builder(lvrDevice)
+			.setMaxSets(SETS_PER_POOL)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SETS_PER_POOL)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SETS_PER_POOL)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SETS_PER_POOL)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, SETS_PER_POOL)
+			.setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
+			.build());
+	poolIndex = static_cast<uint32_t>(pools.size() - 1);
+	return pools.back()->allocateDescriptor(setLayout, set);
+}
+
+void DescriptorCache::nextFrame() {
+	frame++;
+	statistics.hits = 0;
+	statistics.misses = 0;
+	statistics.evictions = 0;
+
+	// a set last used more than MAX_FRAMES_IN_FLIGHT frames ago is no longer read by the GPU
+	std::vector<std::vector<VkDescriptorSet>> staleSets(pools.size());
+	for (auto it = entries.begin(); it != entries.end();) {
+		if (frame - it->second.lastUsedFrame > SwapChain::MAX_FRAMES_IN_FLIGHT) {
+			staleSets[it->second.poolIndex].push_back(it->second.set);
+			it = entries.erase(it);
+			statistics.evictions++;
+		} else {
+			++it;
+		}
+	}
+	for (size_t i = 0; i < pools.size(); i++) {
+		if (!staleSets[i].empty()) pools[i]->freeDescriptors(staleSets[i]);
+	}
+}
+
+DescriptorCache::Statistics DescriptorCache::getStatistics() const {
+	Statistics current = statistics;
+	current.setCount = static_cast<uint32_t>(entries.size());
+	current.poolCount = static_cast<uint32_t>(pools.size());
+	return current;
+}
+
 // *************** Descriptor Writer *********************
 
 DescriptorWriter::DescriptorWriter(DescriptorSetLayout &setLayout, DescriptorPool &pool)
-	: setLayout{setLayout}, pool{pool} {}
+	: setLayout{setLayout}, pool{&pool} {}
+
+DescriptorWriter::DescriptorWriter(DescriptorSetLayout &setLayout, DescriptorCache &cache)
+	: setLayout{setLayout}, cache{&cache} {}
 
 DescriptorWriter &DescriptorWriter::writeBuffer(
 	uint32_t binding, VkDescriptorBufferInfo *bufferInfo) {
@@ -173,8 +314,34 @@ DescriptorWriter &DescriptorWriter::writeImage(uint32_t binding, VkDescriptorIma
 	return *this;
 }
 
+DescriptorWriter &DescriptorWriter::writeImageArrayElement(
+	uint32_t binding, uint32_t arrayElement, VkDescriptorImageInfo *imageInfo) {
+	assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
+
+	auto &bindingDescription = setLayout.bindings[binding];
+
+	assert(
+		arrayElement < bindingDescription.descriptorCount &&
+		"Array element out of range for binding");
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.descriptorType = bindingDescription.descriptorType;
+	write.dstBinding = binding;
+	write.dstArrayElement = arrayElement;
+	write.pImageInfo = imageInfo;
+	write.descriptorCount = 1;
+
+	writes.push_back(write);
+	return *this;
+}
+
 bool DescriptorWriter::build(VkDescriptorSet &set) {
-	bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
+	if (cache != nullptr) {
+		return cache->lookup(setLayout, writes, set);
+	}
+
+	bool success = pool->allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
 	if (!success) {
 		return false;
 	}
@@ -186,7 +353,7 @@ void DescriptorWriter::overwrite(VkDescriptorSet &set) {
 	for (auto &write : writes) {
 		write.dstSet = set;
 	}
-	vkUpdateDescriptorSets(pool.lvrDevice.device(), writes.size(), writes.data(), 0, nullptr);
+	vkUpdateDescriptorSets(setLayout.lvrDevice.device(), writes.size(), writes.data(), 0, nullptr);
 }
 
 }  // namespace lvr
\ No newline at end of file
@@ -20,15 +20,24 @@ class DescriptorSetLayout {
 			VkDescriptorType descriptorType,
 			VkShaderStageFlags stageFlags,
 			uint32_t count = 1);
+		// Update-after-bind flags make the layout require an update-after-bind pool
+		Builder &setBindingFlags(uint32_t binding, VkDescriptorBindingFlags flags);
 		std::unique_ptr<DescriptorSetLayout> build() const;
 
+		const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> &getBindings() const {
+			return bindings;
+		}
+
 	   private:
 		Device &lvrDevice;
 		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+		std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
 	};
 
 	DescriptorSetLayout(
-		Device &lvrDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+		Device &lvrDevice,
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+		std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags = {});
 	~DescriptorSetLayout();
 	DescriptorSetLayout(const DescriptorSetLayout &) = delete;
 	DescriptorSetLayout &operator=(const DescriptorSetLayout &) = delete;
@@ -41,6 +50,7 @@ class DescriptorSetLayout {
 	std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
 
 	friend class DescriptorWriter;
+	friend class DescriptorCache;
 };
 
 class DescriptorPool {
@@ -84,19 +94,82 @@ class DescriptorPool {
 	friend class DescriptorWriter;
 };
 
+// Keeps descriptor sets alive across frames, keyed on the layout and the exact buffer and image
+// infos written to them. A set whose inputs stay the same is reused without touching Vulkan; a
+// changed texture or buffer slot is a new key and gets a new set. Sets that haven't been asked for
+// in more than MAX_FRAMES_IN_FLIGHT frames are no longer in use by the GPU and are freed.
+// Pools are added as the existing ones fill up.
+class DescriptorCache {
+   public:
+	static constexpr uint32_t SETS_PER_POOL = 256;
+
+	struct Statistics {
+		// lookups in the current frame
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+		uint32_t evictions = 0;
+		uint32_t setCount = 0;
+		uint32_t poolCount = 0;
+	};
+
+	DescriptorCache(Device &lvrDevice);
+	DescriptorCache(const DescriptorCache &) = delete;
+	DescriptorCache &operator=(const DescriptorCache &) = delete;
+
+	// Call once per frame, after the frame's fence was waited on. Evicts stale sets and resets the
+	// per frame counters.
+	void nextFrame();
+
+	Statistics getStatistics() const;
+
+   private:
+	struct Entry {
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		uint32_t poolIndex = 0;
+		uint64_t lastUsedFrame = 0;
+	};
+
+	struct KeyHash {
+		size_t operator()(const std::vector<uint64_t> &key) const;
+	};
+
+	bool lookup(
+		DescriptorSetLayout &setLayout,
+		std::vector<VkWriteDescriptorSet> &writes,
+		VkDescriptorSet &set);
+	bool allocate(VkDescriptorSetLayout setLayout, VkDescriptorSet &set, uint32_t &poolIndex);
+
+	Device &lvrDevice;
+	std::vector<std::unique_ptr<DescriptorPool>> pools{};
+	std::unordered_map<std::vector<uint64_t>, Entry, KeyHash> entries{};
+	std::vector<uint64_t> key{};
+	uint64_t frame = 0;
+	Statistics statistics{};
+
+	friend class DescriptorWriter;
+};
+
 class DescriptorWriter {
    public:
 	DescriptorWriter(DescriptorSetLayout &setLayout, DescriptorPool &pool);
+	// build() returns a cached set when one holds the same writes
+	DescriptorWriter(DescriptorSetLayout &setLayout, DescriptorCache &cache);
 
 	DescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo);
 	DescriptorWriter &writeImage(uint32_t binding, VkDescriptorImageInfo *imageInfo);
+	// Writes a single element of an arrayed binding
+	DescriptorWriter &writeImageArrayElement(
+		uint32_t binding,
+		uint32_t arrayElement,
+		VkDescriptorImageInfo *imageInfo);
 
 	bool build(VkDescriptorSet &set);
 	void overwrite(VkDescriptorSet &set);
 
    private:
 	DescriptorSetLayout &setLayout;
-	DescriptorPool &pool;
+	DescriptorPool *pool = nullptr;
+	DescriptorCache *cache = nullptr;
 	std::vector<VkWriteDescriptorSet> writes;
 };
 
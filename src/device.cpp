@@ -1,8 +1,19 @@
 #include "device.h"
 
+#include "layout_cache.h"
+#include "mesh_pool.h"
+#include "release_queue.h"
+#include "textures/texture_cache.h"
+
 // std headers
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <set>
 #include <unordered_set>
 #ifdef LVR_PLATFORM_MACOS
@@ -56,11 +67,32 @@ Device::Device(Window& window) : window(window) {
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
-	createCommandPool();
+	allocator_ = std::make_unique<MemoryAllocator>(Device_, physicalDevice, properties);
+	createCommandPools();
+	createPipelineCache();
+	releaseQueue_ = std::make_unique<ReleaseQueue>();
+	uploadQueue_ = std::make_unique<UploadQueue>(*this);
+	meshPool_ = std::make_unique<MeshPool>(*this);
+	layoutCache_ = std::make_unique<LayoutCache>(*this);
+	textureCache_ = std::make_unique<TextureCache>(*this);
 }
 
 Device::~Device() {
+	// releases may still reference the caches and the pool
+	vkDeviceWaitIdle(Device_);
+	releaseQueue_->flush();
+	textureCache_.reset();
+	layoutCache_.reset();
+	meshPool_.reset();
+	uploadQueue_.reset();
+	releaseQueue_.reset();
+	if (computeCommandPool != commandPool) {
+		vkDestroyCommandPool(Device_, computeCommandPool, nullptr);
+	}
 	vkDestroyCommandPool(Device_, commandPool, nullptr);
+	savePipelineCache();
+	vkDestroyPipelineCache(Device_, pipelineCache_, nullptr);
+	allocator_.reset();
 	vkDestroyDevice(Device_, nullptr);
 
 	if (enableValidationLayers) {
@@ -71,6 +103,78 @@ Device::~Device() {
 	vkDestroyInstance(instance, nullptr);
 }
 
+void Device::createPipelineCache() {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<char> data{};
+	std::ifstream in{PIPELINE_CACHE_PATH, std::ios::binary};
+	if (in) {
+		data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	// a cache from another driver or device is useless, drivers are only required to reject it
+	// gracefully, so don't hand it over at all
+	VkPipelineCacheHeaderVersionOne header{};
+	bool valid = data.size() >= sizeof(header);
+	if (valid) {
+		memcpy(&header, data.data(), sizeof(header));
+		valid = header.headerSize >= sizeof(header) &&
+				header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+				header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+				memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+	if (!data.empty() && !valid) {
+		std::cout << "pipeline cache: " << PIPELINE_CACHE_PATH
+				  << " is from another driver or device, starting empty" << std::endl;
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	if (valid) {
+		cacheInfo.initialDataSize = data.size();
+		cacheInfo.pInitialData = data.data();
+	}
+	if (vkCreatePipelineCache(Device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline cache!");
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "pipeline cache: loaded " << (valid ? data.size() : 0) << " bytes in "
+			  << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+			  << std::endl;
+}
+
+void Device::savePipelineCache() {
+	size_t size = 0;
+	if (vkGetPipelineCacheData(Device_, pipelineCache_, &size, nullptr) != VK_SUCCESS ||
+		size == 0) {
+		return;
+	}
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(Device_, pipelineCache_, &size, data.data()) != VK_SUCCESS) {
+		return;
+	}
+
+	// write next to the old cache and swap, so a crash mid write leaves the old one intact
+	std::filesystem::path path{PIPELINE_CACHE_PATH};
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+	{
+		std::ofstream out{tempPath, std::ios::binary | std::ios::trunc};
+		if (!out.write(data.data(), static_cast<std::streamsize>(size))) {
+			std::cout << "pipeline cache: failed to write " << tempPath << std::endl;
+			return;
+		}
+	}
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::cout << "pipeline cache: failed to save " << path << ": " << error.message()
+				  << std::endl;
+	}
+}
+
 void Device::createInstance() {
 	if (enableValidationLayers && !checkValidationLayerSupport()) {
 		throw std::runtime_error("validation layers requested, but not available!");
@@ -143,26 +247,99 @@ void Device::pickPhysicalDevice() {
 void Device::createLogicalDevice() {
 	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
-	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = {
-		indices.graphicsAndComputeFamily.value(),
-		indices.presentFamily.value()};
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(
+		physicalDevice,
+		&queueFamilyCount,
+		queueFamilies.data());
+
+	// hands out the next queue of a family, sharing the last one once the family runs out
+	std::map<uint32_t, uint32_t> queueCounts;
+	auto requestQueue = [&](uint32_t family) {
+		uint32_t& count = queueCounts[family];
+		if (count < queueFamilies[family].queueCount) count++;
+		return count - 1;
+	};
+
+	uint32_t graphicsFamily = indices.graphicsAndComputeFamily.value();
+	uint32_t graphicsIndex = requestQueue(graphicsFamily);
+	uint32_t presentFamily = indices.presentFamily.value();
+	uint32_t presentIndex = presentFamily == graphicsFamily ? graphicsIndex
+															: requestQueue(presentFamily);
+	computeQueueFamily_ = indices.computeFamily.value_or(graphicsFamily);
+	uint32_t computeIndex = requestQueue(computeQueueFamily_);
+	uint32_t transferFamily = indices.transferFamily.value_or(graphicsFamily);
+	uint32_t transferIndex =
+		indices.transferFamily.has_value() ? requestQueue(transferFamily) : graphicsIndex;
 
-	float queuePriority = 1.0f;
-	for (uint32_t queueFamily : uniqueQueueFamilies) {
+	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+	std::vector<float> queuePriorities(
+		std::max_element(
+			queueCounts.begin(),
+			queueCounts.end(),
+			[](const auto& a, const auto& b) { return a.second < b.second; })
+			->second,
+		1.0f);
+	for (auto [queueFamily, queueCount] : queueCounts) {
 		VkDeviceQueueCreateInfo queueCreateInfo = {};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = queueFamily;
-		queueCreateInfo.queueCount = 1;
-		queueCreateInfo.pQueuePriorities = &queuePriority;
+		queueCreateInfo.queueCount = queueCount;
+		queueCreateInfo.pQueuePriorities = queuePriorities.data();
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
 	VkPhysicalDeviceFeatures DeviceFeatures = {};
 	DeviceFeatures.samplerAnisotropy = VK_TRUE;
 
+	VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
+	supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &supportedVulkan12Features;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+	// descriptor indexing for a texture array that grows while frames are in flight
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	bindlessSupported_ = supportedVulkan12Features.runtimeDescriptorArray &&
+						 supportedVulkan12Features.descriptorBindingPartiallyBound &&
+						 supportedVulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+						 supportedVulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+						 supportedVulkan12Features.shaderSampledImageArrayNonUniformIndexing;
+	if (bindlessSupported_) {
+		vulkan12Features.descriptorIndexing = supportedVulkan12Features.descriptorIndexing;
+		vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+		vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+		vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	}
+
+	// culling on the GPU writes both the draws and their count
+	gpuDrivenSupported_ = bindlessSupported_ && supportedVulkan12Features.drawIndirectCount &&
+						  supportedFeatures.features.multiDrawIndirect &&
+						  supportedFeatures.features.drawIndirectFirstInstance;
+	if (gpuDrivenSupported_) {
+		vulkan12Features.drawIndirectCount = VK_TRUE;
+		DeviceFeatures.multiDrawIndirect = VK_TRUE;
+		DeviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	}
+
+	// the compute queue waits on the upload queue's batches, core since Vulkan 1.2
+	if (!supportedVulkan12Features.timelineSemaphore) {
+		throw std::runtime_error("timeline semaphores are not supported!");
+	}
+	vulkan12Features.timelineSemaphore = VK_TRUE;
+
+	textureCompressionBCSupported_ = supportedFeatures.features.textureCompressionBC;
+	DeviceFeatures.textureCompressionBC = supportedFeatures.features.textureCompressionBC;
+
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &vulkan12Features;
 
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -184,12 +361,24 @@ void Device::createLogicalDevice() {
 		throw std::runtime_error("failed to create logical Device!");
 	}
 
-	vkGetDeviceQueue(Device_, indices.graphicsAndComputeFamily.value(), 0, &graphicsQueue_);
-	vkGetDeviceQueue(Device_, indices.graphicsAndComputeFamily.value(), 0, &computeQueue_);
-	vkGetDeviceQueue(Device_, indices.presentFamily.value(), 0, &presentQueue_);
+	vkGetDeviceQueue(Device_, graphicsFamily, graphicsIndex, &graphicsQueue_);
+	vkGetDeviceQueue(Device_, computeQueueFamily_, computeIndex, &computeQueue_);
+	vkGetDeviceQueue(Device_, presentFamily, presentIndex, &presentQueue_);
+	vkGetDeviceQueue(Device_, transferFamily, transferIndex, &transferQueue_);
+
+	std::set<uint32_t> uniqueQueueFamilies = {graphicsFamily, computeQueueFamily_, transferFamily};
+	queueFamilies_.assign(uniqueQueueFamilies.begin(), uniqueQueueFamilies.end());
+
+	std::cout << "bindless descriptors: " << (bindlessSupported_ ? "supported" : "unsupported")
+			  << std::endl;
+	std::cout << "gpu driven drawing: " << (gpuDrivenSupported_ ? "supported" : "unsupported")
+			  << std::endl;
+	std::cout << "queues: graphics " << graphicsFamily << "." << graphicsIndex << ", compute "
+			  << computeQueueFamily_ << "." << computeIndex << ", transfer " << transferFamily
+			  << "." << transferIndex << std::endl;
 }
 
-void Device::createCommandPool() {
+void Device::createCommandPools() {
 	QueueFamilyIndices queueFamilyIndices = findPhysicalQueueFamilies();
 
 	VkCommandPoolCreateInfo poolInfo = {};
@@ -201,6 +390,13 @@ void Device::createCommandPool() {
 	if (vkCreateCommandPool(Device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create command pool!");
 	}
+	computeCommandPool = commandPool;
+	if (computeQueueFamily_ != poolInfo.queueFamilyIndex) {
+		poolInfo.queueFamilyIndex = computeQueueFamily_;
+		if (vkCreateCommandPool(Device_, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute command pool!");
+		}
+	}
 }
 
 VkSampleCountFlagBits Device::getMaxUsableSampleCount() {
@@ -370,18 +566,30 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice Device) {
 	vkGetPhysicalDeviceQueueFamilyProperties(Device, &queueFamilyCount, queueFamilies.data());
 
 	int i = 0;
+	bool transferOnly = false;
 	for (const auto& queueFamily : queueFamilies) {
 		if ((queueFamily.queueCount > 0) && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
-			(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+			(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+			!indices.graphicsAndComputeFamily.has_value()) {
 			indices.graphicsAndComputeFamily = i;
 		}
 		VkBool32 presentSupport = false;
 		vkGetPhysicalDeviceSurfaceSupportKHR(Device, i, surface_, &presentSupport);
-		if (queueFamily.queueCount > 0 && presentSupport) {
+		if (queueFamily.queueCount > 0 && presentSupport && !indices.presentFamily.has_value()) {
 			indices.presentFamily = i;
 		}
-		if (indices.isComplete()) {
-			break;
+
+		if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+			!(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+			!indices.computeFamily.has_value()) {
+			indices.computeFamily = i;
+		}
+
+		// prefer a pure copy engine, otherwise take an async compute family that can transfer
+		if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+			!(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !transferOnly) {
+			indices.transferFamily = i;
+			transferOnly = !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT);
 		}
 
 		i++;
@@ -439,16 +647,7 @@ VkFormat Device::findSupportedFormat(
 }
 
 uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-		if ((typeFilter & (1 << i)) &&
-			(memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-			return i;
-		}
-	}
-
-	throw std::runtime_error("failed to find suitable memory type!");
+	return allocator_->findMemoryType(typeFilter, properties);
 }
 
 void Device::createBuffer(
@@ -456,12 +655,18 @@ void Device::createBuffer(
 	VkBufferUsageFlags usage,
 	VkMemoryPropertyFlags properties,
 	VkBuffer& buffer,
-	VkDeviceMemory& bufferMemory) {
+	Allocation& bufferAllocation,
+	VkSharingMode sharingMode) {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
 	bufferInfo.usage = usage;
 	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (sharingMode == VK_SHARING_MODE_CONCURRENT && queueFamilies_.size() > 1) {
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies_.size());
+		bufferInfo.pQueueFamilyIndices = queueFamilies_.data();
+	}
 
 	if (vkCreateBuffer(Device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create vertex buffer!");
@@ -470,16 +675,15 @@ void Device::createBuffer(
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(Device_, buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+	bufferAllocation = allocator_->allocate(
+		memRequirements,
+		properties,
+		MemoryAllocator::ResourceKind::Linear);
 
-	if (vkAllocateMemory(Device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate vertex buffer memory!");
+	if (vkBindBufferMemory(Device_, buffer, bufferAllocation.memory, bufferAllocation.offset) !=
+		VK_SUCCESS) {
+		throw std::runtime_error("failed to bind buffer memory!");
 	}
-
-	vkBindBufferMemory(Device_, buffer, bufferMemory, 0);
 }
 
 VkCommandBuffer Device::beginSingleTimeCommands() {
@@ -515,21 +719,25 @@ void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
 	vkFreeCommandBuffers(Device_, commandPool, 1, &commandBuffer);
 }
 
-void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+UploadQueue::Ticket Device::copyBufferBatched(
+	VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+	VkCommandBuffer commandBuffer = uploadQueue_->getCommandBuffer();
 
 	VkBufferCopy copyRegion{};
 	copyRegion.srcOffset = 0;  // Optional
 	copyRegion.dstOffset = 0;  // Optional
 	copyRegion.size = size;
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+	return uploadQueue_->getCurrentTicket();
+}
 
-	endSingleTimeCommands(commandBuffer);
+void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+	uploadQueue_->wait(copyBufferBatched(srcBuffer, dstBuffer, size));
 }
 
-void Device::copyBufferToImage(
+UploadQueue::Ticket Device::copyBufferToImageBatched(
 	VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	VkCommandBuffer commandBuffer = uploadQueue_->getCommandBuffer();
 
 	VkBufferImageCopy region{};
 	region.bufferOffset = 0;
@@ -551,14 +759,19 @@ void Device::copyBufferToImage(
 		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 		1,
 		&region);
-	endSingleTimeCommands(commandBuffer);
+	return uploadQueue_->getCurrentTicket();
+}
+
+void Device::copyBufferToImage(
+	VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
+	uploadQueue_->wait(copyBufferToImageBatched(buffer, image, width, height, layerCount));
 }
 
 void Device::createImageWithInfo(
 	const VkImageCreateInfo& imageInfo,
 	VkMemoryPropertyFlags properties,
 	VkImage& image,
-	VkDeviceMemory& imageMemory) {
+	Allocation& imageAllocation) {
 	if (vkCreateImage(Device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create image!");
 	}
@@ -566,21 +779,20 @@ void Device::createImageWithInfo(
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(Device_, image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+	// linear images follow the same granularity rules as buffers, so they share those blocks
+	imageAllocation = allocator_->allocate(
+		memRequirements,
+		properties,
+		imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? MemoryAllocator::ResourceKind::Optimal
+													: MemoryAllocator::ResourceKind::Linear);
 
-	if (vkAllocateMemory(Device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
-
-	if (vkBindImageMemory(Device_, image, imageMemory, 0) != VK_SUCCESS) {
+	if (vkBindImageMemory(Device_, image, imageAllocation.memory, imageAllocation.offset) !=
+		VK_SUCCESS) {
 		throw std::runtime_error("failed to bind image memory!");
 	}
 }
 
-void Device::transitionImageLayout(
+UploadQueue::Ticket Device::transitionImageLayoutBatched(
 	VkImage image,
 	VkFormat format,
 	VkImageLayout oldLayout,
@@ -590,7 +802,7 @@ void Device::transitionImageLayout(
 	// uses an image memory barrier transition image layouts and transfer queue
 	// family ownership when VK_SHARING_MODE_EXCLUSIVE is used. There is an
 	// equivalent buffer memory barrier to do this for buffers
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	VkCommandBuffer commandBuffer = uploadQueue_->getCommandBuffer();
 
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -670,25 +882,38 @@ void Device::transitionImageLayout(
 		nullptr,
 		1,
 		&barrier);
+	return uploadQueue_->getCurrentTicket();
+}
 
-	endSingleTimeCommands(commandBuffer);
+void Device::transitionImageLayout(
+	VkImage image,
+	VkFormat format,
+	VkImageLayout oldLayout,
+	VkImageLayout newLayout,
+	uint32_t mipLevels,
+	uint32_t layerCount) {
+	uploadQueue_->wait(
+		transitionImageLayoutBatched(image, format, oldLayout, newLayout, mipLevels, layerCount));
 }
 
-void Device::generateMipmaps(
+bool Device::supportsLinearBlit(VkFormat format) {
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	return formatProperties.optimalTilingFeatures &
+		   VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+}
+
+UploadQueue::Ticket Device::generateMipmapsBatched(
 	VkImage image, VkFormat format, uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels) {
 	// uses an image memory barrier transition image layouts and transfer queue
 	// family ownership when VK_SHARING_MODE_EXCLUSIVE is used. There is an
 	// equivalent buffer memory barrier to do this for buffers
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-	VkFormatProperties formatProperties;
-	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
-
-	if (!(formatProperties.optimalTilingFeatures &
-		  VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+	if (!supportsLinearBlit(format)) {
 		throw std::runtime_error("texture image format does not support linear blitting!");
 	}
 
+	VkCommandBuffer commandBuffer = uploadQueue_->getCommandBuffer();
+
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.image = image;
@@ -785,7 +1010,12 @@ void Device::generateMipmaps(
 		nullptr,
 		1,
 		&barrier);
-	endSingleTimeCommands(commandBuffer);
+	return uploadQueue_->getCurrentTicket();
+}
+
+void Device::generateMipmaps(
+	VkImage image, VkFormat format, uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels) {
+	uploadQueue_->wait(generateMipmapsBatched(image, format, texWidth, texHeight, mipLevels));
 }
 
-}  // namespace lvr
\ No newline at end of file
+}  // namespace lvr
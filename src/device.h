@@ -1,17 +1,26 @@
 #pragma once
 
+#include "memory_allocator.h"
+#include "upload_queue.h"
 #include "window.h"
 
 // std lib headers
 
 #include <vulkan/vulkan_core.h>
 
+#include <atomic>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
 namespace lvr {
 
+class LayoutCache;
+class MeshPool;
+class ReleaseQueue;
+class TextureCache;
+
 struct SwapChainSupportDetails {
 	VkSurfaceCapabilitiesKHR capabilities;
 	std::vector<VkSurfaceFormatKHR> formats;
@@ -21,6 +30,10 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsAndComputeFamily;
 	std::optional<uint32_t> presentFamily;
+	// family that can transfer but not draw, unset when the device has none
+	std::optional<uint32_t> transferFamily;
+	// family that can dispatch but not draw, unset when the device has none
+	std::optional<uint32_t> computeFamily;
 
 	bool isComplete() { return graphicsAndComputeFamily.has_value() && presentFamily.has_value(); };
 };
@@ -43,15 +56,51 @@ class Device {
 	Device& operator=(Device&&) = delete;
 
 	VkCommandPool getCommandPool() { return commandPool; }
+	// Pool on the compute queue's family, the same as getCommandPool() without async compute.
+	VkCommandPool getComputeCommandPool() { return computeCommandPool; }
 	VkDevice device() { return Device_; }
+	VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
 	VkSurfaceKHR surface() { return surface_; }
 	VkQueue graphicsQueue() { return graphicsQueue_; }
+	// A queue of a compute-only family, or a second graphics family queue, so dispatches can
+	// overlap with rendering. Falls back to the graphics queue itself.
 	VkQueue computeQueue() { return computeQueue_; }
+	bool hasAsyncComputeQueue() { return computeQueue_ != graphicsQueue_; }
+	uint32_t computeQueueFamily() { return computeQueueFamily_; }
 	VkQueue presentQueue() { return presentQueue_; }
+	// Falls back to the graphics queue when there is no dedicated transfer family.
+	VkQueue transferQueue() { return transferQueue_; }
+	bool hasDedicatedTransferQueue() { return transferQueue_ != graphicsQueue_; }
+	// Descriptor indexing with partially bound, update-after-bind sampled image arrays.
+	bool supportsBindless() { return bindlessSupported_; }
+	// Bindless plus vkCmdDrawIndexedIndirectCount with multi draw and firstInstance.
+	bool supportsGpuDriven() { return gpuDrivenSupported_; }
+	// BC1-7 sampled images, for cooked textures
+	bool supportsTextureCompressionBC() { return textureCompressionBCSupported_; }
+	MemoryAllocator& allocator() { return *allocator_; }
+	UploadQueue& uploadQueue() { return *uploadQueue_; }
+	// Releases what frames in flight may still use once they finished
+	ReleaseQueue& releaseQueue() { return *releaseQueue_; }
+	MeshPool& meshPool() { return *meshPool_; }
+	// Descriptor set and pipeline layouts shared between every system that asks for the same one
+	LayoutCache& layoutCache() { return *layoutCache_; }
+	// Textures loaded from files, shared by path and kept within a memory budget
+	TextureCache& textureCache() { return *textureCache_; }
+	// Shared by every pipeline. Loaded from PIPELINE_CACHE_PATH when it was written by the same
+	// driver and device, saved back on destruction.
+	VkPipelineCache pipelineCache() { return pipelineCache_; }
+	// Time spent in vkCreate*Pipelines so far, to see what the pipeline cache saves
+	void addPipelineCreationTime(double milliseconds) {
+		pipelineCreationMicroseconds_ += static_cast<uint64_t>(milliseconds * 1000.0);
+	}
+	double getPipelineCreationMs() const { return pipelineCreationMicroseconds_ / 1000.0; }
 
 	SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 	QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
+	// Distinct families of the graphics, compute and transfer queues, for
+	// VK_SHARING_MODE_CONCURRENT resources.
+	const std::vector<uint32_t>& getQueueFamilies() { return queueFamilies_; }
 	VkFormat findSupportedFormat(
 		const std::vector<VkFormat>& candidates,
 		VkImageTiling tiling,
@@ -63,18 +112,27 @@ class Device {
 		VkBufferUsageFlags usage,
 		VkMemoryPropertyFlags properties,
 		VkBuffer& buffer,
-		VkDeviceMemory& bufferMemory);
+		Allocation& bufferAllocation,
+		VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
 	VkCommandBuffer beginSingleTimeCommands();
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+
+	// The copy, transition and mip helpers below submit their work and wait for it. The *Batched
+	// variants record into the open batch of uploadQueue() instead and return its ticket, the work
+	// only runs once that batch is submitted and is only visible to later graphics queue work.
 	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+	UploadQueue::Ticket copyBufferBatched(
+		VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 	void copyBufferToImage(
 		VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
+	UploadQueue::Ticket copyBufferToImageBatched(
+		VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
 	void createImageWithInfo(
 		const VkImageCreateInfo& imageInfo,
 		VkMemoryPropertyFlags properties,
 		VkImage& image,
-		VkDeviceMemory& imageMemory);
+		Allocation& imageAllocation);
 
 	void transitionImageLayout(
 		VkImage image,
@@ -83,12 +141,25 @@ class Device {
 		VkImageLayout newLayout,
 		uint32_t mipLevels,
 		uint32_t layerCount);
+	UploadQueue::Ticket transitionImageLayoutBatched(
+		VkImage image,
+		VkFormat format,
+		VkImageLayout oldLayout,
+		VkImageLayout newLayout,
+		uint32_t mipLevels,
+		uint32_t layerCount);
 
+	// Whether generateMipmaps() can blit `format`, it needs linear filtering with optimal tiling
+	bool supportsLinearBlit(VkFormat format);
 	void generateMipmaps(
 		VkImage image, VkFormat format, uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels);
+	UploadQueue::Ticket generateMipmapsBatched(
+		VkImage image, VkFormat format, uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels);
 
 	VkPhysicalDeviceProperties properties;
 
+	static constexpr const char* PIPELINE_CACHE_PATH = "shaders/cache/pipeline_cache.bin";
+
 	VkSampleCountFlagBits getMsaaSamples() { return msaaSamples; }
 
    private:
@@ -97,7 +168,9 @@ class Device {
 	void createSurface();
 	void pickPhysicalDevice();
 	void createLogicalDevice();
-	void createCommandPool();
+	void createCommandPools();
+	void createPipelineCache();
+	void savePipelineCache();
 
 	VkSampleCountFlagBits getMaxUsableSampleCount();
 
@@ -116,13 +189,28 @@ class Device {
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 	Window& window;
 	VkCommandPool commandPool;
+	VkCommandPool computeCommandPool;
 	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	bool bindlessSupported_ = false;
+	bool gpuDrivenSupported_ = false;
+	bool textureCompressionBCSupported_ = false;
 
 	VkDevice Device_;
 	VkSurfaceKHR surface_;
 	VkQueue graphicsQueue_;
 	VkQueue presentQueue_;
 	VkQueue computeQueue_;
+	VkQueue transferQueue_;
+	uint32_t computeQueueFamily_;
+	std::vector<uint32_t> queueFamilies_;
+	std::unique_ptr<MemoryAllocator> allocator_;
+	std::unique_ptr<ReleaseQueue> releaseQueue_;
+	std::unique_ptr<UploadQueue> uploadQueue_;
+	std::unique_ptr<MeshPool> meshPool_;
+	std::unique_ptr<LayoutCache> layoutCache_;
+	std::unique_ptr<TextureCache> textureCache_;
+	VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+	std::atomic<uint64_t> pipelineCreationMicroseconds_{0};
 
 	const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
 	const std::vector<const char*> DeviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -7,6 +7,8 @@
 #include "camera.h"
 #include "descriptors.h"
 #include "gameobject.h"
+#include "secondary_command_buffers.h"
+#include "utils/job_system.h"
 
 namespace lvr {
 
@@ -36,6 +38,9 @@ struct FrameInfo {
 	VkDescriptorSet globalDescriptorSet;
 	DescriptorPool& frameDescriptorPool;  // pool of descriptors that is cleared each frame
 
-	GameObject::Map& gameObjects;
+	GameObjectManager& gameObjectManager;
+	utils::JobSystem& jobSystem;
+	// draws inside the swap chain render pass are recorded into these
+	SecondaryCommandBuffers& secondaryCommandBuffers;
 };
 }  // namespace lvr
\ No newline at end of file
@@ -1,7 +1,13 @@
 #include "gameobject.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <numeric>
 
+#include "release_queue.h"
+#include "transform_kernel.h"
+
 namespace lvr {
 
 glm::mat4 TransformComponent::mat4() {
@@ -60,50 +66,186 @@ glm::mat3 TransformComponent::normalMatrix() {
 		},
 	};
 }
-GameObject& GameObjectManager::makePointLight(float intensity, float radius, glm::vec4 color) {
-	auto& gameObj = createGameObject();
-	gameObj.color = color;
-	gameObj.transform.scale.x = radius;
-	gameObj.pointLight = std::make_unique<PointLightComponent>();
-	gameObj.pointLight->lightIntensity = intensity;
+GameObject GameObjectManager::createGameObject() {
+	GameObject::id_t id;
+	if (!freeIds.empty()) {
+		id = freeIds.back();
+		freeIds.pop_back();
+		indices[id] = size();
+	} else {
+		id = static_cast<GameObject::id_t>(indices.size());
+		indices.push_back(size());
+		generations.push_back(0);
+	}
+
+	ids_.push_back(id);
+	translations_.emplace_back(0.0f);
+	rotations_.emplace_back(0.0f);
+	scales_.emplace_back(1.0f);
+	colors_.emplace_back(0.0f);
+	models_.emplace_back();
+	diffuseMaps_.push_back(textureDefault);
+	matrices_.emplace_back();
+	dirty_.push_back(MATRIX_DIRTY | FRAMES_DIRTY | DRAWS_DIRTY);
+	return GameObject{*this, id, generations[id]};
+}
+
+GameObject GameObjectManager::makePointLight(float intensity, float radius, glm::vec4 color) {
+	auto gameObj = createGameObject();
+	gameObj.color() = color;
+	gameObj.scale().x = radius;
+	pointLights_.insert(gameObj.getId(), PointLightComponent{intensity});
 
 	return gameObj;
 }
 
-GameObjectManager::GameObjectManager(Device& device) {
-	// including nonCoherentAtomSize allows us to flush a specific index at once
-	int alignment = std::lcm(
-		device.properties.limits.nonCoherentAtomSize,
-		device.properties.limits.minUniformBufferOffsetAlignment);
-	for (int i = 0; i < uboBuffers.size(); i++) {
-		uboBuffers[i] = std::make_unique<Buffer>(
-			device,
-			sizeof(GameObjectBufferData),
-			GameObjectManager::MAX_GAME_OBJECTS,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-			alignment);
-		uboBuffers[i]->map();
+void GameObjectManager::destroyGameObject(GameObject gameObject) {
+	assert(isAlive(gameObject) && "Game object was already destroyed!");
+	GameObject::id_t id = gameObject.getId();
+	uint32_t index = indices[id];
+	// frames in flight may still draw them
+	lvrDevice.releaseQueue().retire(std::move(models_[index]));
+	lvrDevice.releaseQueue().retire(std::move(diffuseMaps_[index]));
+
+	// the last object fills the hole so the arrays stay dense
+	uint32_t last = size() - 1;
+	auto removeAt = [&](auto& array) {
+		if (index != last) array[index] = std::move(array[last]);
+		array.pop_back();
+	};
+	removeAt(ids_);
+	removeAt(translations_);
+	removeAt(rotations_);
+	removeAt(scales_);
+	removeAt(colors_);
+	removeAt(models_);
+	removeAt(diffuseMaps_);
+	removeAt(matrices_);
+	removeAt(dirty_);
+	if (index != last) {
+		indices[ids_[index]] = index;
+		// the moved object's slot in every frame's buffer still holds the destroyed one
+		dirty_[index] |= FRAMES_DIRTY | DRAWS_DIRTY;
+	}
+
+	pointLights_.erase(id);
+	indices[id] = INVALID_INDEX;
+	generations[id]++;
+	freeIds.push_back(id);
+}
+
+GameObjectManager::GameObjectManager(Device& device, uint32_t initialCapacity)
+	: lvrDevice{device}, initialCapacity{initialCapacity} {
+	if (device.supportsBindless()) {
+		for (int i = 0; i < objectBuffers.size(); i++) {
+			objectBuffers[i] = createObjectBuffer(initialCapacity);
+		}
 	}
 
 	textureDefault = Texture::createTextureFromFile(device, "textures/missing.png");
 }
-void GameObjectManager::updateBuffer(int frameIndex) {
-	// copy model matrix and normal matrix for each gameObj into
-	// buffer for this frame
-	for (auto& kv : gameObjects) {
-		auto& obj = kv.second;
-		GameObjectBufferData data{};
-		data.modelMatrix = obj.transform.mat4();
-		data.normalMatrix = obj.transform.normalMatrix();
-		uboBuffers[frameIndex]->writeToIndex(&data, kv.first);
-	}
-	uboBuffers[frameIndex]->flush();
+
+std::unique_ptr<Buffer> GameObjectManager::createObjectBuffer(uint32_t capacity) {
+	// shaders index the array directly, so it has to match the std430 stride
+	auto buffer = std::make_unique<Buffer>(
+		lvrDevice,
+		sizeof(GameObjectBufferData),
+		capacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		1);
+	buffer->map();
+	return buffer;
+}
+
+uint32_t GameObjectManager::rebuildMatrices(uint32_t begin, uint32_t end) {
+	uint32_t rebuilt = 0;
+	forEachDirtyRange(MATRIX_DIRTY, begin, end, [&](uint32_t first, uint32_t count) {
+		computeTransformMatrices(
+			&translations_[first],
+			&rotations_[first],
+			&scales_[first],
+			count,
+			&matrices_[first],
+			sizeof(GameObjectBufferData));
+		rebuilt += count;
+	});
+	return rebuilt;
 }
-VkDescriptorBufferInfo GameObject::getBufferInfo(int frameIndex) {
-	return gameObjectManager.getBufferInfoForGameObject(frameIndex, id);
+
+void GameObjectManager::updateBuffer(int frameIndex, utils::JobSystem& jobSystem) {
+	updateStatistics = {};
+	updateStatistics.objectCount = size();
+	const uint8_t frameDirty = 1u << frameIndex;
+
+	// without object buffers only the matrices are kept current, the frame dirty bits are left for
+	// whoever holds the frame's copy
+	if (!hasObjectBuffers()) {
+		std::atomic<uint32_t> matricesRebuilt{0};
+		jobSystem.parallelFor(size(), UPDATE_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+			matricesRebuilt += rebuildMatrices(begin, end);
+		});
+		updateStatistics.matricesRebuilt = matricesRebuilt;
+		return;
+	}
+
+	// the frame's last submission has finished, so its buffer can be replaced right away, the
+	// other frames grow on their own turn
+	auto& objectBuffer = objectBuffers[frameIndex];
+	if (size() > objectBuffer->getInstanceCount()) {
+		uint32_t capacity = std::max(objectBuffer->getInstanceCount(), 1u);
+		while (capacity < size()) capacity *= 2;
+		objectBuffer = createObjectBuffer(capacity);
+		objectBufferVersions[frameIndex]++;
+		for (auto& flags : dirty_) flags |= frameDirty;
+	}
+
+	// chunks of objects are updated in parallel, straight into the mapped buffer, they touch
+	// disjoint slots of every array
+	char* mapped = static_cast<char*>(objectBuffer->getMappedMemory());
+	VkDeviceSize stride = objectBuffer->getAlignmentSize();
+	std::atomic<uint32_t> matricesRebuilt{0};
+	std::atomic<uint32_t> objectsWritten{0};
+	std::atomic<uint32_t> flushedRanges{0};
+	jobSystem.parallelFor(size(), UPDATE_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+		// rebuild the matrices of changed objects once, however many frames still have to see them
+		uint32_t rebuilt = rebuildMatrices(begin, end);
+
+		// copy the ones this frame's buffer hasn't seen yet, and flush only around them
+		uint32_t written = 0;
+		uint32_t flushes = 0;
+		uint32_t flushFirst = begin;
+		uint32_t flushEnd = begin;
+		auto flushRange = [&]() {
+			if (flushEnd == flushFirst) return;
+			objectBuffer->flush((flushEnd - flushFirst) * stride, flushFirst * stride);
+			flushes++;
+		};
+		forEachDirtyRange(frameDirty, begin, end, [&](uint32_t first, uint32_t count) {
+			if (stride == sizeof(GameObjectBufferData)) {
+				memcpy(mapped + first * stride, &matrices_[first], count * stride);
+			} else {
+				for (uint32_t i = first; i < first + count; i++) {
+					memcpy(mapped + i * stride, &matrices_[i], sizeof(GameObjectBufferData));
+				}
+			}
+			written += count;
+
+			if (first > flushEnd + FLUSH_MERGE_DISTANCE) {
+				flushRange();
+				flushFirst = first;
+			}
+			flushEnd = first + count;
+		});
+		flushRange();
+
+		matricesRebuilt += rebuilt;
+		objectsWritten += written;
+		flushedRanges += flushes;
+	});
+	updateStatistics.matricesRebuilt = matricesRebuilt;
+	updateStatistics.objectsWritten = objectsWritten;
+	updateStatistics.flushedRanges = flushedRanges;
 }
-GameObject::GameObject(id_t objId, const GameObjectManager& manager)
-	: id{objId}, gameObjectManager{manager} {}
 
-}  // namespace lvr
\ No newline at end of file
+}  // namespace lvr
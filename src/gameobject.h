@@ -1,13 +1,19 @@
 #pragma once
 
+#include <cassert>
 #include <cstdint>
 #include <glm/gtc/matrix_transform.hpp>
+#include <limits>
 #include <memory>
-#include <unordered_map>
+#include <span>
+#include <utility>
+#include <vector>
 
 #include "model.h"
 #include "swapchain.h"
 #include "textures/texture.h"
+#include "utils/job_system.h"
+#include "utils/sparse_set.h"
 
 namespace lvr {
 
@@ -34,64 +40,244 @@ struct GameObjectBufferData {
 };
 class GameObjectManager;  // forward declare game object manager class
 
+// Handle to an object stored in a GameObjectManager, cheap to copy around. The accessors look the
+// object up on every call, references they return are invalidated by creating or destroying
+// objects. Ids are recycled after destruction, the generation tells a stale handle from the object
+// that took over its id.
 class GameObject {
    public:
 	using id_t = uint32_t;
-	using Map = std::unordered_map<id_t, GameObject>;
 
-	GameObject(GameObject &&) = default;
-	GameObject(const GameObject &) = delete;
-	GameObject &operator=(const GameObject &) = delete;
-	GameObject &operator=(GameObject &&) = delete;
+	GameObject() = default;
 
-	id_t getId() { return id; }
+	id_t getId() const { return id; }
+	uint32_t getGeneration() const { return generation; }
 
-	VkDescriptorBufferInfo getBufferInfo(int32_t frameIndex);
+	glm::vec3 &translation();
+	glm::vec3 &rotation();
+	glm::vec3 &scale();
+	glm::vec4 &color();
+	std::shared_ptr<Model> &model();
+	std::shared_ptr<Texture> &diffuseMap();
+	// nullptr unless the object is a point light
+	PointLightComponent *pointLight();
 
-	glm::vec4 color{};
-	TransformComponent transform{};
-
-	std::shared_ptr<Model> model{};
-	std::shared_ptr<Texture> diffuseMap = nullptr;
-	std::unique_ptr<PointLightComponent> pointLight = nullptr;
+	TransformComponent getTransform();
 
    private:
-	GameObject(id_t objId, const GameObjectManager &mananger);
+	GameObject(GameObjectManager &manager, id_t objId, uint32_t objGeneration)
+		: gameObjectManager{&manager}, id{objId}, generation{objGeneration} {}
+
+	uint32_t index() const;
 
-	id_t id;
+	GameObjectManager *gameObjectManager = nullptr;
+	id_t id = 0;
+	uint32_t generation = 0;
 
-	const GameObjectManager &gameObjectManager;
 	friend class GameObjectManager;
 };
+
+// Owns every object's components in parallel dense arrays, entry i of each array belongs to the
+// same object, so systems walk them linearly instead of chasing per object allocations. Ids are
+// stable while an object lives, the dense index of an object is also its slot in the object
+// buffers and changes when other objects are destroyed. Optional components live in sparse sets
+// keyed by id. The per frame object buffers grow with the object count.
+//
+// Transforms are only writable through GameObject or the *At accessors, which mark the object
+// dirty. updateBuffer rebuilds the matrices of dirty objects once and copies them into each frame's
+// buffer the next time that frame comes around, so static objects cost nothing per frame. Models
+// and diffuse maps are only writable through GameObject or modelAt/diffuseMapAt too, which mark the
+// object's draw data dirty for every frame.
 class GameObjectManager {
    public:
-	static constexpr int MAX_GAME_OBJECTS = 1000;
-	GameObjectManager(Device &device);
+	static constexpr uint32_t INITIAL_CAPACITY = 1024;
+
+	struct UpdateStatistics {
+		uint32_t objectCount = 0;
+		// objects whose matrices were rebuilt, and written into the frame's buffer
+		uint32_t matricesRebuilt = 0;
+		uint32_t objectsWritten = 0;
+		uint32_t flushedRanges = 0;
+	};
+
+	GameObjectManager(Device &device, uint32_t initialCapacity = INITIAL_CAPACITY);
 	GameObjectManager(const GameObjectManager &) = delete;
 	GameObjectManager &operator=(const GameObjectManager &) = delete;
 	GameObjectManager(GameObjectManager &&) = delete;
 	GameObjectManager &operator=(GameObjectManager &&) = delete;
-	GameObject &createGameObject() {
-		assert(currentId < MAX_GAME_OBJECTS && "Max game object count exceeded!");
-		auto gameObject = GameObject{currentId++, *this};
-		auto gameObjectId = gameObject.getId();
-		gameObject.diffuseMap = textureDefault;
-		gameObjects.emplace(gameObjectId, std::move(gameObject));
-		return gameObjects.at(gameObjectId);
-	}
-	GameObject &makePointLight(
+
+	GameObject createGameObject();
+	GameObject makePointLight(
 		float intensity = 10.f, float radius = 0.1f, glm::vec4 color = glm::vec4(1.f));
-	VkDescriptorBufferInfo getBufferInfoForGameObject(
-		int frameIndex, GameObject::id_t gameObjectId) const {
-		return uboBuffers[frameIndex]->descriptorInfoForIndex(gameObjectId);
+	// The model and texture are kept alive until frames in flight are done with them
+	void destroyGameObject(GameObject gameObject);
+
+	bool isAlive(GameObject gameObject) const {
+		return gameObject.id < indices.size() && indices[gameObject.id] != INVALID_INDEX &&
+			   generations[gameObject.id] == gameObject.generation;
+	}
+	uint32_t indexOf(GameObject::id_t id) const { return indices[id]; }
+	uint32_t size() const { return static_cast<uint32_t>(ids_.size()); }
+	// Objects the frame's object buffer has room for
+	uint32_t getCapacity(int frameIndex) const {
+		return hasObjectBuffers() ? objectBuffers[frameIndex]->getInstanceCount()
+								  : initialCapacity;
+	}
+	// Only bindless shaders read the object buffers, otherwise the renderer's instance buffers
+	// carry the matrices
+	bool hasObjectBuffers() const { return objectBuffers[0] != nullptr; }
+	// Changes whenever the frame's object buffer is reallocated, descriptors pointing at it have
+	// to be rewritten
+	uint32_t getObjectBufferVersion(int frameIndex) const {
+		return objectBufferVersions[frameIndex];
+	}
+
+	// Dense component arrays
+	std::span<const GameObject::id_t> ids() const { return ids_; }
+	std::span<const glm::vec3> translations() const { return translations_; }
+	std::span<const glm::vec3> rotations() const { return rotations_; }
+	std::span<const glm::vec3> scales() const { return scales_; }
+	glm::vec3 &translationAt(uint32_t index) {
+		markTransformDirty(index);
+		return translations_[index];
+	}
+	glm::vec3 &rotationAt(uint32_t index) {
+		markTransformDirty(index);
+		return rotations_[index];
+	}
+	glm::vec3 &scaleAt(uint32_t index) {
+		markTransformDirty(index);
+		return scales_[index];
 	}
-	void updateBuffer(int frameIndex);
-	GameObject::Map gameObjects{};
-	std::vector<std::unique_ptr<Buffer>> uboBuffers{SwapChain::MAX_FRAMES_IN_FLIGHT};
+	void markTransformDirty(uint32_t index) { dirty_[index] |= MATRIX_DIRTY | FRAMES_DIRTY; }
+	std::span<glm::vec4> colors() { return colors_; }
+	std::span<const std::shared_ptr<Model>> models() const { return models_; }
+	std::span<const std::shared_ptr<Texture>> diffuseMaps() const { return diffuseMaps_; }
+	std::shared_ptr<Model> &modelAt(uint32_t index) {
+		dirty_[index] |= DRAWS_DIRTY;
+		return models_[index];
+	}
+	std::shared_ptr<Texture> &diffuseMapAt(uint32_t index) {
+		dirty_[index] |= DRAWS_DIRTY;
+		return diffuseMaps_[index];
+	}
+	utils::SparseSet<PointLightComponent> &pointLights() { return pointLights_; }
+
+	// The whole buffer of the frame, indexed by dense object index. Needs hasObjectBuffers().
+	VkDescriptorBufferInfo getObjectBufferInfo(int frameIndex) const {
+		return objectBuffers[frameIndex]->descriptorInfo();
+	}
+	// Model and normal matrices in dense order, current after updateBuffer
+	std::span<const GameObjectBufferData> matrices() const { return matrices_; }
+	// Rebuilds the matrices of changed objects. With object buffers it also grows the frame's
+	// buffer when needed and writes the objects that changed since the frame was last updated,
+	// split over the job system's threads. Call once per frame, after the frame's fence was
+	// waited on.
+	void updateBuffer(int frameIndex, utils::JobSystem &jobSystem);
+	// Without object buffers the frame's copy of the matrices lives elsewhere. Calls
+	// fn(first, count) for each run of objects in [begin, end) that changed since the last call for
+	// the frame. Disjoint ranges can be walked in parallel.
+	template <typename Fn>
+	void forEachFrameDirtyRange(int frameIndex, uint32_t begin, uint32_t end, Fn &&fn) {
+		forEachDirtyRange(1u << frameIndex, begin, end, std::forward<Fn>(fn));
+	}
+	// Like forEachFrameDirtyRange, for the objects whose model or diffuse map changed or that moved
+	// to another index since the last call for the frame
+	template <typename Fn>
+	void forEachFrameDrawDirtyRange(int frameIndex, uint32_t begin, uint32_t end, Fn &&fn) {
+		forEachDirtyRange(
+			1u << (DRAWS_DIRTY_SHIFT + frameIndex),
+			begin,
+			end,
+			std::forward<Fn>(fn));
+	}
+	// Counters of the last updateBuffer call
+	UpdateStatistics getUpdateStatistics() const { return updateStatistics; }
 
    private:
-	GameObject::id_t currentId = 0;
+	static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+	// dirty bits per object: one per frame in flight whose buffer is stale, one for the matrices
+	// and one per frame in flight whose draw data is stale
+	static_assert(2 * SwapChain::MAX_FRAMES_IN_FLIGHT < 8, "Dirty bits don't fit in a byte!");
+	static constexpr uint8_t FRAMES_DIRTY = (1u << SwapChain::MAX_FRAMES_IN_FLIGHT) - 1;
+	static constexpr uint8_t MATRIX_DIRTY = 1u << SwapChain::MAX_FRAMES_IN_FLIGHT;
+	static constexpr uint32_t DRAWS_DIRTY_SHIFT = SwapChain::MAX_FRAMES_IN_FLIGHT + 1;
+	static constexpr uint8_t DRAWS_DIRTY = FRAMES_DIRTY << DRAWS_DIRTY_SHIFT;
+	// dirty ranges closer than this many objects are flushed together
+	static constexpr uint32_t FLUSH_MERGE_DISTANCE = 16;
+	// objects per updateBuffer job
+	static constexpr uint32_t UPDATE_GRAIN_SIZE = 2048;
+
+	std::unique_ptr<Buffer> createObjectBuffer(uint32_t capacity);
+	// Rebuilds the matrices of the changed objects in [begin, end), returns how many
+	uint32_t rebuildMatrices(uint32_t begin, uint32_t end);
+	// Calls fn(first, count) for each run of objects in [begin, end) with `flag` set and clears it
+	template <typename Fn>
+	void forEachDirtyRange(uint8_t flag, uint32_t begin, uint32_t end, Fn &&fn) {
+		for (uint32_t i = begin; i < end;) {
+			if (!(dirty_[i] & flag)) {
+				i++;
+				continue;
+			}
+			uint32_t first = i;
+			for (; i < end && (dirty_[i] & flag); i++) {
+				dirty_[i] &= ~flag;
+			}
+			fn(first, i - first);
+		}
+	}
+
+	Device &lvrDevice;
+	// One GameObjectBufferData per object and frame in a tightly packed storage buffer, only
+	// created with bindless descriptors
+	std::vector<std::unique_ptr<Buffer>> objectBuffers{SwapChain::MAX_FRAMES_IN_FLIGHT};
+	uint32_t initialCapacity;
+	std::vector<uint32_t> objectBufferVersions =
+		std::vector<uint32_t>(SwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+
+	// id -> dense index and current generation
+	std::vector<uint32_t> indices{};
+	std::vector<uint32_t> generations{};
+	std::vector<GameObject::id_t> freeIds{};
+
+	UpdateStatistics updateStatistics{};
+
+	std::vector<GameObject::id_t> ids_{};
+	std::vector<glm::vec3> translations_{};
+	std::vector<glm::vec3> rotations_{};
+	std::vector<glm::vec3> scales_{};
+	std::vector<glm::vec4> colors_{};
+	std::vector<std::shared_ptr<Model>> models_{};
+	std::vector<std::shared_ptr<Texture>> diffuseMaps_{};
+	std::vector<GameObjectBufferData> matrices_{};
+	std::vector<uint8_t> dirty_{};
+	utils::SparseSet<PointLightComponent> pointLights_{};
+
 	std::shared_ptr<Texture> textureDefault;
 };
 
+inline uint32_t GameObject::index() const {
+	assert(gameObjectManager->isAlive(*this) && "Game object was destroyed!");
+	return gameObjectManager->indexOf(id);
+}
+inline glm::vec3 &GameObject::translation() { return gameObjectManager->translationAt(index()); }
+inline glm::vec3 &GameObject::rotation() { return gameObjectManager->rotationAt(index()); }
+inline glm::vec3 &GameObject::scale() { return gameObjectManager->scaleAt(index()); }
+inline glm::vec4 &GameObject::color() { return gameObjectManager->colors()[index()]; }
+inline std::shared_ptr<Model> &GameObject::model() { return gameObjectManager->modelAt(index()); }
+inline std::shared_ptr<Texture> &GameObject::diffuseMap() {
+	return gameObjectManager->diffuseMapAt(index());
+}
+inline PointLightComponent *GameObject::pointLight() {
+	assert(gameObjectManager->isAlive(*this) && "Game object was destroyed!");
+	return gameObjectManager->pointLights().find(id);
+}
+inline TransformComponent GameObject::getTransform() {
+	uint32_t i = index();
+	return TransformComponent{
+		gameObjectManager->translations()[i],
+		gameObjectManager->scales()[i],
+		gameObjectManager->rotations()[i]};
+}
+
 }  // namespace lvr
\ No newline at end of file
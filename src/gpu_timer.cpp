@@ -0,0 +1,124 @@
+#include "gpu_timer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace lvr {
+
+GpuTimer::GpuTimer(Device &device) : device{device} {
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(
+		device.getPhysicalDevice(),
+		&queueFamilyCount,
+		nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(
+		device.getPhysicalDevice(),
+		&queueFamilyCount,
+		queueFamilies.data());
+
+	uint32_t graphicsFamily = device.findPhysicalQueueFamilies().graphicsAndComputeFamily.value();
+	if (queueFamilies[graphicsFamily].timestampValidBits == 0 ||
+		queueFamilies[device.computeQueueFamily()].timestampValidBits == 0) {
+		std::cout << "gpu timer: timestamps not supported on the graphics and compute queues"
+				  << std::endl;
+		return;
+	}
+	timestampPeriod = device.properties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = QUERIES_PER_FRAME * SwapChain::MAX_FRAMES_IN_FLIGHT;
+	if (vkCreateQueryPool(device.device(), &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timestamp query pool!");
+	}
+}
+
+GpuTimer::~GpuTimer() {
+	if (queryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(device.device(), queryPool, nullptr);
+	}
+}
+
+void GpuTimer::begin(VkCommandBuffer commandBuffer, Queue queue, int32_t frameIndex) {
+	if (!isSupported()) return;
+
+	recordedQueues[frameIndex] &= ~(1u << static_cast<uint32_t>(queue));
+	vkCmdResetQueryPool(commandBuffer, queryPool, queryIndex(queue, frameIndex, false), 2);
+	vkCmdWriteTimestamp(
+		commandBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		queryPool,
+		queryIndex(queue, frameIndex, false));
+}
+
+void GpuTimer::end(VkCommandBuffer commandBuffer, Queue queue, int32_t frameIndex) {
+	if (!isSupported()) return;
+
+	vkCmdWriteTimestamp(
+		commandBuffer,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		queryPool,
+		queryIndex(queue, frameIndex, true));
+	recordedQueues[frameIndex] |= 1u << static_cast<uint32_t>(queue);
+}
+
+void GpuTimer::collect(int32_t frameIndex) {
+	// only frames that timed both queues tell anything about overlap
+	if (!isSupported() || recordedQueues[frameIndex] != 0b11) return;
+
+	std::array<uint64_t, QUERIES_PER_FRAME> timestamps{};
+	VkResult result = vkGetQueryPoolResults(
+		device.device(),
+		queryPool,
+		queryIndex(Queue::Compute, frameIndex, false),
+		QUERIES_PER_FRAME,
+		sizeof(timestamps),
+		timestamps.data(),
+		sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT);
+	recordedQueues[frameIndex] = 0;
+	if (result != VK_SUCCESS) return;
+
+	uint64_t computeBegin = timestamps[queryIndex(Queue::Compute, 0, false)];
+	uint64_t computeEnd = timestamps[queryIndex(Queue::Compute, 0, true)];
+	uint64_t graphicsBegin = timestamps[queryIndex(Queue::Graphics, 0, false)];
+	uint64_t graphicsEnd = timestamps[queryIndex(Queue::Graphics, 0, true)];
+
+	uint64_t overlapBegin = std::max(computeBegin, graphicsBegin);
+	uint64_t overlapEnd = std::min(computeEnd, graphicsEnd);
+
+	computeNs += static_cast<double>(computeEnd - computeBegin) * timestampPeriod;
+	graphicsNs += static_cast<double>(graphicsEnd - graphicsBegin) * timestampPeriod;
+	if (overlapEnd > overlapBegin) {
+		overlapNs += static_cast<double>(overlapEnd - overlapBegin) * timestampPeriod;
+	}
+
+	if (++sampleCount == REPORT_INTERVAL) {
+		report();
+	}
+}
+
+void GpuTimer::report() {
+	double computeMs = computeNs / sampleCount / 1e6;
+	double graphicsMs = graphicsNs / sampleCount / 1e6;
+	double overlapMs = overlapNs / sampleCount / 1e6;
+	double overlapPercent = computeNs > 0.0 ? 100.0 * overlapNs / computeNs : 0.0;
+
+	std::cout << std::fixed << std::setprecision(3) << "gpu timings over " << sampleCount
+			  << " frames (" << (device.hasAsyncComputeQueue() ? "async" : "shared")
+			  << " compute queue): compute " << computeMs << " ms, graphics " << graphicsMs
+			  << " ms, overlap " << overlapMs << " ms (" << std::setprecision(1) << overlapPercent
+			  << "% of compute)" << std::defaultfloat << std::endl;
+
+	sampleCount = 0;
+	computeNs = 0.0;
+	graphicsNs = 0.0;
+	overlapNs = 0.0;
+}
+
+}  // namespace lvr
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+
+#include "device.h"
+#include "swapchain.h"
+
+namespace lvr {
+
+// Timestamps the compute and graphics command buffers of every frame and periodically prints how
+// long each queue was busy and for how long the two ran at the same time. Results of a frame slot
+// are read back once its fences have signaled, the next time the slot comes around.
+class GpuTimer {
+   public:
+	enum class Queue { Compute = 0, Graphics = 1 };
+
+	static constexpr uint32_t REPORT_INTERVAL = 500;
+
+	GpuTimer(Device &device);
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer &) = delete;
+	GpuTimer &operator=(const GpuTimer &) = delete;
+
+	// Call at the start of a frame, after the slot's fences were waited on.
+	void collect(int32_t frameIndex);
+	// Record at the very start and end of the command buffer, outside of any render pass.
+	void begin(VkCommandBuffer commandBuffer, Queue queue, int32_t frameIndex);
+	void end(VkCommandBuffer commandBuffer, Queue queue, int32_t frameIndex);
+
+	bool isSupported() const { return queryPool != VK_NULL_HANDLE; }
+
+   private:
+	static constexpr uint32_t QUERIES_PER_FRAME = 4;
+
+	uint32_t queryIndex(Queue queue, int32_t frameIndex, bool end) const {
+		return static_cast<uint32_t>(frameIndex) * QUERIES_PER_FRAME +
+			   static_cast<uint32_t>(queue) * 2 + (end ? 1 : 0);
+	}
+	void report();
+
+	Device &device;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	double timestampPeriod = 1.0;
+	// bit per queue, set once both timestamps of the slot have been recorded
+	std::array<uint32_t, SwapChain::MAX_FRAMES_IN_FLIGHT> recordedQueues{};
+
+	uint32_t sampleCount = 0;
+	double computeNs = 0.0;
+	double graphicsNs = 0.0;
+	double overlapNs = 0.0;
+};
+
+}  // namespace lvr
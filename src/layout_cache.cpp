@@ -0,0 +1,179 @@
+#include "layout_cache.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lvr {
+
+// *************** Shader Layout *********************
+
+ShaderLayout::ShaderLayout(const std::vector<std::unique_ptr<Shader>> &shaders) {
+	for (const auto &shader : shaders) {
+		const Source &source = shader->getSource();
+		VkShaderStageFlags stages = source.shaderBitFlags == VK_SHADER_STAGE_COMPUTE_BIT
+										? VK_SHADER_STAGE_COMPUTE_BIT
+										: VK_SHADER_STAGE_ALL_GRAPHICS;
+		for (const auto &reflected : source.reflection.bindings) {
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = reflected.binding;
+			binding.descriptorType = reflected.descriptorType;
+			binding.descriptorCount = reflected.count;
+			binding.stageFlags = stages;
+			addBinding(reflected.set, binding);
+		}
+
+		// ranges have to name exactly the stages vkCmdPushConstants is called with
+		if (source.reflection.pushConstantSize > 0) {
+			pushConstantRange.stageFlags |= source.shaderBitFlags;
+			pushConstantRange.size =
+				std::max(pushConstantRange.size, source.reflection.pushConstantSize);
+		}
+	}
+}
+
+ShaderLayout &ShaderLayout::setBindingCount(uint32_t set, uint32_t binding, uint32_t count) {
+	getBinding(set, binding).descriptorCount = count;
+	return *this;
+}
+
+ShaderLayout &ShaderLayout::setBindingFlags(
+	uint32_t set, uint32_t binding, VkDescriptorBindingFlags flags) {
+	getBinding(set, binding);
+	sets[set].bindingFlags[binding] = flags;
+	return *this;
+}
+
+ShaderLayout &ShaderLayout::mergeSet(uint32_t set, const ShaderLayout &other, uint32_t otherSet) {
+	assert(otherSet < other.sets.size() && "Merged set isn't used by the other shaders");
+	if (set >= sets.size()) sets.resize(set + 1);
+	for (const auto &kv : other.sets[otherSet].bindings) {
+		addBinding(set, kv.second);
+	}
+	for (const auto &kv : other.sets[otherSet].bindingFlags) {
+		sets[set].bindingFlags[kv.first] |= kv.second;
+	}
+	return *this;
+}
+
+void ShaderLayout::addBinding(uint32_t set, const VkDescriptorSetLayoutBinding &binding) {
+	if (set >= sets.size()) sets.resize(set + 1);
+
+	auto &bindings = sets[set].bindings;
+	auto existing = bindings.find(binding.binding);
+	if (existing == bindings.end()) {
+		bindings.emplace(binding.binding, binding);
+		return;
+	}
+	assert(
+		existing->second.descriptorType == binding.descriptorType &&
+		"Stages declare one binding with different descriptor types");
+	existing->second.stageFlags |= binding.stageFlags;
+	existing->second.descriptorCount =
+		std::max(existing->second.descriptorCount, binding.descriptorCount);
+}
+
+VkDescriptorSetLayoutBinding &ShaderLayout::getBinding(uint32_t set, uint32_t binding) {
+	assert(
+		set < sets.size() && sets[set].bindings.count(binding) == 1 &&
+		"Binding isn't declared by the shaders");
+	return sets[set].bindings.at(binding);
+}
+
+// *************** Layout Cache *********************
+
+LayoutCache::LayoutCache(Device &lvrDevice) : lvrDevice{lvrDevice} {}
+
+LayoutCache::~LayoutCache() {
+	for (auto &kv : pipelineLayouts) {
+		vkDestroyPipelineLayout(lvrDevice.device(), kv.second, nullptr);
+	}
+}
+
+size_t LayoutCache::KeyHash::operator()(const std::vector<uint64_t> &key) const {
+	uint64_t hash = 14695981039346656037ull;
+	for (uint64_t word : key) {
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+DescriptorSetLayout &LayoutCache::getSetLayout(
+	const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> &bindings,
+	const std::unordered_map<uint32_t, VkDescriptorBindingFlags> &bindingFlags) {
+	statistics.setLayoutRequests++;
+
+	// the maps don't iterate in a fixed order, key on the bindings sorted by index
+	std::vector<const VkDescriptorSetLayoutBinding *> sorted{};
+	for (const auto &kv : bindings) {
+		sorted.push_back(&kv.second);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const auto *a, const auto *b) {
+		return a->binding < b->binding;
+	});
+
+	key.clear();
+	for (const auto *binding : sorted) {
+		if (binding->descriptorCount == 0) {
+			throw std::runtime_error("runtime sized descriptor array has no count!");
+		}
+		auto flags = bindingFlags.find(binding->binding);
+		key.push_back((static_cast<uint64_t>(binding->binding) << 32) | binding->descriptorType);
+		key.push_back(
+			(static_cast<uint64_t>(binding->descriptorCount) << 32) | binding->stageFlags);
+		key.push_back(flags != bindingFlags.end() ? flags->second : 0);
+	}
+
+	auto &setLayout = setLayouts[key];
+	if (setLayout == nullptr) {
+		setLayout = std::make_unique<DescriptorSetLayout>(lvrDevice, bindings, bindingFlags);
+		statistics.setLayoutCount++;
+	}
+	return *setLayout;
+}
+
+DescriptorSetLayout &LayoutCache::getSetLayout(const ShaderLayout &layout, uint32_t set) {
+	if (set >= layout.sets.size()) return getSetLayout({}, {});
+	return getSetLayout(layout.sets[set].bindings, layout.sets[set].bindingFlags);
+}
+
+VkPipelineLayout LayoutCache::getPipelineLayout(const ShaderLayout &layout) {
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{};
+	for (uint32_t set = 0; set < layout.getSetCount(); set++) {
+		descriptorSetLayouts.push_back(getSetLayout(layout, set).getDescriptorSetLayout());
+	}
+	statistics.pipelineLayoutRequests++;
+
+	const VkPushConstantRange &pushConstantRange = layout.getPushConstantRange();
+	key.clear();
+	for (VkDescriptorSetLayout setLayout : descriptorSetLayouts) {
+		key.push_back(reinterpret_cast<uint64_t>(setLayout));
+	}
+	key.push_back(pushConstantRange.stageFlags);
+	key.push_back(
+		(static_cast<uint64_t>(pushConstantRange.offset) << 32) | pushConstantRange.size);
+
+	auto cached = pipelineLayouts.find(key);
+	if (cached != pipelineLayouts.end()) return cached->second;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+	if (pushConstantRange.size > 0) {
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	}
+
+	VkPipelineLayout pipelineLayout;
+	if (vkCreatePipelineLayout(lvrDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
+		VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout");
+	}
+	pipelineLayouts.emplace(key, pipelineLayout);
+	statistics.pipelineLayoutCount++;
+	return pipelineLayout;
+}
+
+}  // namespace lvr
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "descriptors.h"
+#include "device.h"
+#include "shaders/shader.h"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace lvr {
+
+// The descriptor sets and push constants a pipeline's shaders declare, reflected from their SPIR-V
+// and merged over the stages. A binding used by any graphics stage is visible to all of them, so
+// a set used by several pipelines, like the global set, comes out the same in each.
+class ShaderLayout {
+   public:
+	explicit ShaderLayout(const std::vector<std::unique_ptr<Shader>> &shaders);
+
+	// Runtime sized arrays reflect a count of 0 and need one before their layout is created
+	ShaderLayout &setBindingCount(uint32_t set, uint32_t binding, uint32_t count);
+	ShaderLayout &setBindingFlags(uint32_t set, uint32_t binding, VkDescriptorBindingFlags flags);
+	// Adds the bindings of set `otherSet` of `other` to `set`. A descriptor set bound to both
+	// pipelines needs the same layout in each.
+	ShaderLayout &mergeSet(uint32_t set, const ShaderLayout &other, uint32_t otherSet);
+
+	uint32_t getSetCount() const { return static_cast<uint32_t>(sets.size()); }
+	// Size 0 when the shaders have no push constants
+	const VkPushConstantRange &getPushConstantRange() const { return pushConstantRange; }
+
+   private:
+	struct Set {
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+		std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
+	};
+
+	void addBinding(uint32_t set, const VkDescriptorSetLayoutBinding &binding);
+	VkDescriptorSetLayoutBinding &getBinding(uint32_t set, uint32_t binding);
+
+	std::vector<Set> sets{};
+	VkPushConstantRange pushConstantRange{};
+
+	friend class LayoutCache;
+};
+
+// Creates every distinct descriptor set layout and pipeline layout once, keyed on the full binding
+// signature, and hands the same object to every system asking for an identical one. Layouts live
+// as long as the device. Not thread safe, they are requested while the systems are set up.
+class LayoutCache {
+   public:
+	struct Statistics {
+		uint32_t setLayoutRequests = 0;
+		uint32_t setLayoutCount = 0;
+		uint32_t pipelineLayoutRequests = 0;
+		uint32_t pipelineLayoutCount = 0;
+	};
+
+	LayoutCache(Device &lvrDevice);
+	~LayoutCache();
+	LayoutCache(const LayoutCache &) = delete;
+	LayoutCache &operator=(const LayoutCache &) = delete;
+
+	DescriptorSetLayout &getSetLayout(
+		const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> &bindings,
+		const std::unordered_map<uint32_t, VkDescriptorBindingFlags> &bindingFlags = {});
+	DescriptorSetLayout &getSetLayout(const ShaderLayout &layout, uint32_t set);
+	// One set layout per set up to the highest one the shaders use, unused sets get an empty one
+	VkPipelineLayout getPipelineLayout(const ShaderLayout &layout);
+
+	Statistics getStatistics() const { return statistics; }
+
+   private:
+	struct KeyHash {
+		size_t operator()(const std::vector<uint64_t> &key) const;
+	};
+
+	Device &lvrDevice;
+	std::unordered_map<std::vector<uint64_t>, std::unique_ptr<DescriptorSetLayout>, KeyHash>
+		setLayouts{};
+	std::unordered_map<std::vector<uint64_t>, VkPipelineLayout, KeyHash> pipelineLayouts{};
+	std::vector<uint64_t> key{};
+	Statistics statistics{};
+};
+
+}  // namespace lvr
@@ -1,10 +1,26 @@
 #include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <iostream>
 
 #include "application.h"
+#include "benchmarks/benchmarks.h"
+#include "textures/texture_cooker.h"
+
+int main(int argc, char **argv) {
+	if (argc > 1 && std::strcmp(argv[1], "--bench") == 0) {
+		if (argc < 3 || !lvr::benchmarks::run(argv[2])) {
+			lvr::benchmarks::listBenchmarks();
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	if (argc > 1 && std::strcmp(argv[1], "--cook-textures") == 0) {
+		const char *directory = argc > 2 ? argv[2] : "textures";
+		return lvr::TextureCooker::cookDirectory(directory) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
 
-int main() {
 	lvr::Application app{};
 
 	try {
@@ -13,4 +29,4 @@ int main() {
 		std::cerr << e.what() << '\n';
 		return EXIT_FAILURE;
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,363 @@
+#include "memory_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace lvr {
+
+namespace {
+
+uint32_t orderForSize(VkDeviceSize size) {
+	uint32_t order = 0;
+	while ((MemoryAllocator::MIN_ALLOCATION_SIZE << order) < size) order++;
+	return order;
+}
+
+VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment) {
+	return value / alignment * alignment;
+}
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+MemoryAllocator::MemoryAllocator(
+	VkDevice device,
+	VkPhysicalDevice physicalDevice,
+	const VkPhysicalDeviceProperties &properties)
+	: device{device},
+	  nonCoherentAtomSize{std::max<VkDeviceSize>(1, properties.limits.nonCoherentAtomSize)} {
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+}
+
+MemoryAllocator::~MemoryAllocator() {
+	for (auto &pool : pools) {
+		for (auto &block : pool.blocks) {
+			if (!block) continue;
+			if (block->allocationCount > 0) {
+				std::cerr << "memory allocator: block destroyed with " << block->allocationCount
+						  << " live allocations" << std::endl;
+			}
+			if (block->mapped) vkUnmapMemory(device, block->memory);
+			vkFreeMemory(device, block->memory, nullptr);
+		}
+	}
+}
+
+uint32_t MemoryAllocator::findMemoryType(
+	uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) &&
+			(memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const {
+	return memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+		   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+}
+
+bool MemoryAllocator::isHostCoherent(uint32_t memoryTypeIndex) const {
+	return memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+		   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+MemoryAllocator::Pool &MemoryAllocator::getPool(
+	uint32_t memoryTypeIndex, ResourceKind kind, uint32_t &poolIndex) {
+	for (poolIndex = 0; poolIndex < pools.size(); poolIndex++) {
+		if (pools[poolIndex].memoryTypeIndex == memoryTypeIndex && pools[poolIndex].kind == kind) {
+			return pools[poolIndex];
+		}
+	}
+
+	// small heaps (e.g. the 256MB BAR heap) get smaller blocks so one block can't starve them
+	VkDeviceSize heapSize =
+		memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+	VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE;
+	while (blockSize > MIN_ALLOCATION_SIZE * 1024 && blockSize > heapSize / 8) {
+		blockSize /= 2;
+	}
+
+	Pool pool{};
+	pool.memoryTypeIndex = memoryTypeIndex;
+	pool.kind = kind;
+	pool.blockSize = blockSize;
+	pool.maxOrder = orderForSize(blockSize);
+	pools.push_back(std::move(pool));
+	poolIndex = static_cast<uint32_t>(pools.size() - 1);
+	return pools.back();
+}
+
+MemoryAllocator::Block *MemoryAllocator::createBlock(Pool &pool, uint32_t &blockIndex) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = pool.blockSize;
+	allocInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+	auto block = std::make_unique<Block>();
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate memory block!");
+	}
+	if (isHostVisible(pool.memoryTypeIndex) &&
+		vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+		throw std::runtime_error("failed to map memory block!");
+	}
+
+	block->freeLists.resize(pool.maxOrder + 1);
+	block->freeLists[pool.maxOrder].insert(0);
+	block->freeBytes = pool.blockSize;
+
+	// reuse a slot released by an emptied block so block indices in live allocations stay valid
+	for (blockIndex = 0; blockIndex < pool.blocks.size(); blockIndex++) {
+		if (!pool.blocks[blockIndex]) {
+			pool.blocks[blockIndex] = std::move(block);
+			return pool.blocks[blockIndex].get();
+		}
+	}
+	pool.blocks.push_back(std::move(block));
+	return pool.blocks.back().get();
+}
+
+bool MemoryAllocator::allocateFromBlock(
+	Block &block, uint32_t order, uint32_t maxOrder, VkDeviceSize &offset) {
+	uint32_t sourceOrder = order;
+	while (sourceOrder <= maxOrder && block.freeLists[sourceOrder].empty()) sourceOrder++;
+	if (sourceOrder > maxOrder) return false;
+
+	offset = *block.freeLists[sourceOrder].begin();
+	block.freeLists[sourceOrder].erase(block.freeLists[sourceOrder].begin());
+
+	// split down to the requested order, keeping the upper halves free
+	while (sourceOrder > order) {
+		sourceOrder--;
+		block.freeLists[sourceOrder].insert(offset + (MIN_ALLOCATION_SIZE << sourceOrder));
+	}
+
+	block.freeBytes -= MIN_ALLOCATION_SIZE << order;
+	block.allocationCount++;
+	return true;
+}
+
+void MemoryAllocator::freeToBlock(
+	Block &block, uint32_t order, uint32_t maxOrder, VkDeviceSize offset) {
+	block.freeBytes += MIN_ALLOCATION_SIZE << order;
+	block.allocationCount--;
+
+	// merge with the buddy for as long as it is free
+	while (order < maxOrder) {
+		VkDeviceSize buddy = offset ^ (MIN_ALLOCATION_SIZE << order);
+		auto it = block.freeLists[order].find(buddy);
+		if (it == block.freeLists[order].end()) break;
+
+		block.freeLists[order].erase(it);
+		offset = std::min(offset, buddy);
+		order++;
+	}
+	block.freeLists[order].insert(offset);
+}
+
+Allocation MemoryAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	Allocation allocation{};
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate dedicated memory!");
+	}
+	if (isHostVisible(memoryTypeIndex) &&
+		vkMapMemory(device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped) !=
+			VK_SUCCESS) {
+		throw std::runtime_error("failed to map dedicated memory!");
+	}
+
+	allocation.size = size;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.dedicated = true;
+
+	dedicatedAllocationCount++;
+	dedicatedBytes += size;
+	return allocation;
+}
+
+Allocation MemoryAllocator::allocate(
+	const VkMemoryRequirements &requirements,
+	VkMemoryPropertyFlags properties,
+	ResourceKind kind) {
+	std::lock_guard<std::mutex> lock{mutex};
+
+	uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+	uint32_t poolIndex;
+	Pool &pool = getPool(memoryTypeIndex, kind, poolIndex);
+
+	// buddy offsets are aligned to their own size, so folding the alignment (and the atom size
+	// for flushes of non coherent memory) into the size satisfies both
+	VkDeviceSize alignment = requirements.alignment;
+	if (isHostVisible(memoryTypeIndex) && !isHostCoherent(memoryTypeIndex)) {
+		alignment = std::max(alignment, nonCoherentAtomSize);
+	}
+	VkDeviceSize requiredSize = std::max(requirements.size, alignment);
+
+	Allocation allocation{};
+	if (requiredSize > pool.blockSize / 2) {
+		allocation =
+			allocateDedicated(alignUp(requirements.size, nonCoherentAtomSize), memoryTypeIndex);
+	} else {
+		uint32_t order = orderForSize(requiredSize);
+		VkDeviceSize offset = 0;
+		uint32_t blockIndex = 0;
+		Block *block = nullptr;
+
+		for (blockIndex = 0; blockIndex < pool.blocks.size(); blockIndex++) {
+			if (pool.blocks[blockIndex] &&
+				allocateFromBlock(*pool.blocks[blockIndex], order, pool.maxOrder, offset)) {
+				block = pool.blocks[blockIndex].get();
+				break;
+			}
+		}
+		if (block == nullptr) {
+			block = createBlock(pool, blockIndex);
+			allocateFromBlock(*block, order, pool.maxOrder, offset);
+		}
+
+		allocation.memory = block->memory;
+		allocation.offset = offset;
+		allocation.size = MIN_ALLOCATION_SIZE << order;
+		allocation.mapped =
+			block->mapped ? static_cast<char *>(block->mapped) + offset : nullptr;
+		allocation.memoryTypeIndex = memoryTypeIndex;
+		allocation.poolIndex = poolIndex;
+		allocation.blockIndex = blockIndex;
+		allocation.order = order;
+	}
+
+	allocation.requestedSize = requirements.size;
+
+	allocationCount++;
+	bytesAllocated += allocation.size;
+	bytesRequested += requirements.size;
+	return allocation;
+}
+
+void MemoryAllocator::free(Allocation &allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) return;
+
+	std::lock_guard<std::mutex> lock{mutex};
+
+	if (allocation.dedicated) {
+		if (allocation.mapped) vkUnmapMemory(device, allocation.memory);
+		vkFreeMemory(device, allocation.memory, nullptr);
+		dedicatedAllocationCount--;
+		dedicatedBytes -= allocation.size;
+	} else {
+		Pool &pool = pools[allocation.poolIndex];
+		auto &block = pool.blocks[allocation.blockIndex];
+		assert(block && block->memory == allocation.memory && "Allocation freed twice");
+		freeToBlock(*block, allocation.order, pool.maxOrder, allocation.offset);
+
+		// give empty blocks back to the driver, but keep one around to avoid churn
+		if (block->allocationCount == 0) {
+			uint32_t liveBlocks = 0;
+			for (auto &other : pool.blocks) {
+				if (other) liveBlocks++;
+			}
+			if (liveBlocks > 1) {
+				if (block->mapped) vkUnmapMemory(device, block->memory);
+				vkFreeMemory(device, block->memory, nullptr);
+				block.reset();
+			}
+		}
+	}
+
+	allocationCount--;
+	bytesAllocated -= allocation.size;
+	bytesRequested -= allocation.requestedSize;
+	allocation = Allocation{};
+}
+
+VkMappedMemoryRange MemoryAllocator::getMappedRange(
+	const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) const {
+	VkDeviceSize begin = allocation.offset + offset;
+	VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+
+	VkMappedMemoryRange mappedRange = {};
+	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	mappedRange.memory = allocation.memory;
+	mappedRange.offset = alignDown(begin, nonCoherentAtomSize);
+	// allocations in non coherent memory are atom aligned, so rounding up stays inside them
+	mappedRange.size =
+		std::min(alignUp(end, nonCoherentAtomSize), allocation.offset + allocation.size) -
+		mappedRange.offset;
+	return mappedRange;
+}
+
+VkResult MemoryAllocator::flush(
+	const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+	if (isHostCoherent(allocation.memoryTypeIndex)) return VK_SUCCESS;
+
+	VkMappedMemoryRange mappedRange = getMappedRange(allocation, size, offset);
+	return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
+}
+
+VkResult MemoryAllocator::invalidate(
+	const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+	if (isHostCoherent(allocation.memoryTypeIndex)) return VK_SUCCESS;
+
+	VkMappedMemoryRange mappedRange = getMappedRange(allocation, size, offset);
+	return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
+}
+
+MemoryAllocator::Statistics MemoryAllocator::getStatistics() {
+	std::lock_guard<std::mutex> lock{mutex};
+
+	Statistics statistics{};
+	statistics.dedicatedAllocationCount = dedicatedAllocationCount;
+	statistics.allocationCount = allocationCount;
+	statistics.bytesReserved = dedicatedBytes;
+	statistics.bytesAllocated = bytesAllocated;
+	statistics.bytesRequested = bytesRequested;
+
+	VkDeviceSize totalFree = 0;
+	VkDeviceSize contiguousFree = 0;
+	for (const auto &pool : pools) {
+		for (const auto &block : pool.blocks) {
+			if (!block) continue;
+			statistics.blockCount++;
+			statistics.bytesReserved += pool.blockSize;
+			totalFree += block->freeBytes;
+
+			for (uint32_t order = pool.maxOrder + 1; order-- > 0;) {
+				if (!block->freeLists[order].empty()) {
+					contiguousFree += MIN_ALLOCATION_SIZE << order;
+					break;
+				}
+			}
+		}
+	}
+	if (totalFree > 0) {
+		statistics.fragmentation =
+			1.0f - static_cast<float>(contiguousFree) / static_cast<float>(totalFree);
+	}
+	return statistics;
+}
+
+void MemoryAllocator::printStatistics() {
+	Statistics statistics = getStatistics();
+	std::cout << "GPU memory: " << statistics.allocationCount << " allocations in "
+			  << statistics.blockCount << " blocks + " << statistics.dedicatedAllocationCount
+			  << " dedicated, " << statistics.bytesRequested / 1024 << " KiB requested / "
+			  << statistics.bytesAllocated / 1024 << " KiB allocated / "
+			  << statistics.bytesReserved / 1024 << " KiB reserved, fragmentation "
+			  << statistics.fragmentation << std::endl;
+}
+
+}  // namespace lvr
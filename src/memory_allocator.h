@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace lvr {
+
+struct Allocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	// persistently mapped pointer to `offset`, nullptr unless the memory is host visible
+	void *mapped = nullptr;
+
+   private:
+	friend class MemoryAllocator;
+
+	uint32_t memoryTypeIndex = 0;
+	uint32_t poolIndex = 0;
+	uint32_t blockIndex = 0;
+	uint32_t order = 0;
+	VkDeviceSize requestedSize = 0;
+	bool dedicated = false;
+};
+
+// Sub-allocates device memory out of large blocks with a buddy allocator, one set of blocks per
+// memory type. Buffers and optimally tiled images never share a block, which keeps every
+// allocation clear of bufferImageGranularity without padding. Requests larger than half a block
+// get a dedicated vkAllocateMemory. Host visible blocks stay mapped for their whole lifetime.
+class MemoryAllocator {
+   public:
+	static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+	static constexpr VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+
+	enum class ResourceKind { Linear, Optimal };
+
+	struct Statistics {
+		uint32_t blockCount = 0;
+		uint32_t dedicatedAllocationCount = 0;
+		uint32_t allocationCount = 0;
+		// device memory owned by the allocator, blocks and dedicated allocations
+		VkDeviceSize bytesReserved = 0;
+		// handed out to resources, including the rounding to buddy sizes
+		VkDeviceSize bytesAllocated = 0;
+		// what resources actually asked for
+		VkDeviceSize bytesRequested = 0;
+		// 1 - largest free range / free bytes, summed per block. 0 means every block's free space is
+		// one contiguous range
+		float fragmentation = 0.0f;
+	};
+
+	MemoryAllocator(
+		VkDevice device,
+		VkPhysicalDevice physicalDevice,
+		const VkPhysicalDeviceProperties &properties);
+	~MemoryAllocator();
+
+	MemoryAllocator(const MemoryAllocator &) = delete;
+	MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+	Allocation allocate(
+		const VkMemoryRequirements &requirements,
+		VkMemoryPropertyFlags properties,
+		ResourceKind kind);
+	void free(Allocation &allocation);
+
+	// Offsets are relative to the allocation. No-ops on host coherent memory.
+	VkResult flush(
+		const Allocation &allocation,
+		VkDeviceSize size = VK_WHOLE_SIZE,
+		VkDeviceSize offset = 0);
+	VkResult invalidate(
+		const Allocation &allocation,
+		VkDeviceSize size = VK_WHOLE_SIZE,
+		VkDeviceSize offset = 0);
+
+	Statistics getStatistics();
+	void printStatistics();
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+   private:
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void *mapped = nullptr;
+		// free offsets per order, order n covers MIN_ALLOCATION_SIZE << n bytes
+		std::vector<std::set<VkDeviceSize>> freeLists{};
+		VkDeviceSize freeBytes = 0;
+		uint32_t allocationCount = 0;
+	};
+
+	struct Pool {
+		uint32_t memoryTypeIndex = 0;
+		ResourceKind kind = ResourceKind::Linear;
+		VkDeviceSize blockSize = 0;
+		uint32_t maxOrder = 0;
+		std::vector<std::unique_ptr<Block>> blocks{};
+	};
+
+	Pool &getPool(uint32_t memoryTypeIndex, ResourceKind kind, uint32_t &poolIndex);
+	Block *createBlock(Pool &pool, uint32_t &blockIndex);
+	bool allocateFromBlock(Block &block, uint32_t order, uint32_t maxOrder, VkDeviceSize &offset);
+	void freeToBlock(Block &block, uint32_t order, uint32_t maxOrder, VkDeviceSize offset);
+	Allocation allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex);
+	VkMappedMemoryRange getMappedRange(
+		const Allocation &allocation,
+		VkDeviceSize size,
+		VkDeviceSize offset) const;
+	bool isHostVisible(uint32_t memoryTypeIndex) const;
+	bool isHostCoherent(uint32_t memoryTypeIndex) const;
+
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	VkDeviceSize nonCoherentAtomSize;
+
+	std::vector<Pool> pools{};
+	uint32_t dedicatedAllocationCount = 0;
+	VkDeviceSize dedicatedBytes = 0;
+	uint32_t allocationCount = 0;
+	VkDeviceSize bytesAllocated = 0;
+	VkDeviceSize bytesRequested = 0;
+
+	std::mutex mutex;
+};
+
+}  // namespace lvr
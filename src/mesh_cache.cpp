@@ -0,0 +1,220 @@
+#include "mesh_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+#if defined(LVR_PLATFORM_LINUX) || defined(LVR_PLATFORM_MACOS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LVR_MESH_CACHE_MMAP
+#endif
+
+namespace lvr {
+
+namespace {
+
+uint64_t hashPath(const std::string &path) {
+	// FNV-1a, stable across runs unlike std::hash
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (unsigned char c : path) {
+		hash ^= c;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+std::string canonicalPath(const std::string &path) {
+	std::error_code ec;
+	auto canonical = std::filesystem::weakly_canonical(path, ec);
+	return ec ? path : canonical.string();
+}
+
+uint64_t alignOffset(uint64_t offset, uint64_t alignment) {
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+}  // namespace
+
+MeshCache::MappedMesh::MappedMesh(const std::filesystem::path &cachePath) {
+#ifdef LVR_MESH_CACHE_MMAP
+	int fd = open(cachePath.c_str(), O_RDONLY);
+	if (fd < 0) return;
+
+	struct stat fileStat {};
+	if (fstat(fd, &fileStat) == 0 && fileStat.st_size >= static_cast<off_t>(sizeof(Header))) {
+		void *ptr = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED) {
+			data = static_cast<const std::byte *>(ptr);
+			size = static_cast<size_t>(fileStat.st_size);
+			mapped = true;
+		}
+	}
+	close(fd);
+#else
+	std::ifstream file{cachePath, std::ios::ate | std::ios::binary};
+	if (!file.is_open()) return;
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	if (fileSize < sizeof(Header)) return;
+
+	fallbackData.resize(fileSize);
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(fallbackData.data()), fileSize);
+	data = fallbackData.data();
+	size = fileSize;
+#endif
+
+	if (data != nullptr) {
+		header = reinterpret_cast<const Header *>(data);
+	}
+}
+
+MeshCache::MappedMesh::~MappedMesh() {
+#ifdef LVR_MESH_CACHE_MMAP
+	if (mapped) {
+		munmap(const_cast<std::byte *>(data), size);
+	}
+#endif
+}
+
+std::span<const Model::Vertex> MeshCache::MappedMesh::vertices() const {
+	return {
+		reinterpret_cast<const Model::Vertex *>(data + header->vertexOffset),
+		static_cast<size_t>(header->vertexCount)};
+}
+
+std::span<const uint32_t> MeshCache::MappedMesh::indices() const {
+	return {
+		reinterpret_cast<const uint32_t *>(data + header->indexOffset),
+		static_cast<size_t>(header->indexCount)};
+}
+
+std::filesystem::path MeshCache::getCachePath(const std::string &sourcePath) {
+	char hashString[17];
+	snprintf(
+		hashString,
+		sizeof(hashString),
+		"%016llx",
+		static_cast<unsigned long long>(hashPath(canonicalPath(sourcePath))));
+
+	std::filesystem::path source{sourcePath};
+	return getCacheDirectory() / (source.stem().string() + "-" + hashString + ".mesh");
+}
+
+bool MeshCache::fillSourceKey(const std::string &sourcePath, Header &header) {
+	std::error_code ec;
+	auto sourceSize = std::filesystem::file_size(sourcePath, ec);
+	if (ec) return false;
+	auto sourceTime = std::filesystem::last_write_time(sourcePath, ec);
+	if (ec) return false;
+
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.vertexStride = sizeof(Model::Vertex);
+	header.indexStride = sizeof(uint32_t);
+	header.pathHash = hashPath(canonicalPath(sourcePath));
+	header.sourceSize = sourceSize;
+	header.sourceModifiedTime =
+		std::chrono::duration_cast<std::chrono::nanoseconds>(sourceTime.time_since_epoch())
+			.count();
+	return true;
+}
+
+bool MeshCache::matchesSource(const Header &cached, const Header &source, size_t fileSize) {
+	if (cached.magic != source.magic || cached.version != source.version ||
+		cached.vertexStride != source.vertexStride || cached.indexStride != source.indexStride ||
+		cached.pathHash != source.pathHash || cached.sourceSize != source.sourceSize ||
+		cached.sourceModifiedTime != source.sourceModifiedTime) {
+		return false;
+	}
+
+	// the counts come from the file, bound them by its size before multiplying so a corrupt
+	// header can't wrap around
+	uint64_t vertexOffset = alignOffset(sizeof(Header), 16);
+	if (cached.vertexOffset != vertexOffset || vertexOffset > fileSize ||
+		cached.vertexCount > (fileSize - vertexOffset) / cached.vertexStride) {
+		return false;
+	}
+	uint64_t indexOffset =
+		alignOffset(vertexOffset + cached.vertexCount * cached.vertexStride, alignof(uint32_t));
+	if (cached.indexOffset != indexOffset || indexOffset > fileSize ||
+		cached.indexCount > (fileSize - indexOffset) / cached.indexStride) {
+		return false;
+	}
+	// laid out exactly as store() writes it, a truncated or padded file is rejected
+	return indexOffset + cached.indexCount * cached.indexStride == fileSize;
+}
+
+std::unique_ptr<MeshCache::MappedMesh> MeshCache::load(const std::string &sourcePath) {
+	Header sourceKey{};
+	if (!fillSourceKey(sourcePath, sourceKey)) return nullptr;
+
+	auto mesh = std::make_unique<MappedMesh>(getCachePath(sourcePath));
+	if (!mesh->isValid()) return nullptr;
+
+	if (!matchesSource(mesh->getHeader(), sourceKey, mesh->getSize())) {
+		return nullptr;
+	}
+
+	// an index past the vertices would be fetched out of bounds on the GPU
+	uint64_t vertexCount = mesh->getHeader().vertexCount;
+	for (uint32_t index : mesh->indices()) {
+		if (index >= vertexCount) {
+			std::cout << "Mesh cache " << getCachePath(sourcePath)
+					  << " has out of range indices, reimporting" << std::endl;
+			return nullptr;
+		}
+	}
+
+	return mesh;
+}
+
+void MeshCache::store(
+	const std::string &sourcePath,
+	std::span<const Model::Vertex> vertices,
+	std::span<const uint32_t> indices) {
+	Header header{};
+	if (!fillSourceKey(sourcePath, header)) return;
+
+	header.vertexCount = vertices.size();
+	header.indexCount = indices.size();
+	header.vertexOffset = alignOffset(sizeof(Header), 16);
+	header.indexOffset =
+		alignOffset(header.vertexOffset + vertices.size_bytes(), alignof(uint32_t));
+
+	std::filesystem::path cachePath = getCachePath(sourcePath);
+	std::error_code ec;
+	std::filesystem::create_directories(cachePath.parent_path(), ec);
+
+	// write next to the final file and rename so readers never map a half written cache
+	std::filesystem::path tempPath = cachePath;
+	tempPath += ".tmp";
+	{
+		std::ofstream out{tempPath, std::ios::out | std::ios::binary | std::ios::trunc};
+		if (!out.is_open()) {
+			std::cout << "Failed to write mesh cache " << cachePath << std::endl;
+			return;
+		}
+
+		std::vector<char> padding(header.vertexOffset - sizeof(Header), 0);
+		out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+		out.write(padding.data(), padding.size());
+		out.write(reinterpret_cast<const char *>(vertices.data()), vertices.size_bytes());
+
+		padding.assign(header.indexOffset - header.vertexOffset - vertices.size_bytes(), 0);
+		out.write(padding.data(), padding.size());
+		out.write(reinterpret_cast<const char *>(indices.data()), indices.size_bytes());
+	}
+
+	std::filesystem::rename(tempPath, cachePath, ec);
+	if (ec) {
+		std::filesystem::remove(tempPath, ec);
+	}
+}
+
+}  // namespace lvr
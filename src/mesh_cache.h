@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "model.h"
+
+namespace lvr {
+
+// Binary, memory-mappable mirror of a source mesh. A cache file is only used while the source
+// file it was built from still has the same path, size and modification time.
+class MeshCache {
+   public:
+	static constexpr uint32_t MAGIC = 0x4853454d;  // "MESH"
+	static constexpr uint32_t VERSION = 1;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertexStride;
+		uint32_t indexStride;
+		uint64_t pathHash;
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+	};
+
+	class MappedMesh {
+	   public:
+		MappedMesh(const std::filesystem::path &cachePath);
+		~MappedMesh();
+
+		MappedMesh(const MappedMesh &) = delete;
+		MappedMesh &operator=(const MappedMesh &) = delete;
+
+		bool isValid() const { return header != nullptr; }
+		const Header &getHeader() const { return *header; }
+		size_t getSize() const { return size; }
+
+		std::span<const Model::Vertex> vertices() const;
+		std::span<const uint32_t> indices() const;
+
+	   private:
+		const std::byte *data = nullptr;
+		size_t size = 0;
+		bool mapped = false;
+		std::vector<std::byte> fallbackData{};
+		const Header *header = nullptr;
+	};
+
+	// Returns the mapped cache for the source file, or nullptr when it is missing or stale.
+	static std::unique_ptr<MappedMesh> load(const std::string &sourcePath);
+	static void store(
+		const std::string &sourcePath,
+		std::span<const Model::Vertex> vertices,
+		std::span<const uint32_t> indices);
+
+	static std::filesystem::path getCachePath(const std::string &sourcePath);
+	static std::filesystem::path getCacheDirectory() { return "models/cache/"; }
+
+   private:
+	static bool fillSourceKey(const std::string &sourcePath, Header &header);
+	static bool matchesSource(const Header &cached, const Header &source, size_t fileSize);
+};
+
+}  // namespace lvr
@@ -0,0 +1,129 @@
+#include "mesh_pool.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#include "device.h"
+#include "model.h"
+#include "release_queue.h"
+
+namespace lvr {
+
+bool MeshPool::RangeAllocator::allocate(uint32_t count, uint32_t &offset) {
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+		if (it->second < count) continue;
+
+		offset = it->first;
+		uint32_t remaining = it->second - count;
+		freeRanges.erase(it);
+		if (remaining > 0) {
+			freeRanges[offset + count] = remaining;
+		}
+		return true;
+	}
+	return false;
+}
+
+void MeshPool::RangeAllocator::free(uint32_t offset, uint32_t count) {
+	auto next = freeRanges.lower_bound(offset);
+	if (next != freeRanges.end() && offset + count == next->first) {
+		count += next->second;
+		next = freeRanges.erase(next);
+	}
+	if (next != freeRanges.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			previous->second += count;
+			return;
+		}
+	}
+	freeRanges[offset] = count;
+}
+
+MeshPool::MeshPool(Device &device, uint32_t vertexCapacity, uint32_t indexCapacity)
+	: device{device},
+	  vertexCapacity{vertexCapacity},
+	  indexCapacity{indexCapacity},
+	  vertexRanges{vertexCapacity},
+	  indexRanges{indexCapacity} {
+	vertexBuffer =
+		createBuffer(sizeof(Model::Vertex), vertexCapacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	indexBuffer = createBuffer(sizeof(uint32_t), indexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+}
+
+std::unique_ptr<Buffer> MeshPool::createBuffer(
+	VkDeviceSize elementSize, uint32_t capacity, VkBufferUsageFlags usage) {
+	// the source of the copy when the buffer grows
+	return std::make_unique<Buffer>(
+		device,
+		elementSize,
+		capacity,
+		usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void MeshPool::allocate(
+	uint32_t vertexCount, uint32_t indexCount, Range &vertices, Range &indices) {
+	std::lock_guard<std::mutex> lock{mutex};
+
+	if (!vertexRanges.allocate(vertexCount, vertices.offset)) {
+		grow(vertexBuffer, vertexRanges, vertexCapacity, vertexCount);
+		vertexRanges.allocate(vertexCount, vertices.offset);
+	}
+	if (!indexRanges.allocate(indexCount, indices.offset)) {
+		grow(indexBuffer, indexRanges, indexCapacity, indexCount);
+		indexRanges.allocate(indexCount, indices.offset);
+	}
+	vertices.count = vertexCount;
+	indices.count = indexCount;
+}
+
+void MeshPool::grow(
+	std::unique_ptr<Buffer> &buffer,
+	RangeAllocator &ranges,
+	uint32_t &capacity,
+	uint32_t count) {
+	constexpr uint64_t MAX_CAPACITY = std::numeric_limits<uint32_t>::max();
+	if (uint64_t{capacity} + count > MAX_CAPACITY) {
+		throw std::runtime_error("mesh pool is full!");
+	}
+	// the new space is one free range at the end, so the mesh fits even if the old buffer's
+	// free space was scattered
+	uint64_t newCapacity = std::min(
+		std::max<uint64_t>(2ull * capacity, uint64_t{capacity} + count),
+		MAX_CAPACITY);
+
+	auto grown = createBuffer(
+		buffer->getInstanceSize(),
+		static_cast<uint32_t>(newCapacity),
+		buffer->getUsageFlags());
+	// staged copies into the old buffer may still be pending, and ones recorded after the copy
+	// must not run before it
+	device.uploadQueue().waitIdle();
+	device.copyBuffer(buffer->getBuffer(), grown->getBuffer(), buffer->getBufferSize());
+
+	// frames in flight still have the old buffer bound
+	device.releaseQueue().retire(std::move(buffer));
+	buffer = std::move(grown);
+	ranges.grow(capacity, static_cast<uint32_t>(newCapacity));
+	capacity = static_cast<uint32_t>(newCapacity);
+}
+
+void MeshPool::free(const Range &vertices, const Range &indices) {
+	device.releaseQueue().defer([this, vertices, indices]() {
+		std::lock_guard<std::mutex> lock{mutex};
+		if (vertices.count > 0) vertexRanges.free(vertices.offset, vertices.count);
+		if (indices.count > 0) indexRanges.free(indices.offset, indices.count);
+	});
+}
+
+void MeshPool::bind(VkCommandBuffer commandBuffer) {
+	VkBuffer buffers[] = {vertexBuffer->getBuffer()};
+	VkDeviceSize offsets[] = {0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+}  // namespace lvr
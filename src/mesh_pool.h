@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "buffer.h"
+
+namespace lvr {
+
+class Device;
+
+// Device local vertex and index buffers shared by every Model. Meshes only differ by their offsets
+// into them, so any mix of models draws without rebinding and a single indirect buffer can hold
+// the draws of the whole scene. A full buffer is replaced by one at least twice its size, the
+// offsets of the meshes already in it stay valid.
+class MeshPool {
+   public:
+	static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 1 << 20;
+	static constexpr uint32_t DEFAULT_INDEX_CAPACITY = 1 << 22;
+
+	// In elements, vertices or indices
+	struct Range {
+		uint32_t offset = 0;
+		uint32_t count = 0;
+	};
+
+	MeshPool(
+		Device &device,
+		uint32_t vertexCapacity = DEFAULT_VERTEX_CAPACITY,
+		uint32_t indexCapacity = DEFAULT_INDEX_CAPACITY);
+
+	MeshPool(const MeshPool &) = delete;
+	MeshPool &operator=(const MeshPool &) = delete;
+
+	// Reserves room for a mesh, growing the buffers it doesn't fit in. Growing waits for the
+	// upload queue to go idle and copies the old contents over, the old buffer is retired.
+	void allocate(uint32_t vertexCount, uint32_t indexCount, Range &vertices, Range &indices);
+	// Frames in flight may still fetch from the ranges, they are reused once the device's release
+	// queue lets them go
+	void free(const Range &vertices, const Range &indices);
+
+	Buffer &getVertexBuffer() { return *vertexBuffer; }
+	Buffer &getIndexBuffer() { return *indexBuffer; }
+	uint32_t getVertexCapacity() const { return vertexCapacity; }
+	uint32_t getIndexCapacity() const { return indexCapacity; }
+
+	void bind(VkCommandBuffer commandBuffer);
+
+   private:
+	// First fit over free ranges keyed by offset, neighbours are merged on free
+	class RangeAllocator {
+	   public:
+		explicit RangeAllocator(uint32_t capacity) { freeRanges[0] = capacity; }
+
+		bool allocate(uint32_t count, uint32_t &offset);
+		void free(uint32_t offset, uint32_t count);
+		// Adds [oldCapacity, newCapacity) as free space
+		void grow(uint32_t oldCapacity, uint32_t newCapacity) {
+			free(oldCapacity, newCapacity - oldCapacity);
+		}
+
+	   private:
+		std::map<uint32_t, uint32_t> freeRanges{};
+	};
+
+	std::unique_ptr<Buffer> createBuffer(
+		VkDeviceSize elementSize,
+		uint32_t capacity,
+		VkBufferUsageFlags usage);
+	// Replaces `buffer` by one with room for `count` more elements and copies its contents over
+	void grow(
+		std::unique_ptr<Buffer> &buffer,
+		RangeAllocator &ranges,
+		uint32_t &capacity,
+		uint32_t count);
+
+	Device &device;
+	uint32_t vertexCapacity;
+	uint32_t indexCapacity;
+	std::unique_ptr<Buffer> vertexBuffer;
+	std::unique_ptr<Buffer> indexBuffer;
+
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+	std::mutex mutex;
+};
+
+}  // namespace lvr
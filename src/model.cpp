@@ -8,119 +8,270 @@
 #include <stdexcept>
 #include <vector>
 
-#include "utils/utils.h"
+#include "mesh_cache.h"
+#include "utils/flat_hash_map.h"
+#include "utils/thread_pool.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
-#include <glm/gtx/hash.hpp>
-
 #include "tiny_obj_loader.h"
 
 // std
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <cstring>
-#include <unordered_map>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <span>
+
+namespace lvr {
+
+namespace {
+
+constexpr size_t MIN_DEDUP_CHUNK_SIZE = 1 << 16;
+
+struct IndexKey {
+	int vertex;
+	int normal;
+	int texcoord;
+
+	bool operator==(const IndexKey &other) const = default;
+};
+
+uint64_t mixBits(uint64_t value) {
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ull;
+	value ^= value >> 33;
+	return value;
+}
 
-namespace std {
-template <>
-struct hash<lvr::Model::Vertex> {
-	size_t operator()(lvr::Model::Vertex const &vertex) const {
-		size_t seed = 0;
-		utils::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-		return seed;
+struct IndexKeyHash {
+	size_t operator()(const IndexKey &key) const {
+		uint64_t packed = static_cast<uint32_t>(key.vertex) |
+						  (static_cast<uint64_t>(static_cast<uint32_t>(key.normal)) << 32);
+		return mixBits(packed ^ mixBits(static_cast<uint32_t>(key.texcoord)));
 	}
 };
-};	// namespace std
 
-namespace lvr {
+// Same equality as Vertex::operator==, so 0.0f and -0.0f must hash alike
+struct VertexValueHash {
+	size_t operator()(const Model::Vertex &vertex) const {
+		const float *components = &vertex.position.x;
+		uint64_t hash = 0;
+		for (size_t i = 0; i < sizeof(Model::Vertex) / sizeof(float); i++) {
+			float value = components[i] == 0.0f ? 0.0f : components[i];
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			hash = mixBits(hash ^ bits);
+		}
+		return hash;
+	}
+};
+
+Model::Vertex makeVertex(const tinyobj::attrib_t &attrib, const IndexKey &key) {
+	Model::Vertex vertex{};
+
+	if (key.vertex >= 0) {
+		vertex.position = {
+			attrib.vertices[3 * key.vertex + 0],
+			attrib.vertices[3 * key.vertex + 1],
+			attrib.vertices[3 * key.vertex + 2]};
+
+		vertex.color = {
+			attrib.colors[3 * key.vertex + 0],
+			attrib.colors[3 * key.vertex + 1],
+			attrib.colors[3 * key.vertex + 2],
+			1.0f};
+	}
 
-Model::Model(Device &device, const Builder &builder) : lvrDevice{device} {
-	createVertexBuffers(builder.vertices);
-	createIndexBuffers(builder.indices);
+	if (key.normal >= 0) {
+		vertex.normal = {
+			attrib.normals[3 * key.normal + 0],
+			attrib.normals[3 * key.normal + 1],
+			attrib.normals[3 * key.normal + 2]};
+	}
+
+	if (key.texcoord >= 0) {
+		vertex.uv = {
+			attrib.texcoords[2 * key.texcoord + 0],
+			attrib.texcoords[2 * key.texcoord + 1],
+		};
+	}
+
+	return vertex;
 }
 
-Model::~Model() {}
+// Vertex value with its hash computed up front, so the serial merge only probes and compares
+struct HashedVertex {
+	Model::Vertex vertex;
+	size_t hash;
+};
 
-void Model::createVertexBuffers(const std::vector<Vertex> &vertices) {
-	vertexCount = static_cast<uint32_t>(vertices.size());
-	assert(vertexCount >= 3 && "Vertex count must be at least 3");
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-	uint32_t vertexSize = sizeof(vertices[0]);
-
-	Buffer stagingBuffer{
-		lvrDevice,
-		vertexSize,
-		vertexCount,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	};
+struct HashedVertexHash {
+	size_t operator()(const HashedVertex &value) const { return value.hash; }
+};
+
+struct HashedVertexEqual {
+	bool operator()(const HashedVertex &a, const HashedVertex &b) const {
+		return a.vertex == b.vertex;
+	}
+};
 
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void *)vertices.data());
+struct DedupChunk {
+	std::span<const tinyobj::index_t> source;
+	size_t outputOffset;
+
+	std::vector<IndexKey> uniqueKeys{};
+	std::vector<HashedVertex> uniqueVertices{};
+	std::vector<uint32_t> localIndices{};
+	std::vector<uint32_t> remap{};
+
+	void deduplicate(const tinyobj::attrib_t &attrib) {
+		utils::FlatHashMap<IndexKey, uint32_t, IndexKeyHash> localMap{source.size() / 2};
+		uniqueKeys.reserve(source.size() / 2);
+		localIndices.resize(source.size());
+
+		for (size_t i = 0; i < source.size(); i++) {
+			IndexKey key{source[i].vertex_index, source[i].normal_index, source[i].texcoord_index};
+			auto [localIndex, inserted] =
+				localMap.tryEmplace(key, static_cast<uint32_t>(uniqueKeys.size()));
+			if (inserted) {
+				uniqueKeys.push_back(key);
+			}
+			localIndices[i] = *localIndex;
+		}
 
-	vertexBuffer = std::make_unique<Buffer>(
-		lvrDevice,
-		vertexSize,
-		vertexCount,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VertexValueHash hasher{};
+		uniqueVertices.resize(uniqueKeys.size());
+		for (size_t i = 0; i < uniqueKeys.size(); i++) {
+			Model::Vertex vertex = makeVertex(attrib, uniqueKeys[i]);
+			uniqueVertices[i] = {vertex, hasher(vertex)};
+		}
+	}
+};
 
-	lvrDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+// Shared by every model load, so loading many models at once doesn't start threads for each
+utils::ThreadPool &getDedupPool() {
+	static utils::ThreadPool pool{};
+	return pool;
 }
 
-void Model::createIndexBuffers(const std::vector<uint32_t> &indices) {
-	indexCount = static_cast<uint32_t>(indices.size());
-	hasIndexBuffer = indexCount > 0;
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-	uint32_t indexSize = sizeof(indices[0]);
-
-	Buffer stagingBuffer{
-		lvrDevice,
-		indexSize,
-		indexCount,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+// The calling thread works through the chunks too. Loads run on the model loader's own pool, so
+// waiting here never blocks a dedup worker on itself.
+template <typename Fn>
+void forEachChunk(std::vector<DedupChunk> &chunks, Fn &&fn) {
+	utils::ThreadPool &pool = getDedupPool();
+	uint32_t workerCount =
+		std::min<uint32_t>(pool.getWorkerCount() + 1, static_cast<uint32_t>(chunks.size()));
+	if (workerCount <= 1) {
+		for (auto &chunk : chunks) fn(chunk);
+		return;
+	}
+
+	std::atomic<size_t> nextChunk{0};
+	auto worker = [&]() {
+		for (size_t i = nextChunk++; i < chunks.size(); i = nextChunk++) {
+			fn(chunks[i]);
+		}
 	};
 
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void *)indices.data());
+	std::vector<std::future<void>> workers{};
+	workers.reserve(workerCount - 1);
+	for (uint32_t i = 0; i + 1 < workerCount; i++) {
+		workers.push_back(pool.submit(worker));
+	}
+	worker();
+	for (auto &future : workers) {
+		future.get();
+	}
+}
+
+}  // namespace
+
+Model::Model(Device &device, const Builder &builder)
+	: Model(device, builder.vertices, builder.indices) {}
+
+Model::Model(Device &device, std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+	: lvrDevice{device} {
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	assert(vertexCount >= 3 && "Vertex count must be at least 3");
+
+	// everything is drawn indexed from the pool, give unindexed meshes a trivial index list
+	std::vector<uint32_t> generatedIndices;
+	if (indices.empty()) {
+		generatedIndices.resize(vertexCount);
+		std::iota(generatedIndices.begin(), generatedIndices.end(), 0);
+		indices = generatedIndices;
+	}
+	uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+	auto &meshPool = lvrDevice.meshPool();
+	meshPool.allocate(vertexCount, indexCount, vertexRange, indexRange);
+
+	lvrDevice.uploadQueue().uploadBuffer(
+		meshPool.getVertexBuffer(),
+		vertices.data(),
+		sizeof(Vertex) * vertexCount,
+		sizeof(Vertex) * vertexRange.offset);
+	lvrDevice.uploadQueue().uploadBuffer(
+		meshPool.getIndexBuffer(),
+		indices.data(),
+		sizeof(uint32_t) * indexCount,
+		sizeof(uint32_t) * indexRange.offset);
+
+	computeBoundingSphere(vertices);
+}
 
-	indexBuffer = std::make_unique<Buffer>(
-		lvrDevice,
-		indexSize,
-		indexCount,
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+Model::~Model() { lvrDevice.meshPool().free(vertexRange, indexRange); }
 
-	lvrDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+// Centered on the bounding box, loose but cheap and good enough for culling
+void Model::computeBoundingSphere(std::span<const Vertex> vertices) {
+	glm::vec3 min{std::numeric_limits<float>::max()};
+	glm::vec3 max{std::numeric_limits<float>::lowest()};
+	for (const auto &vertex : vertices) {
+		min = glm::min(min, vertex.position);
+		max = glm::max(max, vertex.position);
+	}
+
+	glm::vec3 center = (min + max) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (const auto &vertex : vertices) {
+		glm::vec3 offset = vertex.position - center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	boundingSphere = glm::vec4(center, std::sqrt(radiusSquared));
 }
 
 std::unique_ptr<Model> Model::createModelFromFile(Device &device, const std::string &filepath) {
+	if (auto cached = MeshCache::load(filepath)) {
+		std::cout << "Vertex  Count: " << cached->vertices().size() << " (cached)" << std::endl;
+		return std::make_unique<Model>(device, cached->vertices(), cached->indices());
+	}
+
 	Builder builder{};
 	builder.loadModel(filepath);
 	std::cout << "Vertex  Count: " << builder.vertices.size() << std::endl;
+	MeshCache::store(filepath, builder.vertices, builder.indices);
 
 	return std::make_unique<Model>(device, builder);
 }
 
-void Model::draw(VkCommandBuffer commandBuffer) {
-	if (hasIndexBuffer) {
-		vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
-	} else {
-		vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
-	}
+void Model::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance) {
+	vkCmdDrawIndexed(
+		commandBuffer,
+		indexRange.count,
+		instanceCount,
+		indexRange.offset,
+		getVertexOffset(),
+		firstInstance);
 }
 
-void Model::bind(VkCommandBuffer commandBuffer) {
-	VkBuffer buffers[] = {vertexBuffer->getBuffer()};
-
-	VkDeviceSize offsets[] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-
-	if (hasIndexBuffer) {
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
-	}
-}
+void Model::bind(VkCommandBuffer commandBuffer) { lvrDevice.meshPool().bind(commandBuffer); }
 
 std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions() {
 	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
@@ -151,49 +302,73 @@ void Model::Builder::loadModel(const std::string &filepath) {
 		throw std::runtime_error(warn + err);
 	}
 
+	buildFromObj(attrib, shapes);
+}
+
+void Model::Builder::buildFromObj(
+	const tinyobj::attrib_t &attrib, const std::vector<tinyobj::shape_t> &shapes) {
 	vertices.clear();
 	indices.clear();
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
+	size_t totalIndices = 0;
 	for (const auto &shape : shapes) {
-		for (const auto &index : shape.mesh.indices) {
-			Vertex vertex{};
-
-			if (index.vertex_index >= 0) {
-				vertex.position = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]};
-
-				vertex.color = {
-					attrib.colors[3 * index.vertex_index + 0],
-					attrib.colors[3 * index.vertex_index + 1],
-					attrib.colors[3 * index.vertex_index + 2],
-					1.0f};
-			}
+		totalIndices += shape.mesh.indices.size();
+	}
+	if (totalIndices == 0) return;
 
-			if (index.normal_index >= 0) {
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]};
-			}
+	uint32_t threadCount = getDedupPool().getWorkerCount() + 1;
+	size_t chunkSize = std::max<size_t>(
+		MIN_DEDUP_CHUNK_SIZE, (totalIndices + threadCount * 4 - 1) / (threadCount * 4));
 
-			if (index.texcoord_index >= 0) {
-				vertex.uv = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					attrib.texcoords[2 * index.texcoord_index + 1],
-				};
-			}
+	// chunks never straddle shapes, and stay in file order so the merge below is deterministic
+	std::vector<DedupChunk> chunks{};
+	size_t offset = 0;
+	for (const auto &shape : shapes) {
+		const auto &shapeIndices = shape.mesh.indices;
+		for (size_t begin = 0; begin < shapeIndices.size(); begin += chunkSize) {
+			size_t count = std::min(chunkSize, shapeIndices.size() - begin);
+			chunks.push_back({{shapeIndices.data() + begin, count}, offset});
+			offset += count;
+		}
+	}
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
+	forEachChunk(chunks, [&attrib](DedupChunk &chunk) { chunk.deduplicate(attrib); });
+
+	// Merge the per chunk unique vertices in order. A tuple first seen in chunk k is always seen
+	// after every tuple first seen in an earlier chunk, so vertices end up in the same first
+	// occurrence order as a serial pass. Equal tuples build equal vertices, so merging by value
+	// also folds tuples repeated across chunks and distinct tuples that resolve to the same vertex
+	// (e.g. duplicated positions in the file). Only the inserts run here, the vertices and their
+	// hashes were built on the dedup pool. The map holds one entry per final vertex and is
+	// reserved for the upper bound so it never rehashes.
+	size_t uniqueUpperBound = 0;
+	for (const auto &chunk : chunks) {
+		uniqueUpperBound += chunk.uniqueVertices.size();
+	}
+
+	utils::FlatHashMap<HashedVertex, uint32_t, HashedVertexHash, HashedVertexEqual> valueToVertex{
+		uniqueUpperBound};
+	vertices.reserve(uniqueUpperBound);
+
+	for (auto &chunk : chunks) {
+		chunk.remap.resize(chunk.uniqueVertices.size());
+		for (size_t i = 0; i < chunk.uniqueVertices.size(); i++) {
+			const HashedVertex &value = chunk.uniqueVertices[i];
+			auto [vertexIndex, inserted] =
+				valueToVertex.tryEmplace(value, static_cast<uint32_t>(vertices.size()));
+			if (inserted) {
+				vertices.push_back(value.vertex);
 			}
-			indices.push_back(uniqueVertices[vertex]);
+			chunk.remap[i] = *vertexIndex;
 		}
 	}
+
+	indices.resize(totalIndices);
+	forEachChunk(chunks, [this](DedupChunk &chunk) {
+		for (size_t i = 0; i < chunk.localIndices.size(); i++) {
+			indices[chunk.outputOffset + i] = chunk.remap[chunk.localIndices[i]];
+		}
+	});
 }
 
 }  // namespace lvr
\ No newline at end of file
@@ -6,10 +6,17 @@
 #include <glm/ext/vector_float3.hpp>
 #include <glm/glm.hpp>
 #include <memory>
+#include <span>
 #include <vector>
 
 #include "buffer.h"
 #include "device.h"
+#include "mesh_pool.h"
+
+namespace tinyobj {
+struct attrib_t;
+struct shape_t;
+}  // namespace tinyobj
 
 namespace lvr {
 
@@ -35,9 +42,14 @@ class Model {
 		std::vector<uint32_t> indices{};
 
 		void loadModel(const std::string &filepath);
+		void buildFromObj(
+			const tinyobj::attrib_t &attrib, const std::vector<tinyobj::shape_t> &shapes);
 	};
 
 	Model(Device &device, const Builder &builder);
+	// The mesh is placed in the device's MeshPool. The copies are recorded into the device's upload
+	// queue, the model can be drawn once that batch is submitted.
+	Model(Device &device, std::span<const Vertex> vertices, std::span<const uint32_t> indices);
 	~Model();
 
 	Model(const Model &) = delete;
@@ -45,21 +57,28 @@ class Model {
 
 	static std::unique_ptr<Model> createModelFromFile(Device &device, const std::string &filepath);
 
+	// Binds the pool buffers, shared by every model
 	void bind(VkCommandBuffer commandBuffer);
-	void draw(VkCommandBuffer commandBuffer);
+	void draw(
+		VkCommandBuffer commandBuffer,
+		uint32_t instanceCount = 1,
+		uint32_t firstInstance = 0);
+
+	// Offsets into the MeshPool buffers, for building indirect draws
+	uint32_t getFirstIndex() const { return indexRange.offset; }
+	uint32_t getIndexCount() const { return indexRange.count; }
+	int32_t getVertexOffset() const { return static_cast<int32_t>(vertexRange.offset); }
+	// Model space center in xyz and radius in w
+	const glm::vec4 &getBoundingSphere() const { return boundingSphere; }
 
    private:
-	void createVertexBuffers(const std::vector<Vertex> &vertices);
-	void createIndexBuffers(const std::vector<uint32_t> &indices);
+	void computeBoundingSphere(std::span<const Vertex> vertices);
 
 	Device &lvrDevice;
 
-	std::unique_ptr<Buffer> vertexBuffer;
-	uint32_t vertexCount;
-
-	bool hasIndexBuffer = false;
-	std::unique_ptr<Buffer> indexBuffer;
-	uint32_t indexCount;
+	MeshPool::Range vertexRange{};
+	MeshPool::Range indexRange{};
+	glm::vec4 boundingSphere{0.0f};
 };
 
 }  // namespace lvr
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "model_loader.h"
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace lvr {
+
+std::span<const Model::Vertex> ModelLoader::MeshData::vertices() const {
+	return cached ? cached->vertices() : std::span<const Model::Vertex>{builder.vertices};
+}
+
+std::span<const uint32_t> ModelLoader::MeshData::indices() const {
+	return cached ? cached->indices() : std::span<const uint32_t>{builder.indices};
+}
+
+ModelLoader::ModelLoader(Device &device, uint32_t workerCount)
+	: lvrDevice{device}, workers{workerCount} {}
+
+ModelLoader::~ModelLoader() {
+	// whatever the callbacks reference may be gone by now, only let the uploads finish and drop
+	// the callbacks without running them
+	for (auto &upload : inFlightUploads) {
+		lvrDevice.uploadQueue().wait(upload.ticket);
+	}
+}
+
+std::unique_ptr<ModelLoader::MeshData> ModelLoader::parseMesh(const std::string &filepath) {
+	auto meshData = std::make_unique<MeshData>();
+	meshData->cached = MeshCache::load(filepath);
+	if (!meshData->cached) {
+		meshData->builder.loadModel(filepath);
+		MeshCache::store(filepath, meshData->builder.vertices, meshData->builder.indices);
+	}
+	return meshData;
+}
+
+std::shared_ptr<ModelLoader::Handle> ModelLoader::loadAsync(
+	const std::string &filepath, Callback onReady) {
+	auto handle = std::make_shared<Handle>();
+	handle->path = filepath;
+
+	pendingParses.push_back(
+		{handle, std::move(onReady), workers.submit([filepath]() { return parseMesh(filepath); })});
+	return handle;
+}
+
+void ModelLoader::update() {
+	retireUploads(false);
+	startUploads();
+}
+
+void ModelLoader::waitIdle() {
+	while (!isIdle()) {
+		for (auto &pending : pendingParses) {
+			pending.meshData.wait();
+		}
+		startUploads();
+		retireUploads(true);
+	}
+}
+
+void ModelLoader::startUploads() {
+	InFlightUpload upload{};
+	VkDeviceSize uploadedBytes = 0;
+
+	for (auto it = pendingParses.begin(); it != pendingParses.end();) {
+		if (uploadedBytes >= UPLOAD_BUDGET_PER_UPDATE) break;
+		if (it->meshData.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			++it;
+			continue;
+		}
+
+		// a failed parse or upload only fails its own model, the batch keeps the others
+		std::unique_ptr<MeshData> meshData;
+		std::shared_ptr<Model> model;
+		try {
+			meshData = it->meshData.get();
+			model = std::make_shared<Model>(lvrDevice, meshData->vertices(), meshData->indices());
+		} catch (const std::exception &e) {
+			std::cerr << "failed to load model " << it->handle->getPath() << ": " << e.what()
+					  << std::endl;
+			it->handle->failed.store(true, std::memory_order_release);
+			it = pendingParses.erase(it);
+			continue;
+		}
+
+		uploadedBytes += meshData->vertices().size_bytes() + meshData->indices().size_bytes();
+
+		upload.models.emplace_back(std::move(*it), std::move(model));
+		it = pendingParses.erase(it);
+	}
+
+	if (upload.models.empty()) return;
+
+	upload.ticket = lvrDevice.uploadQueue().submit();
+	inFlightUploads.push_back(std::move(upload));
+}
+
+void ModelLoader::retireUploads(bool wait) {
+	for (auto it = inFlightUploads.begin(); it != inFlightUploads.end();) {
+		if (wait) {
+			lvrDevice.uploadQueue().wait(it->ticket);
+		} else if (!lvrDevice.uploadQueue().isComplete(it->ticket)) {
+			++it;
+			continue;
+		}
+
+		for (auto &[pending, model] : it->models) {
+			pending.handle->model = model;
+			pending.handle->ready.store(true, std::memory_order_release);
+			std::cout << "Loaded " << pending.handle->getPath() << std::endl;
+			if (pending.onReady) pending.onReady(model);
+		}
+		it = inFlightUploads.erase(it);
+	}
+}
+
+}  // namespace lvr
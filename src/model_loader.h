@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "device.h"
+#include "mesh_cache.h"
+#include "model.h"
+#include "upload_queue.h"
+#include "utils/thread_pool.h"
+
+namespace lvr {
+
+// Streams models in the background: files are parsed (or their mesh cache mapped) on worker
+// threads, and the GPU upload is recorded into the device's upload queue on the main thread in
+// update() and tracked by its ticket instead of waiting for the queue to go idle.
+class ModelLoader {
+   public:
+	using Callback = std::function<void(std::shared_ptr<Model>)>;
+
+	class Handle {
+	   public:
+		bool isReady() const { return ready.load(std::memory_order_acquire); }
+		bool hasFailed() const { return failed.load(std::memory_order_acquire); }
+		// nullptr until isReady()
+		std::shared_ptr<Model> get() const { return isReady() ? model : nullptr; }
+		const std::string &getPath() const { return path; }
+
+	   private:
+		friend class ModelLoader;
+
+		std::string path;
+		std::shared_ptr<Model> model{};
+		std::atomic<bool> ready{false};
+		std::atomic<bool> failed{false};
+	};
+
+	// Upload bytes started per update() call, so a large batch of finished parses is spread over
+	// several frames instead of stalling one.
+	static constexpr VkDeviceSize UPLOAD_BUDGET_PER_UPDATE = 64 * 1024 * 1024;
+
+	ModelLoader(Device &device, uint32_t workerCount = 0);
+	~ModelLoader();
+
+	ModelLoader(const ModelLoader &) = delete;
+	ModelLoader &operator=(const ModelLoader &) = delete;
+
+	// `onReady` runs on the thread calling update() or waitIdle(), once the model is resident on
+	// the GPU. Callbacks still pending when the loader is destroyed are dropped.
+	std::shared_ptr<Handle> loadAsync(const std::string &filepath, Callback onReady = nullptr);
+
+	// Call once per frame from the render thread, outside of command buffer recording.
+	void update();
+	void waitIdle();
+	bool isIdle() const { return pendingParses.empty() && inFlightUploads.empty(); }
+
+   private:
+	struct MeshData {
+		std::unique_ptr<MeshCache::MappedMesh> cached{};
+		Model::Builder builder{};
+
+		std::span<const Model::Vertex> vertices() const;
+		std::span<const uint32_t> indices() const;
+	};
+
+	struct PendingParse {
+		std::shared_ptr<Handle> handle;
+		Callback onReady;
+		std::future<std::unique_ptr<MeshData>> meshData;
+	};
+
+	struct InFlightUpload {
+		UploadQueue::Ticket ticket = 0;
+		std::vector<std::pair<PendingParse, std::shared_ptr<Model>>> models{};
+	};
+
+	static std::unique_ptr<MeshData> parseMesh(const std::string &filepath);
+
+	void retireUploads(bool wait);
+	void startUploads();
+
+	Device &lvrDevice;
+
+	std::vector<PendingParse> pendingParses{};
+	std::vector<InFlightUpload> inFlightUploads{};
+
+	utils::ThreadPool workers;
+};
+
+}  // namespace lvr
@@ -2,13 +2,16 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
 #include "model.h"
@@ -17,18 +20,64 @@ namespace lvr {
 
 Pipeline::Pipeline(
 	Device &device, const std::vector<std::string> filePaths, const PipelineConfigInfo &configInfo)
+	: Pipeline(device, Shader::Create(device, filePaths), configInfo) {}
+
+Pipeline::Pipeline(
+	Device &device,
+	std::vector<std::unique_ptr<Shader>> shaders,
+	const PipelineConfigInfo &configInfo)
 	: device(device) {
-	createShaders(filePaths);
-	if (hasCompute) createComputePipeline(configInfo);
-	if (hasGraphics > 0) createGraphicsPipeline(configInfo);
+	copyConfigInfo(configInfo, this->configInfo);
+	createShaders(std::move(shaders));
+	if (hasCompute) computePipeline = createComputePipeline(createComputeInfo);
+	if (hasGraphics > 0) graphicsPipeline = createGraphicsPipeline(createGraphicsInfos);
+
+	std::lock_guard<std::mutex> lock{registryMutex};
+	registry.push_back(this);
 }
 
 Pipeline::~Pipeline() {
+	{
+		// the reload thread may be rebuilding this pipeline
+		std::unique_lock<std::mutex> lock{registryMutex};
+		registryCondition.wait(lock, [this]() { return reloadUsers == 0; });
+		registry.erase(std::find(registry.begin(), registry.end(), this));
+	}
+
 	if (hasGraphics) vkDestroyPipeline(device.device(), graphicsPipeline, nullptr);
 	if (hasCompute) vkDestroyPipeline(device.device(), computePipeline, nullptr);
+	if (pendingReload != nullptr) {
+		vkDestroyPipeline(device.device(), pendingReload->graphicsPipeline, nullptr);
+		vkDestroyPipeline(device.device(), pendingReload->computePipeline, nullptr);
+	}
 }
 
-void Pipeline::createGraphicsPipeline(const PipelineConfigInfo &configInfo) {
+void Pipeline::copyConfigInfo(const PipelineConfigInfo &from, PipelineConfigInfo &to) {
+	to.bindingDescriptions = from.bindingDescriptions;
+	to.attributeDescriptions = from.attributeDescriptions;
+	to.viewportInfo = from.viewportInfo;
+	to.inputAssemblyInfo = from.inputAssemblyInfo;
+	to.rasterizationInfo = from.rasterizationInfo;
+	to.multisampleInfo = from.multisampleInfo;
+	to.colorBlendAttachment = from.colorBlendAttachment;
+	to.colorBlendInfo = from.colorBlendInfo;
+	to.depthStencilInfo = from.depthStencilInfo;
+	to.dynamicStateEnables = from.dynamicStateEnables;
+	to.dynamicStateInfo = from.dynamicStateInfo;
+	to.pipelineLayout = from.pipelineLayout;
+	to.renderPass = from.renderPass;
+	to.subpass = from.subpass;
+
+	if (from.colorBlendInfo.pAttachments == &from.colorBlendAttachment) {
+		to.colorBlendInfo.pAttachments = &to.colorBlendAttachment;
+	}
+	if (from.dynamicStateInfo.pDynamicStates == from.dynamicStateEnables.data()) {
+		to.dynamicStateInfo.pDynamicStates = to.dynamicStateEnables.data();
+	}
+}
+
+VkPipeline Pipeline::createGraphicsPipeline(
+	const std::vector<VkPipelineShaderStageCreateInfo> &graphicsInfos) {
 	assert(
 		configInfo.pipelineLayout != VK_NULL_HANDLE &&
 		"Cannot create graphics pipeline: no pipelineLayout provided in "
@@ -52,8 +101,8 @@ void Pipeline::createGraphicsPipeline(const PipelineConfigInfo &configInfo) {
 
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = static_cast<uint32_t>(createGraphicsInfos.size());
-	pipelineInfo.pStages = createGraphicsInfos.data();
+	pipelineInfo.stageCount = static_cast<uint32_t>(graphicsInfos.size());
+	pipelineInfo.pStages = graphicsInfos.data();
 	pipelineInfo.pVertexInputState = &vertexInputInfo;
 	pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
 	pipelineInfo.pViewportState = &configInfo.viewportInfo;
@@ -70,38 +119,49 @@ void Pipeline::createGraphicsPipeline(const PipelineConfigInfo &configInfo) {
 	pipelineInfo.basePipelineIndex = -1;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
+	VkPipeline graphicsPipeline;
+	auto start = std::chrono::high_resolution_clock::now();
 	if (vkCreateGraphicsPipelines(
 			device.device(),
-			VK_NULL_HANDLE,
+			device.pipelineCache(),
 			1,
 			&pipelineInfo,
 			nullptr,
 			&graphicsPipeline) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create render pipeline");
 	}
+	auto end = std::chrono::high_resolution_clock::now();
+	device.addPipelineCreationTime(std::chrono::duration<double, std::milli>(end - start).count());
+	return graphicsPipeline;
 }
 
-void Pipeline::createComputePipeline(const PipelineConfigInfo &configInfo) {
+VkPipeline Pipeline::createComputePipeline(const VkPipelineShaderStageCreateInfo &computeInfo) {
 	VkComputePipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
 	pipelineInfo.layout = configInfo.pipelineLayout;
-	pipelineInfo.stage = createComputeInfo;
+	pipelineInfo.stage = computeInfo;
 
+	VkPipeline computePipeline;
+	auto start = std::chrono::high_resolution_clock::now();
 	if (vkCreateComputePipelines(
 			device.device(),
-			VK_NULL_HANDLE,
+			device.pipelineCache(),
 			1,
 			&pipelineInfo,
 			nullptr,
 			&computePipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create compute pipeline!");
 	}
+	auto end = std::chrono::high_resolution_clock::now();
+	device.addPipelineCreationTime(std::chrono::duration<double, std::milli>(end - start).count());
+	return computePipeline;
 }
 
-void Pipeline::createShaders(const std::vector<std::string> filePaths) {
-	shaders.resize(filePaths.size());
-
-	shaders = Shader::Create(device, filePaths);
+void Pipeline::createShaders(std::vector<std::unique_ptr<Shader>> loadedShaders) {
+	shaders = std::move(loadedShaders);
+	createGraphicsInfos.clear();
+	hasGraphics = 0;
+	hasCompute = false;
 
 	for (int32_t i = 0; i < shaders.size(); i++) {
 		VkShaderStageFlagBits type = shaders[i]->getSource().shaderBitFlags;
@@ -116,6 +176,133 @@ void Pipeline::createShaders(const std::vector<std::string> filePaths) {
 	}
 }
 
+std::vector<std::string> Pipeline::getShaderPaths() const {
+	std::vector<std::string> paths{};
+	for (const auto &shader : shaders) {
+		paths.push_back(shader->getSource().filePath.string());
+	}
+	return paths;
+}
+
+bool Pipeline::reload() {
+	std::vector<std::string> paths;
+	std::vector<ShaderReflection> reflections{};
+	{
+		std::lock_guard<std::mutex> lock{reloadMutex};
+		paths = getShaderPaths();
+		for (const auto &shader : shaders) {
+			reflections.push_back(shader->getSource().reflection);
+		}
+	}
+
+	std::vector<std::unique_ptr<Shader>> reloaded;
+	try {
+		reloaded = Shader::Create(device, paths);
+	} catch (const std::exception &e) {
+		std::cerr << "shader reload failed, keeping the old pipeline: " << e.what() << std::endl;
+		return false;
+	}
+
+	// the pipeline layout came from the old reflection and is shared with other pipelines
+	for (size_t i = 0; i < reloaded.size(); i++) {
+		if (!(reloaded[i]->getSource().reflection == reflections[i])) {
+			std::cerr << paths[i] << " declares different resources than its pipeline layout, "
+					  << "restart to pick it up" << std::endl;
+			return false;
+		}
+	}
+
+	auto pending = std::make_unique<PendingReload>();
+	std::vector<VkPipelineShaderStageCreateInfo> graphicsInfos{};
+	try {
+		for (const auto &shader : reloaded) {
+			const VkPipelineShaderStageCreateInfo &info = shader->getShaderInfo().shaderCreateInfo;
+			if (shader->getSource().shaderBitFlags == VK_SHADER_STAGE_COMPUTE_BIT) {
+				pending->computePipeline = createComputePipeline(info);
+			} else {
+				graphicsInfos.push_back(info);
+			}
+		}
+		if (!graphicsInfos.empty()) {
+			pending->graphicsPipeline = createGraphicsPipeline(graphicsInfos);
+		}
+	} catch (const std::exception &e) {
+		vkDestroyPipeline(device.device(), pending->computePipeline, nullptr);
+		std::cerr << "pipeline reload failed, keeping the old pipeline: " << e.what() << std::endl;
+		return false;
+	}
+	pending->shaders = std::move(reloaded);
+
+	std::lock_guard<std::mutex> lock{reloadMutex};
+	if (pendingReload != nullptr) {
+		// never swapped in, so no frame used it
+		vkDestroyPipeline(device.device(), pendingReload->graphicsPipeline, nullptr);
+		vkDestroyPipeline(device.device(), pendingReload->computePipeline, nullptr);
+	}
+	pendingReload = std::move(pending);
+	return true;
+}
+
+bool Pipeline::applyReload(std::vector<VkPipeline> &retired) {
+	std::lock_guard<std::mutex> lock{reloadMutex};
+	if (pendingReload == nullptr) return false;
+
+	if (hasGraphics > 0) {
+		retired.push_back(graphicsPipeline);
+		graphicsPipeline = pendingReload->graphicsPipeline;
+	}
+	if (hasCompute) {
+		retired.push_back(computePipeline);
+		computePipeline = pendingReload->computePipeline;
+	}
+	// modules aren't needed once the pipelines exist, the old ones go with their shaders
+	createShaders(std::move(pendingReload->shaders));
+	pendingReload.reset();
+	return true;
+}
+
+bool Pipeline::usesFile(const std::filesystem::path &file) const {
+	std::filesystem::path normal = file.lexically_normal();
+	std::lock_guard<std::mutex> lock{reloadMutex};
+	for (const auto &shader : shaders) {
+		const Source &source = shader->getSource();
+		if (source.filePath.lexically_normal() == normal) return true;
+		for (const auto &dependency : source.dependencies) {
+			if (dependency.lexically_normal() == normal) return true;
+		}
+	}
+	return false;
+}
+
+std::vector<Pipeline *> Pipeline::acquire(
+	const std::function<bool(const Pipeline &)> &filter) {
+	std::lock_guard<std::mutex> lock{registryMutex};
+	std::vector<Pipeline *> acquired{};
+	for (Pipeline *pipeline : registry) {
+		if (!filter(*pipeline)) continue;
+		pipeline->reloadUsers++;
+		acquired.push_back(pipeline);
+	}
+	return acquired;
+}
+
+void Pipeline::release(const std::vector<Pipeline *> &pipelines) {
+	{
+		std::lock_guard<std::mutex> lock{registryMutex};
+		for (Pipeline *pipeline : pipelines) {
+			pipeline->reloadUsers--;
+		}
+	}
+	registryCondition.notify_all();
+}
+
+void Pipeline::applyReloads(std::vector<VkPipeline> &retired) {
+	std::lock_guard<std::mutex> lock{registryMutex};
+	for (Pipeline *pipeline : registry) {
+		pipeline->applyReload(retired);
+	}
+}
+
 void Pipeline::bind(VkCommandBuffer commandBuffer) {
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 }
@@ -2,7 +2,11 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -38,6 +42,11 @@ class Pipeline {
 		Device &device,
 		const std::vector<std::string> filePaths,
 		const PipelineConfigInfo &configInfo);
+	// Takes shaders that were already loaded, to reflect their layout first
+	Pipeline(
+		Device &device,
+		std::vector<std::unique_ptr<Shader>> shaders,
+		const PipelineConfigInfo &configInfo);
 
 	~Pipeline();
 
@@ -47,17 +56,45 @@ class Pipeline {
 	void bind(VkCommandBuffer commandBuffer);
 	void bindCompute(VkCommandBuffer computeCommandBuffer);
 
+	// Hot reload, driven by ShaderHotReload. reload() builds the pipeline again from its shader
+	// files on the calling thread. It keeps the current pipeline when a shader doesn't compile or
+	// declares different resources than the pipeline layout was made for.
+	bool reload();
+	// Swaps a reloaded pipeline in, the replaced handles go to `retired` as frames in flight may
+	// still use them
+	bool applyReload(std::vector<VkPipeline> &retired);
+	// Whether a shader of the pipeline is or includes `file`
+	bool usesFile(const std::filesystem::path &file) const;
+
+	// Live pipelines matching `filter`, they aren't destroyed before being released
+	static std::vector<Pipeline *> acquire(const std::function<bool(const Pipeline &)> &filter);
+	static void release(const std::vector<Pipeline *> &pipelines);
+	// Calls applyReload() on every live pipeline
+	static void applyReloads(std::vector<VkPipeline> &retired);
+
 	static void defaultPipelineConfigInfo(
 		PipelineConfigInfo &configInfo, VkSampleCountFlagBits msaaSamples);
 	static void enableAlphaBlending(PipelineConfigInfo &configInfo);
 
    private:
-	void createGraphicsPipeline(const PipelineConfigInfo &configInfo);
-	void createComputePipeline(const PipelineConfigInfo &configInfo);
+	struct PendingReload {
+		std::vector<std::unique_ptr<Shader>> shaders{};
+		VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+		VkPipeline computePipeline = VK_NULL_HANDLE;
+	};
 
-	void createShaders(const std::vector<std::string> filePaths);
+	// PipelineConfigInfo points into itself, so the copy is repointed
+	static void copyConfigInfo(const PipelineConfigInfo &from, PipelineConfigInfo &to);
+
+	VkPipeline createGraphicsPipeline(
+		const std::vector<VkPipelineShaderStageCreateInfo> &graphicsInfos);
+	VkPipeline createComputePipeline(const VkPipelineShaderStageCreateInfo &computeInfo);
+
+	void createShaders(std::vector<std::unique_ptr<Shader>> loadedShaders);
+	std::vector<std::string> getShaderPaths() const;
 
 	Device &device;
+	PipelineConfigInfo configInfo{};
 	VkPipeline graphicsPipeline{};
 	VkPipeline computePipeline{};
 
@@ -66,5 +103,15 @@ class Pipeline {
 	std::vector<std::unique_ptr<Shader>> shaders{};
 	VkPipelineShaderStageCreateInfo createComputeInfo;
 	std::vector<VkPipelineShaderStageCreateInfo> createGraphicsInfos;
+
+	// guards shaders and pendingReload between the reload thread and the render thread
+	mutable std::mutex reloadMutex;
+	std::unique_ptr<PendingReload> pendingReload{};
+
+	// pipelines acquired by the reload thread, guarded by registryMutex
+	uint32_t reloadUsers = 0;
+	inline static std::mutex registryMutex;
+	inline static std::condition_variable registryCondition;
+	inline static std::vector<Pipeline *> registry{};
 };
 }  // namespace lvr
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "release_queue.h"
+
+#include "swapchain.h"
+
+// std
+#include <vector>
+
+namespace lvr {
+
+void ReleaseQueue::defer(std::function<void()> release) {
+	std::lock_guard<std::mutex> lock{mutex};
+	entries.push_back({frame, std::move(release)});
+}
+
+void ReleaseQueue::update() {
+	std::vector<Entry> ready{};
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		frame++;
+		while (!entries.empty() &&
+			   frame - entries.front().frame >= SwapChain::MAX_FRAMES_IN_FLIGHT) {
+			ready.push_back(std::move(entries.front()));
+			entries.pop_front();
+		}
+	}
+	for (Entry &entry : ready) {
+		entry.release();
+	}
+}
+
+void ReleaseQueue::flush() {
+	while (true) {
+		std::deque<Entry> ready{};
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			if (entries.empty()) return;
+			std::swap(ready, entries);
+		}
+		for (Entry &entry : ready) {
+			entry.release();
+		}
+	}
+}
+
+}  // namespace lvr
@@ -0,0 +1,51 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace lvr {
+
+// Holds back the release of resources that frames in flight may still use. update() counts
+// frames: a resource handed over before update() number f was last used by frame f - 1 at the
+// latest, which finished once MAX_FRAMES_IN_FLIGHT more frames waited on their fences. Its release
+// runs in the update() where frame - f >= MAX_FRAMES_IN_FLIGHT. Releases may hand over new
+// resources, they run without the lock held.
+class ReleaseQueue {
+   public:
+	ReleaseQueue() = default;
+	~ReleaseQueue() { flush(); }
+
+	ReleaseQueue(const ReleaseQueue &) = delete;
+	ReleaseQueue &operator=(const ReleaseQueue &) = delete;
+
+	// Runs `release` once no frame in flight can use what it releases
+	void defer(std::function<void()> release);
+	// Destroys `resource` once no frame in flight can use it
+	template <typename T>
+	void retire(T resource) {
+		auto held = std::make_shared<T>(std::move(resource));
+		defer([held = std::move(held)]() mutable { held.reset(); });
+	}
+
+	// Call once per frame after its fence was waited on, before recording
+	void update();
+	// Runs every pending release, call once the device is idle
+	void flush();
+
+   private:
+	struct Entry {
+		uint64_t frame;
+		std::function<void()> release;
+	};
+
+	std::deque<Entry> entries{};
+	uint64_t frame = 0;
+	std::mutex mutex;
+};
+
+}  // namespace lvr
@@ -7,9 +7,12 @@
 
 namespace lvr {
 
-Renderer::Renderer(Window &window, Device &device) : lvrWindow{window}, lvrDevice{device} {
+Renderer::Renderer(Window &window, Device &device, uint32_t recordingThreadCount)
+	: lvrWindow{window}, lvrDevice{device} {
 	recreateSwapChain();
 	createCommandBuffers();
+	secondaryCommandBuffers =
+		std::make_unique<SecondaryCommandBuffers>(device, recordingThreadCount);
 }
 
 Renderer::~Renderer() { freeCommandBuffers(); }
@@ -72,6 +75,8 @@ VkCommandBuffer Renderer::beginFrame() {
 	}
 
 	isFrameStarted = true;
+	// acquiring waited on the frame's fences, its secondary command buffers are free again
+	secondaryCommandBuffers->beginFrame(currentFrameIndex);
 
 	auto commandBuffer = getCurrentCommandBuffer();
 	VkCommandBufferBeginInfo beginInfo{};
@@ -103,7 +108,8 @@ void Renderer::endFrame() {
 	currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
 }
 
-void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+void Renderer::beginSwapChainRenderPass(
+	VkCommandBuffer commandBuffer, VkSubpassContents contents) {
 	assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
 	assert(
 		commandBuffer == getCurrentCommandBuffer() &&
@@ -124,7 +130,16 @@ void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+	subpassContents = contents;
+	if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+		// the primary may only execute secondaries now, they set viewport and scissor themselves
+		secondaryCommandBuffers->setRenderPass(
+			renderPassInfo.renderPass,
+			renderPassInfo.framebuffer,
+			renderPassInfo.renderArea.extent);
+		return;
+	}
 
 	VkViewport viewport{};
 	viewport.x = 0.0f;
@@ -147,6 +162,9 @@ void Renderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
 	assert(
 		commandBuffer == getCurrentCommandBuffer() &&
 		"Can't end render pass on command buffer from a different frame");
+	if (subpassContents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+		secondaryCommandBuffers->execute(commandBuffer);
+	}
 	vkCmdEndRenderPass(commandBuffer);
 }
 
@@ -6,6 +6,7 @@
 #include <cstdint>
 
 #include "device.h"
+#include "secondary_command_buffers.h"
 #include "swapchain.h"
 #include "window.h"
 
@@ -18,7 +19,8 @@ namespace lvr {
 
 class Renderer {
    public:
-	Renderer(Window &window, Device &device);
+	// recordingThreadCount is the number of threads recording secondary command buffers
+	Renderer(Window &window, Device &device, uint32_t recordingThreadCount = 1);
 	~Renderer();
 
 	Renderer(const Renderer &) = delete;
@@ -40,10 +42,16 @@ class Renderer {
 		return currentFrameIndex;
 	}
 
+	SecondaryCommandBuffers &getSecondaryCommandBuffers() { return *secondaryCommandBuffers; }
+
 	VkCommandBuffer beginFrame();
 	void endFrame();
 
-	void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+	// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS everything drawn in the pass is recorded
+	// into getSecondaryCommandBuffers(), the queued ones are executed when the pass ends.
+	void beginSwapChainRenderPass(
+		VkCommandBuffer commandBuffer,
+		VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 	void submitComputeCommandBuffers(VkCommandBuffer commandBuffer);
 	void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
@@ -56,6 +64,8 @@ class Renderer {
 	Device &lvrDevice;
 	std::shared_ptr<SwapChain> lvrSwapChain;
 	std::vector<VkCommandBuffer> commandBuffers;
+	std::unique_ptr<SecondaryCommandBuffers> secondaryCommandBuffers;
+	VkSubpassContents subpassContents = VK_SUBPASS_CONTENTS_INLINE;
 
 	uint32_t currentImageIndex;
 	int32_t currentFrameIndex{0};
@@ -0,0 +1,124 @@
+#include "secondary_command_buffers.h"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+#include "swapchain.h"
+
+namespace lvr {
+
+SecondaryCommandBuffers::SecondaryCommandBuffers(Device &device, uint32_t threadCount)
+	: lvrDevice{device}, threadCount{threadCount} {
+	assert(threadCount > 0 && "Need at least one recording thread");
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = device.findPhysicalQueueFamilies().graphicsAndComputeFamily.value();
+	// command buffers are only reset with their pool
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	frames.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+	for (auto &threads : frames) {
+		threads.resize(threadCount);
+		for (auto &thread : threads) {
+			if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &thread.pool) !=
+				VK_SUCCESS) {
+				throw std::runtime_error("failed to create secondary command pool!");
+			}
+		}
+	}
+
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.subpass = 0;
+}
+
+SecondaryCommandBuffers::~SecondaryCommandBuffers() {
+	// destroying a pool frees its command buffers
+	for (auto &threads : frames) {
+		for (auto &thread : threads) {
+			vkDestroyCommandPool(lvrDevice.device(), thread.pool, nullptr);
+		}
+	}
+}
+
+void SecondaryCommandBuffers::beginFrame(int frameIndex) {
+	currentFrame = frameIndex;
+	for (auto &thread : frames[frameIndex]) {
+		if (thread.used == 0) continue;
+		vkResetCommandPool(lvrDevice.device(), thread.pool, 0);
+		thread.used = 0;
+	}
+	queued.clear();
+}
+
+void SecondaryCommandBuffers::setRenderPass(
+	VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent) {
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.framebuffer = framebuffer;
+
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	scissor = {{0, 0}, extent};
+}
+
+VkCommandBuffer SecondaryCommandBuffers::begin(uint32_t threadIndex) {
+	assert(threadIndex < threadCount && "Recording thread index out of range");
+	assert(inheritanceInfo.renderPass != VK_NULL_HANDLE && "No render pass to record for");
+
+	auto &thread = frames[currentFrame][threadIndex];
+	if (thread.used == thread.commandBuffers.size()) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandPool = thread.pool;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(lvrDevice.device(), &allocInfo, &commandBuffer) !=
+			VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate secondary command buffer!");
+		}
+		thread.commandBuffers.push_back(commandBuffer);
+	}
+	VkCommandBuffer commandBuffer = thread.commandBuffers[thread.used++];
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+					  VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording secondary command buffer!");
+	}
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	return commandBuffer;
+}
+
+void SecondaryCommandBuffers::end(VkCommandBuffer commandBuffer) {
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record secondary command buffer!");
+	}
+}
+
+void SecondaryCommandBuffers::add(VkCommandBuffer commandBuffer) {
+	queued.push_back(commandBuffer);
+}
+
+void SecondaryCommandBuffers::execute(VkCommandBuffer primaryCommandBuffer) {
+	if (!queued.empty()) {
+		vkCmdExecuteCommands(
+			primaryCommandBuffer,
+			static_cast<uint32_t>(queued.size()),
+			queued.data());
+	}
+	queued.clear();
+}
+
+}  // namespace lvr
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "device.h"
+
+namespace lvr {
+
+// Secondary command buffers for the swap chain render pass, recorded in parallel. Every frame in
+// flight has one command pool per recording thread, so threads never share a pool and recording
+// needs no locks. A frame's pools are reset together once its fence was waited on and their
+// command buffers are reused by the next recording of that frame.
+class SecondaryCommandBuffers {
+   public:
+	SecondaryCommandBuffers(Device &device, uint32_t threadCount);
+	~SecondaryCommandBuffers();
+
+	SecondaryCommandBuffers(const SecondaryCommandBuffers &) = delete;
+	SecondaryCommandBuffers &operator=(const SecondaryCommandBuffers &) = delete;
+
+	// Call after the frame's fence was waited on
+	void beginFrame(int frameIndex);
+	// Call once the render pass was begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	void setRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+
+	// Starts recording from the pool of `threadIndex`, which only one thread may use per frame.
+	// Viewport and scissor are set, they aren't inherited from the primary command buffer.
+	VkCommandBuffer begin(uint32_t threadIndex);
+	void end(VkCommandBuffer commandBuffer);
+
+	// Queues a recorded command buffer, they run in the order they were added. Only call from the
+	// thread that records the primary command buffer.
+	void add(VkCommandBuffer commandBuffer);
+	// Executes and clears the queued command buffers, inside the render pass
+	void execute(VkCommandBuffer primaryCommandBuffer);
+
+	uint32_t getThreadCount() const { return threadCount; }
+
+   private:
+	struct ThreadCommands {
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> commandBuffers{};
+		// command buffers handed out since the pool was reset
+		uint32_t used = 0;
+	};
+
+	Device &lvrDevice;
+	uint32_t threadCount;
+	// [frame][thread]
+	std::vector<std::vector<ThreadCommands>> frames{};
+	int currentFrame = 0;
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	VkViewport viewport{};
+	VkRect2D scissor{};
+	std::vector<VkCommandBuffer> queued{};
+};
+
+}  // namespace lvr
@@ -1,21 +1,18 @@
 #include "compute_shader.h"
 
 #include <iostream>
+#include <utility>
+
+#include "layout_cache.h"
 
 namespace lvr {
 
 ComputeShader::ComputeShader(
-	Device& device,
-	VkRenderPass renderPass,
-	std::vector<std::string> filePaths,
-	std::unique_ptr<DescriptorSetLayout> computeShaderLayout)
-	: device(device), filePaths(filePaths), computeShaderLayout(std::move(computeShaderLayout)) {
-	createPipelineLayout();
-	createPipeline(renderPass);
-}
-
-ComputeShader::~ComputeShader() {
-	vkDestroyPipelineLayout(device.device(), computePipelineLayout, nullptr);
+	Device& device, VkRenderPass renderPass, std::vector<std::string> filePaths)
+	: device(device), filePaths(filePaths) {
+	auto shaders = Shader::Create(device, filePaths);
+	createPipelineLayout(shaders);
+	createPipeline(renderPass, std::move(shaders));
 }
 
 void ComputeShader::dispatchComputeShader(
@@ -37,32 +34,21 @@ void ComputeShader::dispatchComputeShader(
 	vkCmdDispatch(computeCommandBuffer, workGroupCount.x, workGroupCount.y, 1);
 }
 
-void ComputeShader::createPipelineLayout() {
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
-		computeShaderLayout->getDescriptorSetLayout()};
-
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-
-	if (vkCreatePipelineLayout(
-			device.device(),
-			&pipelineLayoutInfo,
-			nullptr,
-			&computePipelineLayout) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create computePipeline layout");
-	}
+void ComputeShader::createPipelineLayout(const std::vector<std::unique_ptr<Shader>>& shaders) {
+	ShaderLayout layout{shaders};
+	computeShaderLayout = &device.layoutCache().getSetLayout(layout, 0);
+	computePipelineLayout = device.layoutCache().getPipelineLayout(layout);
 }
 
-void ComputeShader::createPipeline(VkRenderPass renderPass) {
+void ComputeShader::createPipeline(
+	VkRenderPass renderPass, std::vector<std::unique_ptr<Shader>> shaders) {
 	assert(
 		computePipelineLayout != nullptr &&
 		"Cannot create computePipeline before computePipeline layout");
 
 	PipelineConfigInfo pipelineConfig{};
 	pipelineConfig.pipelineLayout = computePipelineLayout;
-	computePipeline = std::make_unique<Pipeline>(device, filePaths, pipelineConfig);
+	computePipeline = std::make_unique<Pipeline>(device, std::move(shaders), pipelineConfig);
 }
 
 }  // namespace lvr
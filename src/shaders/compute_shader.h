@@ -13,12 +13,8 @@ namespace lvr {
 class ComputeShader {
    public:
 	const uint32_t MAX_GROUPS_X = 32;
-	ComputeShader(
-		Device &device,
-		VkRenderPass renderPass,
-		std::vector<std::string> filePaths,
-		std::unique_ptr<DescriptorSetLayout> computeShaderLayout);
-	~ComputeShader();
+	// The descriptor set layout is reflected from the shaders
+	ComputeShader(Device &device, VkRenderPass renderPass, std::vector<std::string> filePaths);
 
 	ComputeShader(const ComputeShader &) = delete;
 	ComputeShader &operator=(const ComputeShader &) = delete;
@@ -33,49 +29,40 @@ class ComputeShader {
 		const std::vector<T> computeBufferData);
 	template <typename T>
 	std::vector<T> getShaderStorageBuffers(std::unique_ptr<Buffer> &shaderBuffer);
-	std::unique_ptr<DescriptorSetLayout> &getComputeShaderLayout() { return computeShaderLayout; }
+	DescriptorSetLayout &getComputeShaderLayout() { return *computeShaderLayout; }
 
    private:
-	void createPipelineLayout();
-	void createPipeline(VkRenderPass renderPass);
+	void createPipelineLayout(const std::vector<std::unique_ptr<Shader>> &shaders);
+	void createPipeline(VkRenderPass renderPass, std::vector<std::unique_ptr<Shader>> shaders);
 
 	Device &device;
 
 	uint32_t bufferCount;
 
 	std::unique_ptr<Pipeline> computePipeline;
+	// layouts are owned by the device's layout cache
 	VkPipelineLayout computePipelineLayout{};
 	std::vector<std::string> filePaths;
 
 	bool isComputeDispatched;
 
 	int32_t currentFrameIndex{0};
-	std::unique_ptr<DescriptorSetLayout> computeShaderLayout{};
+	DescriptorSetLayout *computeShaderLayout = nullptr;
 };
 
 template <typename T>
 std::vector<std::unique_ptr<Buffer>> ComputeShader::createShaderStorageBuffers(
 	const std::vector<T> computeBufferData) {
-	// Create a staging buffer used to upload data to the gpu
 	bufferCount = static_cast<uint32_t>(computeBufferData.size());
 	uint32_t bufferItemSize = sizeof(computeBufferData[0]);
 	VkDeviceSize bufferSize = bufferItemSize * bufferCount;
 
-	Buffer stagingBuffer{
-		device,
-		bufferItemSize,
-		bufferCount,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	};
-
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void *)computeBufferData.data());
 	std::vector<std::unique_ptr<Buffer>> storageBuffers;
 
 	storageBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
 
-	// Copy initial particle data to all storage buffers
+	// Copy initial particle data to all storage buffers, staged through the upload queue. They are
+	// written on the compute queue and read by graphics, so share them across queue families
 	for (size_t i = 0; i < SwapChain::SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
 		storageBuffers[i] = std::make_unique<Buffer>(
 			device,
@@ -83,9 +70,13 @@ std::vector<std::unique_ptr<Buffer>> ComputeShader::createShaderStorageBuffers(
 			bufferCount,
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
 				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		;
-		device.copyBuffer(stagingBuffer.getBuffer(), storageBuffers[i]->getBuffer(), bufferSize);
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			1,
+			VK_SHARING_MODE_CONCURRENT);
+		device.uploadQueue().uploadBuffer(
+			*storageBuffers[i],
+			computeBufferData.data(),
+			bufferSize);
 	}
 
 	return storageBuffers;
@@ -38,7 +38,7 @@ void ComputeShaderManager::createComputeCommandBuffers() {
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = device.getCommandPool();
+	allocInfo.commandPool = device.getComputeCommandPool();
 	allocInfo.commandBufferCount = static_cast<uint32_t>(computeCommandBuffers.size());
 
 	if (vkAllocateCommandBuffers(device.device(), &allocInfo, computeCommandBuffers.data()) !=
@@ -50,7 +50,7 @@ void ComputeShaderManager::createComputeCommandBuffers() {
 void ComputeShaderManager::freeComputeCommandBuffers() {
 	vkFreeCommandBuffers(
 		device.device(),
-		device.getCommandPool(),
+		device.getComputeCommandPool(),
 		static_cast<uint32_t>(computeCommandBuffers.size()),
 		computeCommandBuffers.data());
 	computeCommandBuffers.clear();
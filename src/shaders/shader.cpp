@@ -2,20 +2,31 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <future>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <shaderc/shaderc.hpp>
 #include <spirv_cross/spirv_cross.hpp>
 #include <spirv_cross/spirv_glsl.hpp>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "../utils/thread_pool.h"
+
 namespace lvr {
 
 namespace Utils {
@@ -61,9 +72,279 @@ static void CreateCacheDirectoryIfNeeded() {
 	if (!std::filesystem::exists(cacheDirectory))
 		std::filesystem::create_directories(cacheDirectory);
 }
+
+static const char* GetShaderDirectory() { return "shaders/"; }
+
+// Shared by every batch passed to Shader::Create, created on first use
+static utils::ThreadPool& GetCompilePool() {
+	static utils::ThreadPool pool{};
+	return pool;
+}
+
+// Constructing a compiler sets up glslang, so each thread keeps its own instead of paying for that
+// per shader or contending on a shared one
+static shaderc::Compiler& GetCompiler() {
+	thread_local shaderc::Compiler compiler;
+	return compiler;
+}
+
+// Part of every cache key, bump it when the key or the binaries change in a way the inputs don't
+constexpr uint32_t CACHE_FORMAT_VERSION = 1;
+constexpr shaderc_env_version TARGET_ENV_VERSION = shaderc_env_version_vulkan_1_3;
+constexpr shaderc_optimization_level OPTIMIZATION_LEVEL = shaderc_optimization_level_performance;
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+static uint64_t HashBytes(const void* data, size_t size, uint64_t hash) {
+	// FNV-1a, stable across runs unlike std::hash
+	const auto* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static uint64_t HashString(const std::string& string, uint64_t hash) {
+	return HashBytes(string.data(), string.size(), hash);
+}
+
+template <typename T>
+static uint64_t HashValue(T value, uint64_t hash) {
+	return HashBytes(&value, sizeof(value), hash);
+}
+
+static std::string ToHex(uint64_t value) {
+	char buffer[17];
+	std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+	return buffer;
+}
+
+static bool ReadFileIfExists(const std::filesystem::path& path, std::string& contents) {
+	std::ifstream in{path, std::ios::in | std::ios::binary};
+	if (!in) return false;
+	contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	return true;
+}
+
+// Names of the files a GLSL source includes with #include "name" or #include <name>. Includes in
+// inactive #if blocks are listed too, which only makes the key depend on more than it needs.
+static std::vector<std::string> FindIncludes(const std::string& source) {
+	std::vector<std::string> includes;
+	std::istringstream stream{source};
+	std::string line;
+	while (std::getline(stream, line)) {
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line[start] != '#') continue;
+		start = line.find_first_not_of(" \t", start + 1);
+		if (start == std::string::npos || line.compare(start, 7, "include") != 0) continue;
+
+		size_t open = line.find_first_of("\"<", start + 7);
+		if (open == std::string::npos) continue;
+		size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+		if (close == std::string::npos) continue;
+		includes.push_back(line.substr(open + 1, close - open - 1));
+	}
+	return includes;
+}
+
+// Next to the including file first, then in the shader directory
+static std::filesystem::path ResolveInclude(
+	const std::string& name, const std::filesystem::path& includingFile) {
+	std::filesystem::path relative = includingFile.parent_path() / name;
+	if (std::filesystem::exists(relative)) return relative.lexically_normal();
+	return (std::filesystem::path(GetShaderDirectory()) / name).lexically_normal();
+}
+
+// Hashes the path and contents of every file `source` includes, recursively and in include order.
+// A missing include still hashes its path, so creating the file later changes the key.
+static uint64_t HashIncludes(
+	const std::string& source,
+	const std::filesystem::path& file,
+	uint64_t hash,
+	std::vector<std::filesystem::path>& dependencies) {
+	for (const auto& name : FindIncludes(source)) {
+		std::filesystem::path path = ResolveInclude(name, file);
+		hash = HashString(path.string(), hash);
+		if (std::find(dependencies.begin(), dependencies.end(), path) != dependencies.end()) {
+			continue;
+		}
+		dependencies.push_back(path);
+
+		std::string contents;
+		if (!ReadFileIfExists(path, contents)) continue;
+		hash = HashString(contents, hash);
+		hash = HashIncludes(contents, path, hash, dependencies);
+	}
+	return hash;
+}
+
+// Everything that changes the compiled SPIR-V: source, stage, compile options, target env and the
+// included files. Fills in the source's dependencies on the way.
+static uint64_t ComputeCacheKey(Source& source) {
+	uint64_t hash = HashValue(CACHE_FORMAT_VERSION, 0xcbf29ce484222325ull);
+	hash = HashValue(source.shaderBitFlags, hash);
+	hash = HashValue(TARGET_ENV_VERSION, hash);
+	hash = HashValue(OPTIMIZATION_LEVEL, hash);
+	hash = HashString(source.sourceString, hash);
+	source.dependencies.clear();
+	return HashIncludes(source.sourceString, source.filePath, hash, source.dependencies);
+}
+
+static std::filesystem::path GetBinaryPath(const std::filesystem::path& sourcePath, uint64_t key) {
+	return std::filesystem::path(GetCacheDirectory()) /
+		   (sourcePath.filename().string() + "." + ToHex(key) + ".spv");
+}
+
+static bool ReadSpirv(const std::filesystem::path& path, std::vector<uint32_t>& data) {
+	std::ifstream in{path, std::ios::ate | std::ios::binary};
+	if (!in.is_open()) return false;
+
+	size_t size = static_cast<size_t>(in.tellg());
+	// a binary cut short by a crash is compiled again
+	if (size < sizeof(uint32_t) || size % sizeof(uint32_t) != 0) return false;
+	in.seekg(0);
+	data.resize(size / sizeof(uint32_t));
+	in.read(reinterpret_cast<char*>(data.data()), size);
+	return in && data[0] == SPIRV_MAGIC;
+}
+
+// Resolves #include for shaderc the same way HashIncludes does, so the key covers what's compiled
+class FileIncluder : public shaderc::CompileOptions::IncluderInterface {
+   public:
+	shaderc_include_result* GetInclude(
+		const char* requestedSource,
+		shaderc_include_type type,
+		const char* requestingSource,
+		size_t includeDepth) override {
+		auto* file = new IncludedFile{};
+		file->name = ResolveInclude(requestedSource, requestingSource).string();
+		if (!ReadFileIfExists(file->name, file->contents)) {
+			// an empty name tells shaderc the include failed, the contents hold the error
+			file->contents = "failed to open include " + file->name;
+			file->name.clear();
+		}
+		file->result.source_name = file->name.data();
+		file->result.source_name_length = file->name.size();
+		file->result.content = file->contents.data();
+		file->result.content_length = file->contents.size();
+		file->result.user_data = file;
+		return &file->result;
+	}
+
+	void ReleaseInclude(shaderc_include_result* result) override {
+		delete static_cast<IncludedFile*>(result->user_data);
+	}
+
+   private:
+	struct IncludedFile {
+		std::string name;
+		std::string contents;
+		shaderc_include_result result{};
+	};
+};
+
+// Key of the newest binary of every shader source, kept in <cache>/index.txt. Loading it prunes
+// binaries of sources that were deleted and of older cache formats, and replacing a source's key
+// deletes the binary it pointed to, so edits don't pile up stale binaries.
+class CacheIndex {
+   public:
+	static CacheIndex& Get() {
+		static CacheIndex index;
+		return index;
+	}
+
+	bool Contains(const std::string& sourcePath, uint64_t key) {
+		std::lock_guard<std::mutex> lock{mutex};
+		auto entry = entries.find(sourcePath);
+		return entry != entries.end() && entry->second == key;
+	}
+
+	void Update(const std::string& sourcePath, uint64_t key) {
+		std::lock_guard<std::mutex> lock{mutex};
+		auto entry = entries.find(sourcePath);
+		if (entry != entries.end()) {
+			if (entry->second == key) return;
+			uint64_t staleKey = entry->second;
+			entry->second = key;
+			RemoveBinaryIfUnused(sourcePath, staleKey);
+		} else {
+			entries.emplace(sourcePath, key);
+		}
+		Save();
+	}
+
+   private:
+	CacheIndex() {
+		std::ifstream in{GetIndexPath()};
+		std::string line;
+		while (std::getline(in, line)) {
+			// <key> <source path>
+			size_t separator = line.find(' ');
+			if (separator != 16) continue;
+			std::string sourcePath = line.substr(separator + 1);
+			uint64_t key = std::strtoull(line.substr(0, separator).c_str(), nullptr, 16);
+			if (std::filesystem::exists(sourcePath)) entries.emplace(sourcePath, key);
+		}
+		Prune();
+	}
+
+	static std::filesystem::path GetIndexPath() {
+		return std::filesystem::path(GetCacheDirectory()) / "index.txt";
+	}
+
+	// Deletes every binary no entry points to
+	void Prune() {
+		std::vector<std::string> keep;
+		for (const auto& [sourcePath, key] : entries) {
+			keep.push_back(GetBinaryPath(sourcePath, key).filename().string());
+		}
+
+		std::error_code ec;
+		for (const auto& file : std::filesystem::directory_iterator(GetCacheDirectory(), ec)) {
+			// .tmp files are binaries whose writer crashed
+			if (file.path().extension() != ".spv" && file.path().extension() != ".tmp") continue;
+			if (std::find(keep.begin(), keep.end(), file.path().filename().string()) != keep.end()) {
+				continue;
+			}
+			std::filesystem::remove(file.path(), ec);
+		}
+		Save();
+	}
+
+	// Sources with the same contents and file name share a binary
+	void RemoveBinaryIfUnused(const std::string& sourcePath, uint64_t key) {
+		std::filesystem::path binaryPath = GetBinaryPath(sourcePath, key);
+		for (const auto& [otherPath, otherKey] : entries) {
+			if (otherKey == key && GetBinaryPath(otherPath, otherKey) == binaryPath) return;
+		}
+		std::error_code ec;
+		std::filesystem::remove(binaryPath, ec);
+	}
+
+	// Written aside and renamed, a crash never leaves a partial index behind
+	void Save() {
+		std::filesystem::path path = GetIndexPath();
+		std::filesystem::path tempPath = path;
+		tempPath += ".tmp";
+		{
+			std::ofstream out{tempPath, std::ios::out | std::ios::trunc};
+			if (!out.is_open()) return;
+			for (const auto& [sourcePath, key] : entries) {
+				out << ToHex(key) << ' ' << sourcePath << '\n';
+			}
+			if (!out) return;
+		}
+		std::error_code ec;
+		std::filesystem::rename(tempPath, path, ec);
+	}
+
+	std::mutex mutex;
+	std::unordered_map<std::string, uint64_t> entries;
+};
 }  // namespace Utils
 
 Shader::Shader(Device& device, const std::string& filePath) : device(device) {
+	auto start = std::chrono::high_resolution_clock::now();
 	Utils::CreateCacheDirectoryIfNeeded();
 	source.filePath = filePath;
 
@@ -71,6 +352,8 @@ Shader::Shader(Device& device, const std::string& filePath) : device(device) {
 	PreProcess(source);
 
 	CompileOrGetVulkanBinaries(source);
+	auto end = std::chrono::high_resolution_clock::now();
+	compileMs = std::chrono::duration<double, std::milli>(end - start).count();
 }
 
 Shader::~Shader() { vkDestroyShaderModule(device.device(), shaderInfo.shaderModule, nullptr); }
@@ -106,50 +389,50 @@ void Shader::PreProcess(Source& source) {
 }
 
 void Shader::CompileOrGetVulkanBinaries(Source& shaderSource) {
-	shaderc::Compiler compiler;
-	shaderc::CompileOptions options;
-	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
-
-	const bool optimize = true;
-	if (optimize) options.SetOptimizationLevel(shaderc_optimization_level_performance);
-
-	std::filesystem::path cacheDirectory = Utils::GetCacheDirectory();
-
 	auto& shaderData = source.m_VulkanSPIRV;
 	shaderData.clear();
 
-	std::filesystem::path shaderFilePath = source.filePath;
-	std::filesystem::path cachedPath =
-		cacheDirectory / (shaderFilePath.filename().string() + ".spv");
+	std::string sourcePath = source.filePath.lexically_normal().string();
+	uint64_t key = Utils::ComputeCacheKey(source);
+	std::filesystem::path cachedPath = Utils::GetBinaryPath(source.filePath, key);
+	auto& index = Utils::CacheIndex::Get();
 
-	std::ifstream in{cachedPath, std::ios::ate | std::ios::binary};
-	if (in.is_open()) {
-		size_t size = static_cast<size_t>(in.tellg());
-
-		in.seekg(0);
-		auto& data = source.m_VulkanSPIRV;
-		data.resize(size / sizeof(uint32_t));
-		in.read((char*)data.data(), size);
-		in.close();
+	// the binary of a key found in the index is trusted to exist, unindexed ones are probed for
+	// since a source with the same name and contents may have compiled it already
+	fromCache = Utils::ReadSpirv(cachedPath, shaderData);
+	if (fromCache) {
+		if (!index.Contains(sourcePath, key)) index.Update(sourcePath, key);
 	} else {
-		shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(
+		shaderc::CompileOptions options;
+		options.SetTargetEnvironment(shaderc_target_env_vulkan, Utils::TARGET_ENV_VERSION);
+		options.SetOptimizationLevel(Utils::OPTIMIZATION_LEVEL);
+		options.SetIncluder(std::make_unique<Utils::FileIncluder>());
+
+		shaderc::SpvCompilationResult module = Utils::GetCompiler().CompileGlslToSpv(
 			source.sourceString,
 			Utils::ShaderStageToShaderC(source.shaderBitFlags),
-			source.filePath.c_str(),
+			sourcePath.c_str(),
 			options);
 		if (module.GetCompilationStatus() != shaderc_compilation_status_success) {
 			throw std::runtime_error(module.GetErrorMessage());
 			assert(false);
 		}
 
-		source.m_VulkanSPIRV = std::vector<uint32_t>(module.cbegin(), module.cend());
+		shaderData = std::vector<uint32_t>(module.cbegin(), module.cend());
 
-		std::ofstream out(cachedPath, std::ios::out | std::ios::binary);
+		// written aside and renamed so a crash never leaves a truncated binary under the key,
+		// threads compiling identical sources each write their own file
+		std::filesystem::path tempPath = cachedPath;
+		tempPath += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) +
+					".tmp";
+		std::ofstream out(tempPath, std::ios::out | std::ios::binary);
 		if (out.is_open()) {
-			auto& data = source.m_VulkanSPIRV;
-			out.write((char*)data.data(), data.size() * sizeof(uint32_t));
-			out.flush();
+			out.write((char*)shaderData.data(), shaderData.size() * sizeof(uint32_t));
 			out.close();
+
+			std::error_code ec;
+			std::filesystem::rename(tempPath, cachedPath, ec);
+			if (!ec) index.Update(sourcePath, key);
 		}
 	}
 
@@ -160,16 +443,40 @@ void Shader::Reflect(Source& source) {
 	spirv_cross::Compiler compiler(source.m_VulkanSPIRV);
 	spirv_cross::ShaderResources resources = compiler.get_shader_resources();
 
-	for (const auto& resource : resources.uniform_buffers) {
+	auto& reflection = source.reflection;
+	reflection = {};
+	auto addBindings = [&](const auto& resourceList, VkDescriptorType descriptorType) {
+		for (const auto& resource : resourceList) {
+			const auto& type = compiler.get_type(resource.type_id);
+			// arrays of arrays flatten into one binding, a runtime sized dimension makes it 0
+			uint32_t count = 1;
+			for (uint32_t size : type.array) {
+				count *= size;
+			}
+			reflection.bindings.push_back(
+				{compiler.get_decoration(resource.id, spv::DecorationDescriptorSet),
+				 compiler.get_decoration(resource.id, spv::DecorationBinding),
+				 descriptorType,
+				 count});
+		}
+	};
+	addBindings(resources.uniform_buffers, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+	addBindings(resources.storage_buffers, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	addBindings(resources.sampled_images, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	addBindings(resources.separate_images, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+	addBindings(resources.separate_samplers, VK_DESCRIPTOR_TYPE_SAMPLER);
+	addBindings(resources.storage_images, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+
+	for (const auto& resource : resources.push_constant_buffers) {
 		const auto& bufferType = compiler.get_type(resource.base_type_id);
-		uint32_t bufferSize = compiler.get_declared_struct_size(bufferType);
-		uint32_t binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
-		int memberCount = bufferType.member_types.size();
+		reflection.pushConstantSize = std::max(
+			reflection.pushConstantSize,
+			static_cast<uint32_t>(compiler.get_declared_struct_size(bufferType)));
 	}
 }
 
 std::unique_ptr<Shader> Shader::Create(Device& device, const std::string& filepath) {
-	std::unique_ptr<Shader> shader = std::make_unique<Shader>(Shader(device, filepath));
+	std::unique_ptr<Shader> shader = std::make_unique<Shader>(device, filepath);
 
 	shader->shaderInfo.createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	shader->shaderInfo.createInfo.codeSize = 4 * shader->source.m_VulkanSPIRV.size();
@@ -197,11 +504,29 @@ std::unique_ptr<Shader> Shader::Create(Device& device, const std::string& filepa
 std::vector<std::unique_ptr<Shader>> Shader::Create(
 	Device& device, const std::vector<std::string> filePaths) {
 	std::vector<std::unique_ptr<Shader>> shaders;
+	if (filePaths.size() == 1) {
+		shaders.push_back(Create(device, filePaths[0]));
+	} else {
+		std::vector<std::future<std::unique_ptr<Shader>>> pending;
+		pending.reserve(filePaths.size());
+		for (const auto& filePath : filePaths) {
+			pending.push_back(Utils::GetCompilePool().submit(
+				[&device, filePath]() { return Create(device, filePath); }));
+		}
+		// let every compile finish before a failed one throws
+		for (auto& shader : pending) {
+			shader.wait();
+		}
+		for (auto& shader : pending) {
+			shaders.push_back(shader.get());
+		}
+	}
 
-	for (auto filePath : filePaths) {
-		shaders.push_back(Create(device, filePath));
+	for (const auto& shader : shaders) {
+		if (shader->isFromCache()) continue;
+		std::cout << "compiled " << shader->source.filePath.string() << " in "
+				  << shader->getCompileMs() << " ms" << std::endl;
 	}
-	// std::cout << shaders[1]->shaderInfo.shaderCreateInfo.pNext << std::endl;
 	return shaders;
 }
 
@@ -17,16 +17,38 @@ namespace lvr {
 
 struct ShaderInfo {
 	ShaderInfo() = default;
-	VkShaderModule shaderModule;
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
 	VkShaderModuleCreateInfo createInfo{};
 	VkPipelineShaderStageCreateInfo shaderCreateInfo{};
 };
 
+// A descriptor binding declared by a shader, count is 0 for runtime sized arrays
+struct ReflectedBinding {
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType descriptorType;
+	uint32_t count;
+
+	bool operator==(const ReflectedBinding&) const = default;
+};
+
+// Resources a shader's SPIR-V declares
+struct ShaderReflection {
+	std::vector<ReflectedBinding> bindings{};
+	// size of the push constant block, 0 without one
+	uint32_t pushConstantSize = 0;
+
+	bool operator==(const ShaderReflection&) const = default;
+};
+
 struct Source {
 	VkShaderStageFlagBits shaderBitFlags;
 	std::string sourceString{};
 	std::filesystem::path filePath;
+	// files pulled in through #include, recursively
+	std::vector<std::filesystem::path> dependencies;
 	std::vector<uint32_t> m_VulkanSPIRV;
+	ShaderReflection reflection{};
 };
 class Shader {
    public:
@@ -34,12 +56,21 @@ class Shader {
 
 	~Shader();
 
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+
+	// Loads or compiles the shaders in parallel on a shared pool of compile threads and returns
+	// once every module was created, in the order of filePaths. Logs the time of every shader that
+	// had to be compiled.
 	static std::vector<std::unique_ptr<Shader>> Create(
 		Device& device, const std::vector<std::string> filePaths);
 	static std::unique_ptr<Shader> Create(Device& device, const std::string& filePath);
 
-	const Source getSource() const { return source; }
-	const ShaderInfo getShaderInfo() const { return shaderInfo; }
+	const Source& getSource() const { return source; }
+	const ShaderInfo& getShaderInfo() const { return shaderInfo; }
+	// Time spent reading, hashing and loading or compiling the SPIR-V
+	double getCompileMs() const { return compileMs; }
+	bool isFromCache() const { return fromCache; }
 
    private:
 	std::string ReadFile(const std::string& filePath);
@@ -53,6 +84,8 @@ class Shader {
 	Source source{};
 
 	ShaderInfo shaderInfo{};
+	double compileMs = 0.0;
+	bool fromCache = false;
 };
 
 }  // namespace lvr
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "shader_hot_reload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <system_error>
+
+#include "pipeline.h"
+#include "release_queue.h"
+
+#if defined(LVR_PLATFORM_LINUX)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define LVR_SHADER_INOTIFY
+#endif
+
+namespace lvr {
+
+namespace {
+
+// how long the watcher sleeps before checking whether it should stop
+constexpr int POLL_INTERVAL_MS = 250;
+// editors save in several steps, events this close together are handled as one change
+constexpr int DEBOUNCE_MS = 50;
+
+void addChange(std::vector<std::filesystem::path> &changed, const std::filesystem::path &file) {
+	if (std::find(changed.begin(), changed.end(), file) == changed.end()) {
+		changed.push_back(file);
+	}
+}
+
+}  // namespace
+
+ShaderHotReload::ShaderHotReload(Device &device, std::filesystem::path directory)
+	: device{device}, directory{std::move(directory)} {
+#ifdef LVR_SHADER_INOTIFY
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	// saving in place closes the file, saving through a temporary renames it over the old one
+	if (inotifyFd < 0 ||
+		inotify_add_watch(inotifyFd, this->directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		std::cerr << "failed to watch " << this->directory.string()
+				  << ", shader hot reload is off" << std::endl;
+		if (inotifyFd >= 0) close(inotifyFd);
+		inotifyFd = -1;
+		return;
+	}
+#else
+	scanModificationTimes(nullptr);
+#endif
+	watcher = std::thread([this]() { watchLoop(); });
+}
+
+ShaderHotReload::~ShaderHotReload() {
+	stopping = true;
+	if (watcher.joinable()) watcher.join();
+#ifdef LVR_SHADER_INOTIFY
+	if (inotifyFd >= 0) close(inotifyFd);
+#endif
+}
+
+void ShaderHotReload::update() {
+	swapped.clear();
+	Pipeline::applyReloads(swapped);
+	for (VkPipeline pipeline : swapped) {
+		device.releaseQueue().defer([vkDevice = device.device(), pipeline]() {
+			vkDestroyPipeline(vkDevice, pipeline, nullptr);
+		});
+	}
+}
+
+void ShaderHotReload::watchLoop() {
+	while (!stopping) {
+		std::vector<std::filesystem::path> changed = waitForChanges();
+		if (!changed.empty()) reloadPipelines(changed);
+	}
+}
+
+std::vector<std::filesystem::path> ShaderHotReload::waitForChanges() {
+	std::vector<std::filesystem::path> changed{};
+#ifdef LVR_SHADER_INOTIFY
+	pollfd descriptor{inotifyFd, POLLIN, 0};
+	if (poll(&descriptor, 1, POLL_INTERVAL_MS) <= 0) return changed;
+
+	do {
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < length;) {
+			const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+			if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+				addChange(changed, directory / event->name);
+			}
+			offset += sizeof(inotify_event) + event->len;
+		}
+	} while (poll(&descriptor, 1, DEBOUNCE_MS) > 0);
+#else
+	std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+	scanModificationTimes(&changed);
+	if (!changed.empty()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(DEBOUNCE_MS));
+		scanModificationTimes(&changed);
+	}
+#endif
+	return changed;
+}
+
+void ShaderHotReload::scanModificationTimes(std::vector<std::filesystem::path> *changed) {
+	std::error_code ec;
+	for (const auto &entry : std::filesystem::directory_iterator(directory, ec)) {
+		if (!entry.is_regular_file(ec)) continue;
+		auto time = entry.last_write_time(ec);
+		if (ec) continue;
+
+		auto &known = modificationTimes[entry.path().string()];
+		if (known != time && changed != nullptr) addChange(*changed, entry.path());
+		known = time;
+	}
+}
+
+void ShaderHotReload::reloadPipelines(const std::vector<std::filesystem::path> &changed) {
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<Pipeline *> pipelines = Pipeline::acquire([&changed](const Pipeline &pipeline) {
+		return std::any_of(changed.begin(), changed.end(), [&pipeline](const auto &file) {
+			return pipeline.usesFile(file);
+		});
+	});
+	if (pipelines.empty()) {
+		Pipeline::release(pipelines);
+		return;
+	}
+
+	uint32_t reloaded = 0;
+	for (Pipeline *pipeline : pipelines) {
+		if (pipeline->reload()) reloaded++;
+	}
+	Pipeline::release(pipelines);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "reloaded " << reloaded << " of " << pipelines.size() << " pipelines using "
+			  << changed.front().string() << (changed.size() > 1 ? " and others" : "") << " in "
+			  << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+			  << std::endl;
+}
+
+}  // namespace lvr
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "device.h"
+
+namespace lvr {
+
+// Watches the shader directory and rebuilds every pipeline using a changed shader or include on a
+// background thread. A shader that fails to compile is logged and its pipeline keeps running the
+// old one. update() swaps rebuilt pipelines in between frames and destroys the replaced ones once
+// no frame in flight can use them. Uses inotify on Linux and polls modification times elsewhere.
+// Only the top level of the directory is watched.
+class ShaderHotReload {
+   public:
+	ShaderHotReload(Device &device, std::filesystem::path directory = "shaders");
+	~ShaderHotReload();
+
+	ShaderHotReload(const ShaderHotReload &) = delete;
+	ShaderHotReload &operator=(const ShaderHotReload &) = delete;
+
+	// Call once per frame, after the frame's fences were waited on and before recording
+	void update();
+
+   private:
+	void watchLoop();
+	// Files changed since the last call, empty when nothing changed within a poll interval
+	std::vector<std::filesystem::path> waitForChanges();
+	void scanModificationTimes(std::vector<std::filesystem::path> *changed);
+	void reloadPipelines(const std::vector<std::filesystem::path> &changed);
+
+	Device &device;
+	std::filesystem::path directory;
+	std::thread watcher{};
+	std::atomic<bool> stopping{false};
+
+	int inotifyFd = -1;
+	std::unordered_map<std::string, std::filesystem::file_time_type> modificationTimes{};
+
+	std::vector<VkPipeline> swapped{};
+};
+
+}  // namespace lvr
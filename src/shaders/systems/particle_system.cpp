@@ -3,42 +3,35 @@
 #include <cstring>
 #include <iostream>
 #include <random>
+#include <utility>
+
+#include "layout_cache.h"
 
 namespace lvr {
 ParticleSystem::ParticleSystem(Device& device, VkRenderPass renderPass) : device(device) {
 	computeShader = std::make_unique<ComputeShader>(
 		device,
 		renderPass,
-		std::vector<std::string>{"shaders/particles.comp"},
-		DescriptorSetLayout::Builder(device)
-			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-			.build());
-	createPipelineLayout();
-	createPipeline(renderPass);
+		std::vector<std::string>{"shaders/particles.comp"});
+	auto shaders = Shader::Create(
+		device,
+		std::vector<std::string>{
+			"shaders/particles.vert",
+			"shaders/particles.frag",
+		});
+	createPipelineLayout(shaders);
+	createPipeline(renderPass, std::move(shaders));
 	createParticles();
 	createUniformBuffers();
 	particlesBuffers = computeShader->createShaderStorageBuffers<Particle>(particles);
 }
 
-ParticleSystem::~ParticleSystem() {
-	vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+void ParticleSystem::createPipelineLayout(const std::vector<std::unique_ptr<Shader>>& shaders) {
+	pipelineLayout = device.layoutCache().getPipelineLayout(ShaderLayout{shaders});
 }
 
-void ParticleSystem::createPipelineLayout() {
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 0;
-	pipelineLayoutInfo.pSetLayouts = nullptr;
-
-	if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
-		VK_SUCCESS) {
-		throw std::runtime_error("Failed to create pipeline layout");
-	}
-}
-
-void ParticleSystem::createPipeline(VkRenderPass renderPass) {
+void ParticleSystem::createPipeline(
+	VkRenderPass renderPass, std::vector<std::unique_ptr<Shader>> shaders) {
 	assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
 	PipelineConfigInfo pipelineConfig{};
@@ -48,13 +41,7 @@ void ParticleSystem::createPipeline(VkRenderPass renderPass) {
 	pipelineConfig.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
 	pipelineConfig.renderPass = renderPass;
 	pipelineConfig.pipelineLayout = pipelineLayout;
-	pipeline = std::make_unique<Pipeline>(
-		device,
-		std::vector<std::string>{
-			"shaders/particles.vert",
-			"shaders/particles.frag",
-		},
-		pipelineConfig);
+	pipeline = std::make_unique<Pipeline>(device, std::move(shaders), pipelineConfig);
 }
 
 void ParticleSystem::createUniformBuffers() {
@@ -79,7 +66,7 @@ void ParticleSystem::dispatchCompute(FrameInfo& frameInfo, VkCommandBuffer compu
 		particlesBuffers[(frameIndex - 1) % SwapChain::MAX_FRAMES_IN_FLIGHT]->descriptorInfo();
 	auto bufferInfoCurrentFrame = particlesBuffers[frameIndex]->descriptorInfo();
 
-	DescriptorWriter(*computeShader->getComputeShaderLayout(), frameInfo.frameDescriptorPool)
+	DescriptorWriter(computeShader->getComputeShaderLayout(), frameInfo.frameDescriptorPool)
 		.writeBuffer(0, &bufferInfoubo)
 		.writeBuffer(1, &bufferInfoLastFrame)
 		.writeBuffer(2, &bufferInfoCurrentFrame)
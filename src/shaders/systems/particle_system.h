@@ -39,7 +39,6 @@ struct UniformBufferObject {
 class ParticleSystem {
    public:
 	ParticleSystem(Device &device, VkRenderPass renderPass);
-	~ParticleSystem();
 
 	void dispatchCompute(FrameInfo &frameInfo, VkCommandBuffer computeCommandBuffer);
 	void renderParticles(FrameInfo &frameInfo);
@@ -54,8 +53,8 @@ class ParticleSystem {
    private:
 	Device &device;
 
-	void createPipelineLayout();
-	void createPipeline(VkRenderPass renderPass);
+	void createPipelineLayout(const std::vector<std::unique_ptr<Shader>> &shaders);
+	void createPipeline(VkRenderPass renderPass, std::vector<std::unique_ptr<Shader>> shaders);
 	void createUniformBuffers();
 	void createParticles();
 
@@ -65,6 +64,7 @@ class ParticleSystem {
 	std::vector<Particle> particles = std::vector<Particle>(PARTICLE_COUNT);
 
 	std::unique_ptr<Pipeline> pipeline;
+	// owned by the device's layout cache
 	VkPipelineLayout pipelineLayout{};
 	int32_t frameIndex{0};
 };
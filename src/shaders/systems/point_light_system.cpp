@@ -13,6 +13,9 @@
 // std
 
 #include <stdexcept>
+#include <utility>
+
+#include "layout_cache.h"
 
 namespace lvr {
 
@@ -22,39 +25,26 @@ struct PointLightPushConstants {
 	float radius;
 };
 
-PointLightSystem::PointLightSystem(
-	Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-	: lvrDevice(device) {
-	createPipelineLayout(globalSetLayout);
-	createPipeline(renderPass);
-}
-
-PointLightSystem::~PointLightSystem() {
-	vkDestroyPipelineLayout(lvrDevice.device(), pipelineLayout, nullptr);
+PointLightSystem::PointLightSystem(Device &device, VkRenderPass renderPass) : lvrDevice(device) {
+	auto shaders = Shader::Create(
+		lvrDevice,
+		std::vector<std::string>{"shaders/point_light.vert", "shaders/point_light.frag"});
+	createPipelineLayout(shaders);
+	createPipeline(renderPass, std::move(shaders));
 }
 
-void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-	VkPushConstantRange pushConstantRange{};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(PointLightPushConstants);
-
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
-
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-	pipelineLayoutInfo.pushConstantRangeCount = 1;
-	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-	if (vkCreatePipelineLayout(lvrDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
-		VK_SUCCESS) {
-		throw std::runtime_error("Failed to create pipeline layout");
-	}
+void PointLightSystem::createPipelineLayout(const std::vector<std::unique_ptr<Shader>> &shaders) {
+	// set 0 is the global set, the same layout the application allocates it with
+	ShaderLayout layout{shaders};
+	assert(
+		layout.getPushConstantRange().size == sizeof(PointLightPushConstants) &&
+		"PointLightPushConstants doesn't match the shaders' push constants");
+	pipelineLayout = lvrDevice.layoutCache().getPipelineLayout(layout);
+	pushConstantStages = layout.getPushConstantRange().stageFlags;
 }
 
-void PointLightSystem::createPipeline(VkRenderPass renderPass) {
+void PointLightSystem::createPipeline(
+	VkRenderPass renderPass, std::vector<std::unique_ptr<Shader>> shaders) {
 	assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
 	PipelineConfigInfo pipelineConfig{};
@@ -64,26 +54,26 @@ void PointLightSystem::createPipeline(VkRenderPass renderPass) {
 	// pipelineConfig.bindingDescriptions.clear();
 	pipelineConfig.renderPass = renderPass;
 	pipelineConfig.pipelineLayout = pipelineLayout;
-	lvrPipeline = std::make_unique<Pipeline>(
-		lvrDevice,
-		std::vector<std::string>{"shaders/point_light.vert", "shaders/point_light.frag"},
-		pipelineConfig);
+	lvrPipeline = std::make_unique<Pipeline>(lvrDevice, std::move(shaders), pipelineConfig);
 }
 
 void PointLightSystem::update(FrameInfo &frameInfo, GlobalUbo &ubo) {
 	auto rotateLight = glm::rotate(glm::mat4(1.0f), frameInfo.frameTime, {0.0f, -1.0f, 0.0f});
-	int32_t lightIndex = 0;
-	for (auto &kv : frameInfo.gameObjects) {
-		auto &obj = kv.second;
-		if (obj.pointLight == nullptr) continue;
+	auto &gameObjects = frameInfo.gameObjectManager;
+	auto &pointLights = gameObjects.pointLights();
+	auto colors = gameObjects.colors();
+	assert(pointLights.size() <= MAX_LIGHTS && "Point lights exceed maximum specified");
 
-		assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified");
+	int32_t lightIndex = 0;
+	for (size_t i = 0; i < pointLights.size(); i++) {
+		uint32_t index = gameObjects.indexOf(pointLights.ids()[i]);
+		glm::vec3 &translation = gameObjects.translationAt(index);
+		const glm::vec4 &color = colors[index];
 
-		obj.transform.translation =
-			glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.0f));
-		ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.0f);
+		translation = glm::vec3(rotateLight * glm::vec4(translation, 1.0f));
+		ubo.pointLights[lightIndex].position = glm::vec4(translation, 1.0f);
 		ubo.pointLights[lightIndex].color =
-			glm::vec4(obj.color.x, obj.color.y, obj.color.z, obj.pointLight->lightIntensity);
+			glm::vec4(color.x, color.y, color.z, pointLights.values()[i].lightIntensity);
 
 		lightIndex++;
 	}
@@ -92,15 +82,19 @@ void PointLightSystem::update(FrameInfo &frameInfo, GlobalUbo &ubo) {
 }
 
 void PointLightSystem::render(FrameInfo &frameInfo) {
-	std::map<float, GameObject::id_t> sorted;
-	for (auto &kv : frameInfo.gameObjects) {
-		auto &obj = kv.second;
-		if (obj.pointLight == nullptr) continue;
+	auto &gameObjects = frameInfo.gameObjectManager;
+	auto &pointLights = gameObjects.pointLights();
+	auto translations = gameObjects.translations();
+
+	// dense slot in pointLights by distance
+	std::map<float, size_t> sorted;
+	for (size_t i = 0; i < pointLights.size(); i++) {
+		uint32_t index = gameObjects.indexOf(pointLights.ids()[i]);
 
 		// calc dist
-		auto offset = frameInfo.camera.getCameraPosition() - obj.transform.translation;
+		auto offset = frameInfo.camera.getCameraPosition() - translations[index];
 		float distSquared = glm::dot(offset, offset);
-		sorted[distSquared] = obj.getId();
+		sorted[distSquared] = i;
 	}
 	lvrPipeline->bind(frameInfo.commandBuffer);
 
@@ -115,18 +109,19 @@ void PointLightSystem::render(FrameInfo &frameInfo) {
 		nullptr);
 
 	for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
-		auto &obj = frameInfo.gameObjects.at(it->second);
+		uint32_t index = gameObjects.indexOf(pointLights.ids()[it->second]);
+		const glm::vec4 &color = gameObjects.colors()[index];
+		float intensity = pointLights.values()[it->second].lightIntensity;
 
 		PointLightPushConstants push{};
-		push.position = glm::vec4(obj.transform.translation, 1.0f);
-		push.color =
-			glm::vec4(obj.color.x, obj.color.y, obj.color.z, obj.pointLight->lightIntensity);
-		push.radius = obj.transform.scale.x;
+		push.position = glm::vec4(translations[index], 1.0f);
+		push.color = glm::vec4(color.x, color.y, color.z, intensity);
+		push.radius = gameObjects.scales()[index].x;
 
 		vkCmdPushConstants(
 			frameInfo.commandBuffer,
 			pipelineLayout,
-			VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT,
+			pushConstantStages,
 			0,
 			sizeof(PointLightPushConstants),
 			&push);
@@ -19,9 +19,7 @@ namespace lvr {
 
 class PointLightSystem {
    public:
-	PointLightSystem(
-		Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
-	~PointLightSystem();
+	PointLightSystem(Device &device, VkRenderPass renderPass);
 
 	PointLightSystem(const PointLightSystem &) = delete;
 	PointLightSystem &operator=(const PointLightSystem &) = delete;
@@ -31,13 +29,16 @@ class PointLightSystem {
 	void render(FrameInfo &frameinfo);
 
    private:
-	void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-	void createPipeline(VkRenderPass renderPass);
+	void createPipelineLayout(const std::vector<std::unique_ptr<Shader>> &shaders);
+	void createPipeline(VkRenderPass renderPass, std::vector<std::unique_ptr<Shader>> shaders);
 
 	Device &lvrDevice;
 
 	std::unique_ptr<Pipeline> lvrPipeline;
+	// owned by the device's layout cache
 	VkPipelineLayout pipelineLayout{};
+	// the stages that declare the push block, pushes have to name exactly the layout's range
+	VkShaderStageFlags pushConstantStages = 0;
 };
 
 }  // namespace lvr
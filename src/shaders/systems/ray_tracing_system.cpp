@@ -1,21 +1,22 @@
 #include "ray_tracing_system.h"
 
 #include <random>
+#include <utility>
+
+#include "layout_cache.h"
+
 namespace lvr {
 RayTracingSystem::RayTracingSystem(Device& device, VkRenderPass renderPass, VkExtent3D extent)
 	: device(device), extent(extent) {
-	createPipelineLayout();
-	createPipeline(renderPass);
+	auto shaders = Shader::Create(
+		device,
+		std::vector<std::string>{"shaders/raytracing.frag", "shaders/raytracing.vert"});
+	createPipelineLayout(shaders);
+	createPipeline(renderPass, std::move(shaders));
 	computeShader = std::make_unique<ComputeShader>(
 		device,
 		renderPass,
-		std::vector<std::string>{"shaders/raytracing.comp"},
-		DescriptorSetLayout::Builder(device)
-			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
-			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
-			.build());
+		std::vector<std::string>{"shaders/raytracing.comp"});
 
 	createSpheres();
 	createUniformBuffers();
@@ -23,10 +24,6 @@ RayTracingSystem::RayTracingSystem(Device& device, VkRenderPass renderPass, VkEx
 	createImage();
 }
 
-RayTracingSystem::~RayTracingSystem() {
-	vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
-}
-
 void RayTracingSystem::dispatchCompute(FrameInfo& frameInfo, VkCommandBuffer computeCommandBuffer) {
 	for (auto image : images) {
 		image->transitionLayout(
@@ -43,7 +40,7 @@ void RayTracingSystem::dispatchCompute(FrameInfo& frameInfo, VkCommandBuffer com
 	auto imageInfo = images[frameInfo.frameIndex]->getImageInfo();
 	auto bufferInfoCurrentFrame = spheresBuffers[frameInfo.frameIndex]->descriptorInfo();
 
-	DescriptorWriter(*computeShader->getComputeShaderLayout(), frameInfo.frameDescriptorPool)
+	DescriptorWriter(computeShader->getComputeShaderLayout(), frameInfo.frameDescriptorPool)
 		.writeBuffer(0, &bufferInfoubo)
 		.writeBuffer(1, &bufferInfoCurrentFrame)
 		.writeImage(2, &imageInfoLastFrame)
@@ -61,14 +58,20 @@ void RayTracingSystem::dispatchCompute(FrameInfo& frameInfo, VkCommandBuffer com
 			VK_IMAGE_LAYOUT_GENERAL,
 			false);
 	}
+	dispatchCount++;
 }
 
 void RayTracingSystem::renderRays(FrameInfo& frameInfo) {
+	if (dispatchCount < 2) return;
+
 	pipeline->bind(frameInfo.commandBuffer);
 
 	VkDescriptorSet raytracingDescriptorSet;
 
-	auto imageInfo = images[frameInfo.frameIndex]->getImageInfo();
+	// the dispatch of this frame may still be running on the compute queue, show the last one
+	int32_t lastFrameIndex = (frameInfo.frameIndex + SwapChain::MAX_FRAMES_IN_FLIGHT - 1) %
+							 SwapChain::MAX_FRAMES_IN_FLIGHT;
+	auto imageInfo = images[lastFrameIndex]->getImageInfo();
 
 	DescriptorWriter(*raytracingSystemLayout, frameInfo.frameDescriptorPool)
 		.writeImage(0, &imageInfo)
@@ -97,27 +100,14 @@ void RayTracingSystem::updateUniformBuffers(FrameInfo& frameInfo, int32_t frameI
 	uniformBuffers[frameInfo.frameIndex]->writeToBuffer(&ubo);
 }
 
-void RayTracingSystem::createPipelineLayout() {
-	raytracingSystemLayout =
-		DescriptorSetLayout::Builder(device)
-			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.build();
-
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
-		raytracingSystemLayout->getDescriptorSetLayout()};
-
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-
-	if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
-		VK_SUCCESS) {
-		throw std::runtime_error("Failed to create pipeline layout");
-	}
+void RayTracingSystem::createPipelineLayout(const std::vector<std::unique_ptr<Shader>>& shaders) {
+	ShaderLayout layout{shaders};
+	raytracingSystemLayout = &device.layoutCache().getSetLayout(layout, 0);
+	pipelineLayout = device.layoutCache().getPipelineLayout(layout);
 }
 
-void RayTracingSystem::createPipeline(VkRenderPass renderPass) {
+void RayTracingSystem::createPipeline(
+	VkRenderPass renderPass, std::vector<std::unique_ptr<Shader>> shaders) {
 	assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 	PipelineConfigInfo pipelineConfig{};
 	Pipeline::defaultPipelineConfigInfo(pipelineConfig, device.getMsaaSamples());
@@ -126,10 +116,7 @@ void RayTracingSystem::createPipeline(VkRenderPass renderPass) {
 	Pipeline::enableAlphaBlending(pipelineConfig);
 	pipelineConfig.renderPass = renderPass;
 	pipelineConfig.pipelineLayout = pipelineLayout;
-	pipeline = std::make_unique<Pipeline>(
-		device,
-		std::vector<std::string>{"shaders/raytracing.frag", "shaders/raytracing.vert"},
-		pipelineConfig);
+	pipeline = std::make_unique<Pipeline>(device, std::move(shaders), pipelineConfig);
 }
 
 void RayTracingSystem::createUniformBuffers() {
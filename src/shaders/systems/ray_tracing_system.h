@@ -31,7 +31,6 @@ class RayTracingSystem {
 
    public:
 	RayTracingSystem(Device &device, VkRenderPass renderPass, VkExtent3D extent);
-	~RayTracingSystem();
 
 	void dispatchCompute(FrameInfo &frameInfo, VkCommandBuffer computeCommandBuffer);
 	void renderRays(FrameInfo &frameInfo);
@@ -45,8 +44,8 @@ class RayTracingSystem {
    private:
 	Device &device;
 
-	void createPipelineLayout();
-	void createPipeline(VkRenderPass renderPass);
+	void createPipelineLayout(const std::vector<std::unique_ptr<Shader>> &shaders);
+	void createPipeline(VkRenderPass renderPass, std::vector<std::unique_ptr<Shader>> shaders);
 	void createUniformBuffers();
 	void createSpheres();
 	void createImage();
@@ -57,12 +56,15 @@ class RayTracingSystem {
 	std::vector<Sphere> spheres;
 
 	std::vector<std::shared_ptr<Texture>> images;
-	std::unique_ptr<DescriptorSetLayout> raytracingSystemLayout{};
+	// layouts are owned by the device's layout cache
+	DescriptorSetLayout *raytracingSystemLayout = nullptr;
 
 	std::unique_ptr<Pipeline> pipeline;
 	VkPipelineLayout pipelineLayout{};
 
 	VkExtent3D extent;
+	// renderRays shows the previous dispatch, nothing to show before the second one
+	uint32_t dispatchCount{0};
 };
 
 }  // namespace lvr
\ No newline at end of file
@@ -3,134 +3,735 @@
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
+#include <array>
 #include <glm/gtc/constants.hpp>
 #include <iostream>
+#include <limits>
 #include <vector>
 
+#include "mesh_pool.h"
+
 // std
 
 #include <stdexcept>
+#include <utility>
+
+#include "layout_cache.h"
+#include "textures/texture_cache.h"
 
 namespace lvr {
 
-struct SimplePushConstantData {
-	glm::mat4 modelMatrix{1.0f};
-	glm::mat4 normalMatrix{1.0f};
+struct BindlessPushConstantData {
+	uint32_t textureIndex;
 };
 
+// Matches DrawObject in cull.comp and simple_shader_indirect.vert
+struct GpuDrawObject {
+	uint32_t objectIndex;
+	uint32_t textureIndex;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t vertexOffset;
+	uint32_t padding[3];
+	glm::vec4 boundingSphere;
+};
+
+struct CullPushConstantData {
+	glm::vec4 frustumPlanes[6];
+	uint32_t objectCount;
+};
+
+constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+// instances written per job when filling the instance buffer
+constexpr uint32_t INSTANCE_GRAIN_SIZE = 4096;
+constexpr uint32_t INVALID_INSTANCE = std::numeric_limits<uint32_t>::max();
+// instance groups recorded per secondary command buffer
+constexpr uint32_t DRAW_GRAIN_SIZE = 128;
+
+// Planes of the clip space volume with normals pointing inwards, for a [0, 1] depth range
+static void extractFrustumPlanes(const glm::mat4& projectionView, glm::vec4 (&planes)[6]) {
+	auto row = [&](int i) {
+		return glm::vec4(
+			projectionView[0][i],
+			projectionView[1][i],
+			projectionView[2][i],
+			projectionView[3][i]);
+	};
+	planes[0] = row(3) + row(0);
+	planes[1] = row(3) - row(0);
+	planes[2] = row(3) + row(1);
+	planes[3] = row(3) - row(1);
+	planes[4] = row(2);
+	planes[5] = row(3) - row(2);
+	for (auto& plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
 SimpleRenderSystem::SimpleRenderSystem(
-	Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-	: lvrDevice(device) {
-	createPipelineLayout(globalSetLayout);
-	createPipeline(renderPass);
+	Device& device, VkRenderPass renderPass, const GameObjectManager& gameObjectManager)
+	: lvrDevice(device),
+	  descriptorCache(device),
+	  bindless(device.supportsBindless()),
+	  gpuDriven(device.supportsGpuDriven()) {
+	// the cull shader is loaded with the draw shaders, so they compile in parallel
+	std::vector<std::string> shaderPaths = getShaderPaths();
+	if (gpuDriven) shaderPaths.push_back("shaders/cull.comp");
+	auto shaders = Shader::Create(lvrDevice, shaderPaths);
+	std::vector<std::unique_ptr<Shader>> cullShaders{};
+	if (gpuDriven) {
+		cullShaders.push_back(std::move(shaders.back()));
+		shaders.pop_back();
+	}
+
+	createPipelineLayouts(shaders, cullShaders);
+	for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+		createFrameBuffers(i, gameObjectManager.getCapacity(i));
+	}
+	if (bindless) createBindlessDescriptorSets(gameObjectManager);
+	if (gpuDriven) createCullPipeline(std::move(cullShaders));
+	createPipeline(renderPass, std::move(shaders));
 }
 
-SimpleRenderSystem::~SimpleRenderSystem() {
-	vkDestroyPipelineLayout(lvrDevice.device(), pipelineLayout, nullptr);
+std::vector<std::string> SimpleRenderSystem::getShaderPaths() const {
+	if (gpuDriven) {
+		return {"shaders/simple_shader_indirect.vert", "shaders/simple_shader_indirect.frag"};
+	}
+	if (bindless) {
+		return {"shaders/simple_shader_bindless.vert", "shaders/simple_shader_bindless.frag"};
+	}
+	return {"shaders/simple_shader.vert", "shaders/simple_shader.frag"};
 }
 
-void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-	VkPushConstantRange pushConstantRange{};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(SimplePushConstantData);
+void SimpleRenderSystem::createPipelineLayouts(
+	const std::vector<std::unique_ptr<Shader>>& shaders,
+	const std::vector<std::unique_ptr<Shader>>& cullShaders) {
+	auto& layoutCache = lvrDevice.layoutCache();
+	ShaderLayout layout{shaders};
+	if (!bindless) {
+		// transforms come in as instance attributes, set 1 only holds the group's texture
+		renderSystemLayout = &layoutCache.getSetLayout(layout, 1);
+		pipelineLayout = layoutCache.getPipelineLayout(layout);
+		pushConstantStages = layout.getPushConstantRange().stageFlags;
+		return;
+	}
 
-	renderSystemLayout =
-		DescriptorSetLayout::Builder(lvrDevice)
-			.addBinding(
-				0,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
-			.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.build();
+	maxBindlessTextures = std::min(
+		MAX_BINDLESS_TEXTURES,
+		lvrDevice.properties.limits.maxPerStageDescriptorSampledImages);
+	// new textures are written while earlier frames using the array are still in flight
+	layout.setBindingCount(2, 0, maxBindlessTextures)
+		.setBindingFlags(
+			2,
+			0,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+				VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+				VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT);
+	assert(
+		(gpuDriven || layout.getPushConstantRange().size == sizeof(BindlessPushConstantData)) &&
+		"BindlessPushConstantData doesn't match the shaders' push constants");
+
+	if (gpuDriven) {
+		// the cull pass reads the object set as its set 0 and adds its draw buffers to it, the
+		// same set is bound to both pipelines so both need the merged layout
+		ShaderLayout cullLayout{cullShaders};
+		layout.mergeSet(1, cullLayout, 0);
+		cullLayout.mergeSet(0, layout, 1);
+		assert(
+			cullLayout.getPushConstantRange().size == sizeof(CullPushConstantData) &&
+			"CullPushConstantData doesn't match the shaders' push constants");
+		cullPipelineLayout = layoutCache.getPipelineLayout(cullLayout);
+		cullPushConstantStages = cullLayout.getPushConstantRange().stageFlags;
+	}
+	objectSetLayout = &layoutCache.getSetLayout(layout, 1);
+	textureSetLayout = &layoutCache.getSetLayout(layout, 2);
+	pipelineLayout = layoutCache.getPipelineLayout(layout);
+	pushConstantStages = layout.getPushConstantRange().stageFlags;
+}
+
+void SimpleRenderSystem::createBindlessDescriptorSets(const GameObjectManager& gameObjectManager) {
+	uint32_t buffersPerSet = gpuDriven ? 4 : 2;
+	bindlessPool = DescriptorPool::Builder(lvrDevice)
+					   .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT + 1)
+					   .addPoolSize(
+						   VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+						   SwapChain::MAX_FRAMES_IN_FLIGHT * buffersPerSet)
+					   .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxBindlessTextures)
+					   .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT)
+					   .build();
+
+	objectDescriptorSets.resize(SwapChain::MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+	for (int i = 0; i < objectDescriptorSets.size(); i++) {
+		writeObjectDescriptorSet(i, gameObjectManager);
+	}
+
+	if (!bindlessPool->allocateDescriptor(
+			textureSetLayout->getDescriptorSetLayout(),
+			textureDescriptorSet)) {
+		throw std::runtime_error("failed to allocate bindless texture descriptor set!");
+	}
+}
+
+uint32_t SimpleRenderSystem::getTextureIndex(const std::shared_ptr<Texture>& texture) {
+	TextureCache& textureCache = lvrDevice.textureCache();
+	textureCache.touch(*texture);
+	uint64_t frame = textureCache.getFrame();
+
+	uint32_t users = 0;
+	auto it = textureIndices.find(texture.get());
+	if (it != textureIndices.end()) {
+		if (it->second.generation == texture->getGeneration()) {
+			it->second.lastUsedFrame = frame;
+			return it->second.index;
+		}
+		// frames in flight may still read the old image through the old slot
+		users = it->second.users;
+		freeTextureSlots.push_back({it->second.index, it->second.lastUsedFrame});
+		bindlessTextures[it->second.index].reset();
+		textureIndices.erase(it);
+	}
+
+	auto freeSlot = std::find_if(
+		freeTextureSlots.begin(),
+		freeTextureSlots.end(),
+		[frame](const FreeTextureSlot& slot) {
+			return frame - slot.lastUsedFrame > SwapChain::MAX_FRAMES_IN_FLIGHT;
+		});
+	uint32_t index;
+	if (freeSlot != freeTextureSlots.end()) {
+		index = freeSlot->index;
+		freeTextureSlots.erase(freeSlot);
+		bindlessTextures[index] = texture;
+	} else {
+		if (bindlessTextures.size() == maxBindlessTextures) {
+			throw std::runtime_error("bindless texture array is full!");
+		}
+		index = static_cast<uint32_t>(bindlessTextures.size());
+		bindlessTextures.push_back(texture);
+	}
+	textureIndices.emplace(
+		texture.get(),
+		TextureSlot{index, texture->getGeneration(), frame, users});
+
+	auto imageInfo = texture->getImageInfo();
+	DescriptorWriter(*textureSetLayout, *bindlessPool)
+		.writeImageArrayElement(0, index, &imageInfo)
+		.overwrite(textureDescriptorSet);
+	return index;
+}
 
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
-		globalSetLayout,
-		renderSystemLayout->getDescriptorSetLayout()};
+uint32_t SimpleRenderSystem::acquireTextureSlot(const std::shared_ptr<Texture>& texture) {
+	uint32_t index = getTextureIndex(texture);
+	textureIndices.at(texture.get()).users++;
+	return index;
+}
 
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-	pipelineLayoutInfo.pushConstantRangeCount = 1;
-	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+void SimpleRenderSystem::releaseTextureSlot(const Texture* texture) {
+	textureIndices.at(texture).users--;
+}
+
+void SimpleRenderSystem::releaseUnusedTextureSlots() {
+	TextureCache& textureCache = lvrDevice.textureCache();
+	uint64_t frame = textureCache.getFrame();
+	for (auto it = textureIndices.begin(); it != textureIndices.end();) {
+		TextureSlot& slot = it->second;
+		if (slot.users > 0) {
+			// records are only rewritten when their object changes, their textures are drawn
+			// every frame all the same
+			Texture& texture = *bindlessTextures[slot.index];
+			textureCache.touch(texture);
+			slot.lastUsedFrame = frame;
+			if (slot.generation != texture.getGeneration()) {
+				staleDrawObjectFrames = (1u << SwapChain::MAX_FRAMES_IN_FLIGHT) - 1;
+			}
+			++it;
+			continue;
+		}
+		if (frame - slot.lastUsedFrame <= SwapChain::MAX_FRAMES_IN_FLIGHT) {
+			++it;
+			continue;
+		}
+		// the texture cache can evict it once nothing else holds it
+		freeTextureSlots.push_back({slot.index, slot.lastUsedFrame});
+		bindlessTextures[slot.index].reset();
+		it = textureIndices.erase(it);
+	}
+}
+
+void SimpleRenderSystem::writeObjectDescriptorSet(
+	int frameIndex, const GameObjectManager& gameObjectManager) {
+	auto bufferInfo = gameObjectManager.getObjectBufferInfo(frameIndex);
+	DescriptorWriter writer(*objectSetLayout, *bindlessPool);
+	writer.writeBuffer(0, &bufferInfo);
+
+	VkDescriptorBufferInfo drawObjectInfo{};
+	VkDescriptorBufferInfo indirectInfo{};
+	VkDescriptorBufferInfo countInfo{};
+	VkDescriptorBufferInfo instanceInfo{};
+	if (gpuDriven) {
+		drawObjectInfo = drawObjectBuffers[frameIndex]->descriptorInfo();
+		indirectInfo = indirectBuffers[frameIndex]->descriptorInfo();
+		countInfo = countBuffers[frameIndex]->descriptorInfo();
+		writer.writeBuffer(1, &drawObjectInfo)
+			.writeBuffer(2, &indirectInfo)
+			.writeBuffer(3, &countInfo);
+	} else {
+		instanceInfo = instanceBuffers[frameIndex]->descriptorInfo();
+		writer.writeBuffer(1, &instanceInfo);
+	}
 
-	if (vkCreatePipelineLayout(lvrDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
-		VK_SUCCESS) {
-		throw std::runtime_error("Failed to create pipeline layout");
+	if (objectDescriptorSets[frameIndex] != VK_NULL_HANDLE) {
+		writer.overwrite(objectDescriptorSets[frameIndex]);
+	} else if (!writer.build(objectDescriptorSets[frameIndex])) {
+		throw std::runtime_error("failed to allocate object descriptor set!");
 	}
+	objectBufferVersions[frameIndex] = gameObjectManager.getObjectBufferVersion(frameIndex);
 }
 
-void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+void SimpleRenderSystem::createFrameBuffers(int frameIndex, uint32_t capacity) {
+	frameCapacities[frameIndex] = capacity;
+
+	if (!gpuDriven) {
+		// a new buffer holds nothing yet
+		writtenInstanceOrders[frameIndex].clear();
+		instanceBuffers[frameIndex] = std::make_unique<Buffer>(
+			lvrDevice,
+			bindless ? sizeof(uint32_t) : sizeof(GameObjectBufferData),
+			capacity,
+			bindless ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		instanceBuffers[frameIndex]->map();
+		return;
+	}
+
+	drawObjectBuffers[frameIndex] = std::make_unique<Buffer>(
+		lvrDevice,
+		sizeof(GpuDrawObject),
+		capacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	drawObjectBuffers[frameIndex]->map();
+	// a new buffer holds nothing yet
+	staleDrawObjectFrames |= 1u << frameIndex;
+
+	indirectBuffers[frameIndex] = std::make_unique<Buffer>(
+		lvrDevice,
+		sizeof(VkDrawIndexedIndirectCommand),
+		capacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (countBuffers[frameIndex] == nullptr) {
+		countBuffers[frameIndex] = std::make_unique<Buffer>(
+			lvrDevice,
+			sizeof(uint32_t),
+			1,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+}
+
+void SimpleRenderSystem::prepareFrame(FrameInfo& frameInfo) {
+	auto& gameObjects = frameInfo.gameObjectManager;
+	int frameIndex = frameInfo.frameIndex;
+
+	// the frame's previous submission has finished, its buffers and set are free to change
+	bool grown = gameObjects.size() > frameCapacities[frameIndex];
+	if (grown) {
+		uint32_t capacity = std::max(frameCapacities[frameIndex], 1u);
+		while (capacity < gameObjects.size()) capacity *= 2;
+		createFrameBuffers(frameIndex, capacity);
+	}
+	if (bindless) releaseUnusedTextureSlots();
+	if (bindless &&
+		(grown ||
+		 objectBufferVersions[frameIndex] != gameObjects.getObjectBufferVersion(frameIndex))) {
+		writeObjectDescriptorSet(frameIndex, gameObjects);
+	}
+}
+
+void SimpleRenderSystem::createCullPipeline(std::vector<std::unique_ptr<Shader>> shaders) {
+	PipelineConfigInfo pipelineConfig{};
+	pipelineConfig.pipelineLayout = cullPipelineLayout;
+	cullPipeline = std::make_unique<Pipeline>(lvrDevice, std::move(shaders), pipelineConfig);
+}
+
+void SimpleRenderSystem::createPipeline(
+	VkRenderPass renderPass, std::vector<std::unique_ptr<Shader>> shaders) {
 	assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
 	PipelineConfigInfo pipelineConfig{};
 	Pipeline::defaultPipelineConfigInfo(pipelineConfig, lvrDevice.getMsaaSamples());
 	pipelineConfig.bindingDescriptions = Model::Vertex::getBindingDescriptions();
 	pipelineConfig.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+	if (!bindless) {
+		// model and normal matrix per instance, one vec4 column per location
+		pipelineConfig.bindingDescriptions.push_back(
+			{1, sizeof(GameObjectBufferData), VK_VERTEX_INPUT_RATE_INSTANCE});
+		uint32_t location = static_cast<uint32_t>(pipelineConfig.attributeDescriptions.size());
+		for (uint32_t column = 0; column < 8; column++) {
+			pipelineConfig.attributeDescriptions.push_back(
+				{location + column,
+				 1,
+				 VK_FORMAT_R32G32B32A32_SFLOAT,
+				 static_cast<uint32_t>(column * sizeof(glm::vec4))});
+		}
+	}
 	pipelineConfig.renderPass = renderPass;
 	pipelineConfig.pipelineLayout = pipelineLayout;
-	lvrPipeline = std::make_unique<Pipeline>(
-		lvrDevice,
-		std::vector<std::string>{
-			"shaders/simple_shader.vert",
-			"shaders/simple_shader.frag",
-		},
-		pipelineConfig);
+	lvrPipeline = std::make_unique<Pipeline>(lvrDevice, std::move(shaders), pipelineConfig);
 }
 
-void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
-	lvrPipeline->bind(frameInfo.commandBuffer);
-	auto projectionView = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+void SimpleRenderSystem::cullGameObjects(FrameInfo& frameInfo) {
+	if (!gpuDriven) return;
+	prepareFrame(frameInfo);
+
+	// one record per object at its dense index, the transforms stay in the object buffer. A record
+	// only changes with the object's model or texture, so only those of objects that changed since
+	// the frame's buffer was last written are rewritten.
+	int frameIndex = frameInfo.frameIndex;
+	auto& gameObjects = frameInfo.gameObjectManager;
+	auto* drawObjects =
+		static_cast<GpuDrawObject*>(drawObjectBuffers[frameIndex]->getMappedMemory());
+	auto models = gameObjects.models();
+	auto diffuseMaps = gameObjects.diffuseMaps();
+	auto& textures = drawObjectTextures[frameIndex];
+	uint32_t objectCount = gameObjects.size();
+
+	// records past the object count belonged to destroyed objects
+	for (uint32_t i = objectCount; i < textures.size(); i++) {
+		if (textures[i] != nullptr) releaseTextureSlot(textures[i]);
+	}
+	textures.resize(objectCount, nullptr);
+
+	auto writeDrawObjects = [&](uint32_t first, uint32_t count) {
+		for (uint32_t i = first; i < first + count; i++) {
+			if (textures[i] != nullptr) releaseTextureSlot(textures[i]);
+			textures[i] = nullptr;
 
+			// objects without a model keep an empty record the cull pass skips
+			GpuDrawObject& draw = drawObjects[i];
+			draw = GpuDrawObject{};
+			draw.objectIndex = i;
+			const auto& model = models[i];
+			if (model == nullptr) continue;
+
+			draw.textureIndex = acquireTextureSlot(diffuseMaps[i]);
+			textures[i] = diffuseMaps[i].get();
+			draw.firstIndex = model->getFirstIndex();
+			draw.indexCount = model->getIndexCount();
+			draw.vertexOffset = model->getVertexOffset();
+			draw.boundingSphere = model->getBoundingSphere();
+		}
+	};
+	if (staleDrawObjectFrames & (1u << frameIndex)) {
+		staleDrawObjectFrames &= ~(1u << frameIndex);
+		// consumes the frame's dirty bits, everything is written anyway
+		gameObjects.forEachFrameDrawDirtyRange(
+			frameIndex,
+			0,
+			objectCount,
+			[](uint32_t, uint32_t) {});
+		writeDrawObjects(0, objectCount);
+	} else {
+		gameObjects.forEachFrameDrawDirtyRange(frameIndex, 0, objectCount, writeDrawObjects);
+	}
+	drawObjectCount = objectCount;
+
+	// every visible object is one draw of a single indirect call
+	drawStatistics.objectCount = drawObjectCount;
+	drawStatistics.drawCount = drawObjectCount > 0 ? 1 : 0;
+	drawStatistics.drawsSaved = drawObjectCount - drawStatistics.drawCount;
+
+	VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+	VkBuffer countBuffer = countBuffers[frameInfo.frameIndex]->getBuffer();
+	vkCmdFillBuffer(commandBuffer, countBuffer, 0, sizeof(uint32_t), 0);
+
+	VkMemoryBarrier clearBarrier{};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1,
+		&clearBarrier,
+		0,
+		nullptr,
+		0,
+		nullptr);
+
+	CullPushConstantData push{};
+	extractFrustumPlanes(
+		frameInfo.camera.getProjection() * frameInfo.camera.getView(),
+		push.frustumPlanes);
+	push.objectCount = drawObjectCount;
+
+	cullPipeline->bindCompute(commandBuffer);
 	vkCmdBindDescriptorSets(
-		frameInfo.commandBuffer,
-		VK_PIPELINE_BIND_POINT_GRAPHICS,
-		pipelineLayout,
+		commandBuffer,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		cullPipelineLayout,
 		0,
 		1,
-		&frameInfo.globalDescriptorSet,
+		&objectDescriptorSets[frameInfo.frameIndex],
 		0,
 		nullptr);
+	vkCmdPushConstants(
+		commandBuffer,
+		cullPipelineLayout,
+		cullPushConstantStages,
+		0,
+		sizeof(CullPushConstantData),
+		&push);
+	vkCmdDispatch(
+		commandBuffer,
+		(drawObjectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE,
+		1,
+		1);
 
-	for (auto& kv : frameInfo.gameObjects) {
-		auto& obj = kv.second;
-		if (obj.model == nullptr) continue;
+	VkMemoryBarrier cullBarrier{};
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		0,
+		1,
+		&cullBarrier,
+		0,
+		nullptr,
+		0,
+		nullptr);
+}
 
-		auto bufferInfo = obj.getBufferInfo(frameInfo.frameIndex);
-		auto imageInfo = obj.diffuseMap->getImageInfo();
-		VkDescriptorSet gameObjectDescriptorSet;
-		DescriptorWriter(*renderSystemLayout, frameInfo.frameDescriptorPool)
-			.writeBuffer(0, &bufferInfo)
-			.writeImage(1, &imageInfo)
-			.build(gameObjectDescriptorSet);
+void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
+	auto& secondaryCommandBuffers = frameInfo.secondaryCommandBuffers;
+	auto& jobSystem = frameInfo.jobSystem;
+
+	if (gpuDriven) {
+		// a single indirect draw, nothing to split
+		if (drawObjectCount == 0) return;
+		VkCommandBuffer commandBuffer = secondaryCommandBuffers.begin(jobSystem.getThreadIndex());
+		bindDrawState(frameInfo, commandBuffer);
+		vkCmdDrawIndexedIndirectCount(
+			commandBuffer,
+			indirectBuffers[frameInfo.frameIndex]->getBuffer(),
+			0,
+			countBuffers[frameInfo.frameIndex]->getBuffer(),
+			0,
+			drawObjectCount,
+			sizeof(VkDrawIndexedIndirectCommand));
+		secondaryCommandBuffers.end(commandBuffer);
+		secondaryCommandBuffers.add(commandBuffer);
+		return;
+	}
+
+	if (!bindless) descriptorCache.nextFrame();
+	buildInstanceGroups(frameInfo);
+	resolveGroupTextures(frameInfo);
+
+	// every job records its groups into a secondary command buffer of its own thread, they are
+	// queued in group order so the result matches recording on one thread
+	uint32_t groupCount = static_cast<uint32_t>(instanceGroups.size());
+	groupCommandBuffers.assign((groupCount + DRAW_GRAIN_SIZE - 1) / DRAW_GRAIN_SIZE, VK_NULL_HANDLE);
+	jobSystem.parallelFor(groupCount, DRAW_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+		VkCommandBuffer commandBuffer = secondaryCommandBuffers.begin(jobSystem.getThreadIndex());
+		bindDrawState(frameInfo, commandBuffer);
+		drawInstanceGroups(frameInfo, commandBuffer, begin, end);
+		secondaryCommandBuffers.end(commandBuffer);
+		groupCommandBuffers[begin / DRAW_GRAIN_SIZE] = commandBuffer;
+	});
+	for (VkCommandBuffer commandBuffer : groupCommandBuffers) {
+		secondaryCommandBuffers.add(commandBuffer);
+	}
+}
 
+void SimpleRenderSystem::bindDrawState(FrameInfo& frameInfo, VkCommandBuffer commandBuffer) {
+	lvrPipeline->bind(commandBuffer);
+
+	if (bindless) {
+		std::array<VkDescriptorSet, 3> descriptorSets{
+			frameInfo.globalDescriptorSet,
+			objectDescriptorSets[frameInfo.frameIndex],
+			textureDescriptorSet};
 		vkCmdBindDescriptorSets(
-			frameInfo.commandBuffer,
+			commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipelineLayout,
-			1,	// starting set (0 is the globalDescriptorSet, 1 is the set specific to this	//
-				// system)
-			1,	// set count
-			&gameObjectDescriptorSet,
+			0,
+			static_cast<uint32_t>(descriptorSets.size()),
+			descriptorSets.data(),
 			0,
 			nullptr);
-
-		SimplePushConstantData push{};
-		push.modelMatrix = obj.transform.mat4();
-		push.normalMatrix = obj.transform.normalMatrix();
-
-		vkCmdPushConstants(
-			frameInfo.commandBuffer,
+	} else {
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipelineLayout,
-			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 			0,
-			sizeof(SimplePushConstantData),
-			&push);
+			1,
+			&frameInfo.globalDescriptorSet,
+			0,
+			nullptr);
+	}
+
+	lvrDevice.meshPool().bind(commandBuffer);
+	if (!bindless) {
+		VkBuffer instanceBuffer = instanceBuffers[frameInfo.frameIndex]->getBuffer();
+		VkDeviceSize instanceOffset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, &instanceOffset);
+	}
+}
+
+void SimpleRenderSystem::resolveGroupTextures(FrameInfo& frameInfo) {
+	auto diffuseMaps = frameInfo.gameObjectManager.diffuseMaps();
+	for (auto& group : instanceGroups) {
+		if (bindless) {
+			group.textureIndex = getTextureIndex(diffuseMaps[group.object]);
+			continue;
+		}
+
+		lvrDevice.textureCache().touch(*diffuseMaps[group.object]);
+		auto imageInfo = diffuseMaps[group.object]->getImageInfo();
+		DescriptorWriter(*renderSystemLayout, descriptorCache)
+			.writeImage(1, &imageInfo)
+			.build(group.descriptorSet);
+	}
+}
+
+void SimpleRenderSystem::drawInstanceGroups(
+	FrameInfo& frameInfo, VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) {
+	auto models = frameInfo.gameObjectManager.models();
+	for (uint32_t i = begin; i < end; i++) {
+		const auto& group = instanceGroups[i];
+		if (bindless) {
+			BindlessPushConstantData push{};
+			push.textureIndex = group.textureIndex;
+			vkCmdPushConstants(
+				commandBuffer,
+				pipelineLayout,
+				pushConstantStages,
+				0,
+				sizeof(BindlessPushConstantData),
+				&push);
+		} else {
+			vkCmdBindDescriptorSets(
+				commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				1,	// starting set (0 is the globalDescriptorSet, 1 is the set specific to this
+					// system)
+				1,	// set count
+				&group.descriptorSet,
+				0,
+				nullptr);
+		}
+
+		models[group.object]->draw(commandBuffer, group.instanceCount, group.firstInstance);
+	}
+}
+
+void SimpleRenderSystem::buildInstanceGroups(FrameInfo& frameInfo) {
+	prepareFrame(frameInfo);
+	auto& gameObjects = frameInfo.gameObjectManager;
+	auto models = gameObjects.models();
+	auto diffuseMaps = gameObjects.diffuseMaps();
+
+	instancedObjects.clear();
+	for (uint32_t i = 0; i < models.size(); i++) {
+		if (models[i] == nullptr) continue;
+		instancedObjects.push_back(i);
+	}
+	std::sort(instancedObjects.begin(), instancedObjects.end(), [&](uint32_t a, uint32_t b) {
+		if (models[a] != models[b]) return models[a] < models[b];
+		return diffuseMaps[a] < diffuseMaps[b];
+	});
 
-		obj.model->bind(frameInfo.commandBuffer);
-		obj.model->draw(frameInfo.commandBuffer);
+	instanceGroups.clear();
+	for (uint32_t i = 0; i < instancedObjects.size(); i++) {
+		uint32_t object = instancedObjects[i];
+		if (instanceGroups.empty() || models[instanceGroups.back().object] != models[object] ||
+			diffuseMaps[instanceGroups.back().object] != diffuseMaps[object]) {
+			instanceGroups.push_back({object, i, 0});
+		}
+		instanceGroups.back().instanceCount++;
 	}
+
+	// the instance data is written in draw order, spread over the job system
+	if (bindless) {
+		void* instances = instanceBuffers[frameInfo.frameIndex]->getMappedMemory();
+		frameInfo.jobSystem.parallelFor(
+			static_cast<uint32_t>(instancedObjects.size()),
+			INSTANCE_GRAIN_SIZE,
+			[&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					static_cast<uint32_t*>(instances)[i] = instancedObjects[i];
+				}
+			});
+	} else {
+		writeInstanceMatrices(frameInfo);
+	}
+
+	drawStatistics.objectCount = static_cast<uint32_t>(instancedObjects.size());
+	drawStatistics.drawCount = static_cast<uint32_t>(instanceGroups.size());
+	drawStatistics.drawsSaved = drawStatistics.objectCount - drawStatistics.drawCount;
+}
+
+void SimpleRenderSystem::writeInstanceMatrices(FrameInfo& frameInfo) {
+	auto& gameObjects = frameInfo.gameObjectManager;
+	auto matrices = gameObjects.matrices();
+	int frameIndex = frameInfo.frameIndex;
+	auto* instances =
+		static_cast<GameObjectBufferData*>(instanceBuffers[frameIndex]->getMappedMemory());
+	auto& writtenOrder = writtenInstanceOrders[frameIndex];
+	auto& instanceOf = objectInstances[frameIndex];
+
+	// every instance still belongs to the same object, copy the ones that changed since
+	if (writtenOrder == instancedObjects) {
+		frameInfo.jobSystem.parallelFor(
+			gameObjects.size(),
+			INSTANCE_GRAIN_SIZE,
+			[&](uint32_t begin, uint32_t end) {
+				gameObjects.forEachFrameDirtyRange(
+					frameIndex,
+					begin,
+					end,
+					[&](uint32_t first, uint32_t count) {
+						uint32_t last = std::min<uint32_t>(first + count, instanceOf.size());
+						for (uint32_t object = first; object < last; object++) {
+							uint32_t instance = instanceOf[object];
+							if (instance != INVALID_INSTANCE) instances[instance] = matrices[object];
+						}
+					});
+			});
+		return;
+	}
+
+	writtenOrder = instancedObjects;
+	instanceOf.assign(gameObjects.size(), INVALID_INSTANCE);
+	frameInfo.jobSystem.parallelFor(
+		static_cast<uint32_t>(instancedObjects.size()),
+		INSTANCE_GRAIN_SIZE,
+		[&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				uint32_t object = instancedObjects[i];
+				instances[i] = matrices[object];
+				instanceOf[object] = i;
+			}
+		});
+	// everything was written, nothing is left dirty for this frame
+	frameInfo.jobSystem.parallelFor(
+		gameObjects.size(),
+		INSTANCE_GRAIN_SIZE,
+		[&](uint32_t begin, uint32_t end) {
+			gameObjects.forEachFrameDirtyRange(frameIndex, begin, end, [](uint32_t, uint32_t) {});
+		});
 }
 
 }  // namespace lvr
@@ -4,6 +4,7 @@
 
 #include <cstdint>
 
+#include "buffer.h"
 #include "camera.h"
 #include "device.h"
 #include "frameinfo.h"
@@ -13,31 +14,164 @@
 // std
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace lvr {
 
+// Draws every GameObject with a model. Objects sharing a model and diffuse map are drawn as one
+// instanced draw, their per instance data is written to a buffer each frame. On devices with
+// descriptor indexing the whole scene shares one set of object data and one texture array, bound
+// once per frame, and the instances are indices into the object data. Otherwise the instances are
+// the transforms, read as per instance vertex attributes, and each group binds its texture.
+// When the device also supports indirect count draws, a compute pass frustum culls the objects and
+// writes the draw commands, and the whole scene is a single vkCmdDrawIndexedIndirectCount.
 class SimpleRenderSystem {
    public:
+	static constexpr uint32_t MAX_BINDLESS_TEXTURES = 4096;
+
+	struct DrawStatistics {
+		// of the last recorded frame
+		uint32_t objectCount = 0;
+		uint32_t drawCount = 0;
+		uint32_t drawsSaved = 0;
+	};
+
 	SimpleRenderSystem(
-		Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
-	~SimpleRenderSystem();
+		Device &device, VkRenderPass renderPass, const GameObjectManager &gameObjectManager);
 
 	SimpleRenderSystem(const SimpleRenderSystem &) = delete;
 	SimpleRenderSystem &operator=(const SimpleRenderSystem &) = delete;
 
-	void renderGameObjects(FrameInfo &frameinfo);
+	// Must be recorded outside the render pass, before renderGameObjects. Only does work when
+	// isGpuDriven().
+	void cullGameObjects(FrameInfo &frameInfo);
+	// Records the draws into secondary command buffers, split over the job system's threads, and
+	// queues them on frameInfo.secondaryCommandBuffers
+	void renderGameObjects(FrameInfo &frameInfo);
+
+	DescriptorCache::Statistics getDescriptorCacheStatistics() const {
+		return descriptorCache.getStatistics();
+	}
+
+	bool isBindless() const { return bindless; }
+	bool isGpuDriven() const { return gpuDriven; }
+	DrawStatistics getDrawStatistics() const { return drawStatistics; }
 
    private:
-	void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-	void createPipeline(VkRenderPass renderPass);
+	// instancedObjects[firstInstance, firstInstance + instanceCount) share model and texture,
+	// those of `object`
+	struct InstanceGroup {
+		uint32_t object;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+		// resolved before recording, the slot in the texture array when bindless, the set
+		// otherwise
+		uint32_t textureIndex = 0;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	};
+
+	std::vector<std::string> getShaderPaths() const;
+	// Reflects the draw and cull layouts from their shaders, set 0 is the global set
+	void createPipelineLayouts(
+		const std::vector<std::unique_ptr<Shader>> &shaders,
+		const std::vector<std::unique_ptr<Shader>> &cullShaders);
+	void createBindlessDescriptorSets(const GameObjectManager &gameObjectManager);
+	// Per frame buffers sized for `capacity` objects, the instance buffer or the GPU driven ones
+	void createFrameBuffers(int frameIndex, uint32_t capacity);
+	void writeObjectDescriptorSet(int frameIndex, const GameObjectManager &gameObjectManager);
+	// Grows the frame's buffers to the object count and repoints its object set after the object
+	// buffer was reallocated
+	void prepareFrame(FrameInfo &frameInfo);
+	void createCullPipeline(std::vector<std::unique_ptr<Shader>> shaders);
+	void createPipeline(VkRenderPass renderPass, std::vector<std::unique_ptr<Shader>> shaders);
+	void bindDrawState(FrameInfo &frameInfo, VkCommandBuffer commandBuffer);
+	// Texture lookups can register textures and allocate sets, so they run before recording
+	void resolveGroupTextures(FrameInfo &frameInfo);
+	void drawInstanceGroups(
+		FrameInfo &frameInfo, VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end);
+	// Sorts the frame's objects into instance groups and writes the instance buffer
+	void buildInstanceGroups(FrameInfo &frameInfo);
+	// Copies the matrices into the frame's instance buffer, without bindless
+	void writeInstanceMatrices(FrameInfo &frameInfo);
+	// Slot of `texture` in the bindless texture array, written on first use and again in a new slot
+	// when the texture cache replaced its image
+	uint32_t getTextureIndex(const std::shared_ptr<Texture> &texture);
+	// getTextureIndex for a draw object record, the slot stays in use until it is released
+	uint32_t acquireTextureSlot(const std::shared_ptr<Texture> &texture);
+	void releaseTextureSlot(const Texture *texture);
+	// Frees the slots of textures no frame in flight drew and lets go of those textures
+	void releaseUnusedTextureSlots();
 
 	Device &lvrDevice;
 
 	std::unique_ptr<Pipeline> lvrPipeline;
+	// layouts are owned by the device's layout cache
 	VkPipelineLayout pipelineLayout{};
+	// the stages that declare the push block, pushes have to name exactly the layout's range
+	VkShaderStageFlags pushConstantStages = 0;
+
+	DescriptorSetLayout *renderSystemLayout = nullptr;
+	// per object sets only change with the object's texture or buffer slot
+	DescriptorCache descriptorCache;
+
+	bool bindless = false;
+	uint32_t maxBindlessTextures = 0;
+	// set 1 holds the frame's object buffer, set 2 the texture array
+	DescriptorSetLayout *objectSetLayout = nullptr;
+	DescriptorSetLayout *textureSetLayout = nullptr;
+	std::unique_ptr<DescriptorPool> bindlessPool{};
+	std::vector<VkDescriptorSet> objectDescriptorSets{};
+	VkDescriptorSet textureDescriptorSet = VK_NULL_HANDLE;
+	struct TextureSlot {
+		uint32_t index;
+		uint32_t generation;
+		// see TextureCache::getFrame
+		uint64_t lastUsedFrame;
+		// draw object records holding the slot, they count as drawn every frame
+		uint32_t users = 0;
+	};
+	// a slot is rewritten once the frames that last used it finished
+	struct FreeTextureSlot {
+		uint32_t index;
+		uint64_t lastUsedFrame;
+	};
+	std::unordered_map<const Texture *, TextureSlot> textureIndices{};
+	// keeps the textures of occupied slots alive, null for free ones
+	std::vector<std::shared_ptr<Texture>> bindlessTextures{};
+	std::vector<FreeTextureSlot> freeTextureSlots{};
+
+	// per frame, object indices when bindless, transforms otherwise
+	std::vector<std::unique_ptr<Buffer>> instanceBuffers{SwapChain::MAX_FRAMES_IN_FLIGHT};
+	// dense object indices, sorted by model and texture
+	std::vector<uint32_t> instancedObjects{};
+	// per frame without bindless, the draw order the matrices were last written in and each
+	// object's instance in it, while the order holds only changed objects are copied
+	std::vector<std::vector<uint32_t>> writtenInstanceOrders{SwapChain::MAX_FRAMES_IN_FLIGHT};
+	std::vector<std::vector<uint32_t>> objectInstances{SwapChain::MAX_FRAMES_IN_FLIGHT};
+	std::vector<InstanceGroup> instanceGroups{};
+	// one secondary command buffer per DRAW_GRAIN_SIZE groups, in group order
+	std::vector<VkCommandBuffer> groupCommandBuffers{};
+	DrawStatistics drawStatistics{};
 
-	std::unique_ptr<DescriptorSetLayout> renderSystemLayout{};
+	bool gpuDriven = false;
+	// objects the frame's buffers have room for, and the object buffer its set points at
+	std::vector<uint32_t> frameCapacities = std::vector<uint32_t>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+	std::vector<uint32_t> objectBufferVersions =
+		std::vector<uint32_t>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+	// per frame, the draw list written by the CPU and the commands the cull pass writes from it
+	std::vector<std::unique_ptr<Buffer>> drawObjectBuffers{SwapChain::MAX_FRAMES_IN_FLIGHT};
+	std::vector<std::unique_ptr<Buffer>> indirectBuffers{SwapChain::MAX_FRAMES_IN_FLIGHT};
+	std::vector<std::unique_ptr<Buffer>> countBuffers{SwapChain::MAX_FRAMES_IN_FLIGHT};
+	uint32_t drawObjectCount = 0;
+	// per frame, the texture each record of the draw object buffer holds a slot of
+	std::vector<std::vector<const Texture *>> drawObjectTextures{SwapChain::MAX_FRAMES_IN_FLIGHT};
+	// frames whose draw object buffer is rewritten whole, after it was reallocated or a texture
+	// moved to another slot
+	uint32_t staleDrawObjectFrames = 0;
+	std::unique_ptr<Pipeline> cullPipeline;
+	VkPipelineLayout cullPipelineLayout{};
+	VkShaderStageFlags cullPushConstantStages = 0;
 };
 
 }  // namespace lvr
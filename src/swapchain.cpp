@@ -54,8 +54,8 @@ SwapChain::~SwapChain() {
 		vkDestroyImageView(device.device(), colorImageViews[i], nullptr);
 		vkDestroyImage(device.device(), depthImages[i], nullptr);
 		vkDestroyImage(device.device(), colorImages[i], nullptr);
-		vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
-		vkFreeMemory(device.device(), colorImageMemorys[i], nullptr);
+		device.allocator().free(depthImageMemorys[i]);
+		device.allocator().free(colorImageMemorys[i]);
 	}
 
 	for (auto framebuffer : swapChainFramebuffers) {
@@ -69,6 +69,7 @@ SwapChain::~SwapChain() {
 		vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
 		vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
 		vkDestroySemaphore(device.device(), computeFinishedSemaphores[i], nullptr);
+		vkDestroySemaphore(device.device(), graphicsFinishedSemaphores[i], nullptr);
 		if (inFlightFences[i] != VK_NULL_HANDLE)
 			vkDestroyFence(device.device(), inFlightFences[i], nullptr);
 		if (computeInFlightFences[i] != VK_NULL_HANDLE)
@@ -77,10 +78,13 @@ SwapChain::~SwapChain() {
 }
 
 VkResult SwapChain::acquireNextImage(uint32_t* imageIndex) {
+	// graphics no longer waits for the compute work of its own frame, so the compute fence has to
+	// be waited on too before the frame's resources are reused
+	VkFence frameFences[] = {inFlightFences[currentFrame], computeInFlightFences[currentFrame]};
 	vkWaitForFences(
 		device.device(),
-		1,
-		&inFlightFences[currentFrame],
+		2,
+		frameFences,
 		VK_TRUE,
 		std::numeric_limits<uint64_t>::max());
 
@@ -105,22 +109,30 @@ VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore waitSemaphores[] = {
-		computeFinishedSemaphores[currentFrame],
-		imageAvailableSemaphores[currentFrame]};
-	VkPipelineStageFlags waitStages[] = {
-		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	submitInfo.waitSemaphoreCount = 2;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
+	std::vector<VkSemaphore> waitSemaphores = {imageAvailableSemaphores[currentFrame]};
+	std::vector<VkPipelineStageFlags> waitStages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+	// wait for the previous frame's compute results, this frame's dispatch keeps running
+	if (!pendingComputeFrames.empty() && pendingComputeFrames.front() != currentFrame) {
+		waitSemaphores.push_back(computeFinishedSemaphores[pendingComputeFrames.front()]);
+		waitStages.push_back(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+		pendingComputeFrames.pop_front();
+	}
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
 
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = buffers;
 
-	VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
+	// only signal the compute queue while compute is being submitted, an unwaited binary semaphore
+	// can't be signaled again
+	std::vector<VkSemaphore> signalSemaphores = {renderFinishedSemaphores[currentFrame]};
+	if (!pendingComputeFrames.empty() && !pendingGraphicsFrame.has_value()) {
+		signalSemaphores.push_back(graphicsFinishedSemaphores[currentFrame]);
+		pendingGraphicsFrame = currentFrame;
+	}
+	submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+	submitInfo.pSignalSemaphores = signalSemaphores.data();
 
 	vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
 	if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
@@ -132,7 +144,7 @@ VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
+	presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
 	VkSwapchainKHR swapChains[] = {swapChain};
 	presentInfo.swapchainCount = 1;
@@ -148,25 +160,46 @@ VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_
 }
 
 void SwapChain::submitComputeCommandBuffers(const VkCommandBuffer* buffers) {
-	if (computeInFlightFences[currentFrame] != VK_NULL_HANDLE) {
-		vkWaitForFences(
-			device.device(),
-			1,
-			&computeInFlightFences[currentFrame],
-			VK_TRUE,
-			UINT64_MAX);
-	}
-
+	// already waited on in acquireNextImage
 	vkResetFences(device.device(), 1, &computeInFlightFences[currentFrame]);
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+	std::array<VkSemaphore, 2> waitSemaphores{};
+	std::array<uint64_t, 2> waitValues{};
+	std::array<VkPipelineStageFlags, 2> waitStages{};
+	uint32_t waitCount = 0;
+	if (pendingGraphicsFrame.has_value()) {
+		waitSemaphores[waitCount] = graphicsFinishedSemaphores[*pendingGraphicsFrame];
+		waitStages[waitCount++] = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		pendingGraphicsFrame.reset();
+	}
+	// uploads and transitions the dispatch reads went out in the upload queue's batches, on the
+	// graphics queue
+	UploadQueue::Ticket uploadTicket = device.uploadQueue().getSubmittedTicket();
+	if (uploadTicket > 0) {
+		waitSemaphores[waitCount] = device.uploadQueue().getTimelineSemaphore();
+		waitValues[waitCount] = uploadTicket;
+		waitStages[waitCount++] = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	}
+
+	// the value of the binary graphics semaphore is ignored
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = waitCount;
+	timelineInfo.pWaitSemaphoreValues = waitValues.data();
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = waitCount;
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
+
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = buffers;
 
 	VkSemaphore signalSemaphores[] = {computeFinishedSemaphores[currentFrame]};
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
+	pendingComputeFrames.push_back(currentFrame);
 
 	if (vkQueueSubmit(device.computeQueue(), 1, &submitInfo, computeInFlightFences[currentFrame]) !=
 		VK_SUCCESS) {
@@ -470,6 +503,7 @@ void SwapChain::createSyncObjects() {
 	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 	computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	graphicsFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 	computeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 	imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
@@ -499,6 +533,11 @@ void SwapChain::createSyncObjects() {
 				&semaphoreInfo,
 				nullptr,
 				&computeFinishedSemaphores[i]) != VK_SUCCESS ||
+			vkCreateSemaphore(
+				device.device(),
+				&semaphoreInfo,
+				nullptr,
+				&graphicsFinishedSemaphores[i]) != VK_SUCCESS ||
 			vkCreateFence(device.device(), &fenceInfo, nullptr, &computeInFlightFences[i]) !=
 				VK_SUCCESS) {
 			throw std::runtime_error(
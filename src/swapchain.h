@@ -8,6 +8,8 @@
 #include <memory>
 
 // std lib headers
+#include <deque>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -40,6 +42,9 @@ class SwapChain {
 	VkFormat findDepthFormat();
 
 	VkResult acquireNextImage(uint32_t *imageIndex);
+	// Graphics work of a frame consumes the compute results of the frame before it, so compute for
+	// one frame runs alongside graphics of the previous one. Compute in turn waits for the graphics
+	// submit before it, which is done reading what the new dispatch overwrites.
 	VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
 	void submitComputeCommandBuffers(const VkCommandBuffer *buffers);
 
@@ -73,12 +78,12 @@ class SwapChain {
 	VkRenderPass renderPass;
 
 	std::vector<VkImage> depthImages;
-	std::vector<VkDeviceMemory> depthImageMemorys;
+	std::vector<Allocation> depthImageMemorys;
 	std::vector<VkImageView> depthImageViews;
 	std::vector<VkImage> swapChainImages;
 	std::vector<VkImageView> swapChainImageViews;
 	std::vector<VkImage> colorImages;
-	std::vector<VkDeviceMemory> colorImageMemorys;
+	std::vector<Allocation> colorImageMemorys;
 	std::vector<VkImageView> colorImageViews;
 
 	Device &device;
@@ -91,6 +96,11 @@ class SwapChain {
 	std::vector<VkSemaphore> renderFinishedSemaphores;
 
 	std::vector<VkSemaphore> computeFinishedSemaphores;
+	std::vector<VkSemaphore> graphicsFinishedSemaphores;
+	// frames whose computeFinishedSemaphores no graphics submit has waited on yet, oldest first
+	std::deque<size_t> pendingComputeFrames;
+	// frame whose graphicsFinishedSemaphores no compute submit has waited on yet
+	std::optional<size_t> pendingGraphicsFrame;
 	std::vector<VkFence> inFlightFences;
 	std::vector<VkFence> imagesInFlight;
 	std::vector<VkFence> computeInFlightFences;
@@ -4,13 +4,32 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "textures/texture_cache.h"
+
 // std
 #include <cmath>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace lvr {
-Texture::Texture(Device& device, const std::string& textureFilepath) : mDevice{device} {
-	createTextureImage(textureFilepath);
+Texture::Texture(
+	Device& device,
+	const std::string& textureFilepath,
+	TextureCooker::Usage usage,
+	uint32_t firstMip)
+	: Texture{device, loadFile(device, textureFilepath, usage, firstMip)} {}
+
+Texture::Texture(Device& device, FileData fileData)
+	: mDevice{device},
+	  mSourcePath{fileData.sourcePath},
+	  mUsage{fileData.usage},
+	  mFirstMip{fileData.firstMip} {
+	if (fileData.cooked) {
+		createCompressedTextureImage(*fileData.cooked);
+	} else {
+		createTextureImage(fileData);
+	}
 	createTextureImageView(VK_IMAGE_VIEW_TYPE_2D);
 	createTextureSampler();
 	updateDescriptor();
@@ -24,22 +43,18 @@ Texture::Texture(
 	VkSampleCountFlagBits sampleCount)
 	: mDevice{device} {
 	VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	VkImageLayout imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 	mFormat = format;
 	mExtent = extent;
 
 	if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) {
 		aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	}
 	if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
 		aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 	}
 	if (usage & VK_IMAGE_USAGE_STORAGE_BIT) {
 		aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 	}
 
 	// Don't like this, should I be using an image array instead of multiple images?
@@ -54,6 +69,13 @@ Texture::Texture(
 	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imageInfo.usage = usage;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	// storage images are written on the compute queue and sampled by graphics
+	const auto& queueFamilies = device.getQueueFamilies();
+	if ((usage & VK_IMAGE_USAGE_STORAGE_BIT) && queueFamilies.size() > 1) {
+		imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+		imageInfo.pQueueFamilyIndices = queueFamilies.data();
+	}
 	device.createImageWithInfo(
 		imageInfo,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -75,7 +97,9 @@ Texture::Texture(
 		throw std::runtime_error("failed to create texture image view!");
 	}
 
-	mDevice.transitionImageLayout(
+	// the compute queue waits for the upload batch before its dispatches, see
+	// SwapChain::submitComputeCommandBuffers
+	mDevice.transitionImageLayoutBatched(
 		mTextureImage,
 		format,
 		VK_IMAGE_LAYOUT_UNDEFINED,
@@ -97,19 +121,15 @@ Texture::Texture(
 		samplerInfo.mipLodBias = 0.0f;
 		samplerInfo.maxAnisotropy = 1.0f;
 		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 1.0f;
+		samplerInfo.maxLod = 0.0f;
 		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
 
 		if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &mTextureSampler) !=
 			VK_SUCCESS) {
 			throw std::runtime_error("failed to create sampler!");
 		}
-		VkImageLayout samplerImageLayout;
-		if (imageLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
-			samplerImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		if (imageLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-			samplerImageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-		if (imageLayout = VK_IMAGE_LAYOUT_GENERAL) samplerImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		// every usage was transitioned to GENERAL above
+		VkImageLayout samplerImageLayout = VK_IMAGE_LAYOUT_GENERAL;
 
 		mDescriptor.sampler = mTextureSampler;
 		mDescriptor.imageView = mTextureImageView;
@@ -122,12 +142,27 @@ Texture::~Texture() {
 	vkDestroySampler(mDevice.device(), mTextureSampler, nullptr);
 	vkDestroyImageView(mDevice.device(), mTextureImageView, nullptr);
 	vkDestroyImage(mDevice.device(), mTextureImage, nullptr);
-	vkFreeMemory(mDevice.device(), mTextureImageMemory, nullptr);
+	mDevice.allocator().free(mTextureImageMemory);
 }
 
-std::unique_ptr<Texture> Texture::createTextureFromFile(
-	Device& device, const std::string& filepath) {
-	return std::make_unique<Texture>(device, filepath);
+std::shared_ptr<Texture> Texture::createTextureFromFile(
+	Device& device, const std::string& filepath, TextureCooker::Usage usage) {
+	return device.textureCache().get(filepath, usage);
+}
+
+void Texture::swapResources(Texture& other) {
+	std::swap(mTextureImage, other.mTextureImage);
+	std::swap(mTextureImageMemory, other.mTextureImageMemory);
+	std::swap(mTextureImageView, other.mTextureImageView);
+	std::swap(mTextureSampler, other.mTextureSampler);
+	std::swap(mFormat, other.mFormat);
+	std::swap(mTextureLayout, other.mTextureLayout);
+	std::swap(mMipLevels, other.mMipLevels);
+	std::swap(mExtent, other.mExtent);
+	std::swap(mFirstMip, other.mFirstMip);
+	updateDescriptor();
+	other.updateDescriptor();
+	mGeneration++;
 }
 
 void Texture::updateDescriptor() {
@@ -136,40 +171,144 @@ void Texture::updateDescriptor() {
 	mDescriptor.imageLayout = mTextureLayout;
 }
 
-void Texture::createTextureImage(const std::string& filepath) {
+Texture::FileData Texture::loadFile(
+	Device& device,
+	const std::string& textureFilepath,
+	TextureCooker::Usage usage,
+	uint32_t firstMip) {
+	FileData fileData{textureFilepath, usage, firstMip};
+	if (device.supportsTextureCompressionBC()) {
+		fileData.cooked = TextureCooker::load(textureFilepath, usage);
+		if (fileData.cooked) return fileData;
+	}
+
 	int texWidth, texHeight, texChannels;
 	// stbi_set_flip_vertically_on_load(1);  // todo determine why texture coordinates are flipped
 	stbi_uc* pixels =
-		stbi_load(filepath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
+		stbi_load(textureFilepath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 
 	if (!pixels) {
 		throw std::runtime_error("failed to load texture image!");
 	}
 
-	mMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-	// mMipLevels = 1;
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	mDevice.createBuffer(
-		imageSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer,
-		stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(mDevice.device(), stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(mDevice.device(), stagingBufferMemory);
+	fileData.width = static_cast<uint32_t>(texWidth);
+	fileData.height = static_cast<uint32_t>(texHeight);
+	uint32_t fullMipLevels = TextureCooker::getMipLevelCount(fileData.width, fileData.height);
+	fileData.firstMip = std::min(firstMip, fullMipLevels - 1);
+	VkFormat format = usage == TextureCooker::Usage::Color ? VK_FORMAT_R8G8B8A8_SRGB
+														   : VK_FORMAT_R8G8B8A8_UNORM;
 
+	if (fileData.firstMip == 0 && device.supportsLinearBlit(format)) {
+		// the GPU blits the chain from the full size image
+		fileData.texels.assign(pixels, pixels + static_cast<size_t>(texWidth) * texHeight * 4);
+	} else {
+		// the format can't be filtered by a blit or the top levels are left out, box filter the
+		// chain on the CPU instead and keep the levels that are uploaded
+		std::vector<uint64_t> levelOffsets{};
+		fileData.texels = TextureCooker::createMipChain(
+			pixels,
+			fileData.width,
+			fileData.height,
+			usage,
+			levelOffsets);
+		uint64_t begin = levelOffsets[fileData.firstMip];
+		fileData.texels.erase(fileData.texels.begin(), fileData.texels.begin() + begin);
+		for (uint32_t level = fileData.firstMip; level < fullMipLevels; level++) {
+			fileData.levelOffsets.push_back(levelOffsets[level] - begin);
+		}
+	}
 	stbi_image_free(pixels);
+	return fileData;
+}
 
-	mFormat = VK_FORMAT_R8G8B8A8_SRGB;
-	mExtent = {static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1};
+void Texture::createTextureImage(const FileData& fileData) {
+	uint32_t fullMipLevels = TextureCooker::getMipLevelCount(fileData.width, fileData.height);
+	mMipLevels = fullMipLevels - mFirstMip;
+	mFormat = mUsage == TextureCooker::Usage::Color ? VK_FORMAT_R8G8B8A8_SRGB
+													: VK_FORMAT_R8G8B8A8_UNORM;
+	mExtent = {
+		std::max(1u, fileData.width >> mFirstMip),
+		std::max(1u, fileData.height >> mFirstMip),
+		1};
+	bool blitMips = fileData.levelOffsets.empty();
+
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (blitMips) usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	createImage(usage);
+
+	if (blitMips) {
+		// leaves every mip in TRANSFER_DST_OPTIMAL and owned by the graphics queue, ready for the
+		// blits, which leave the whole chain in SHADER_READ_ONLY_OPTIMAL
+		mDevice.uploadQueue().uploadImage(
+			mTextureImage,
+			fileData.texels.data(),
+			fileData.texels.size(),
+			mExtent.width,
+			mExtent.height,
+			mLayerCount,
+			mMipLevels);
+		mDevice.generateMipmapsBatched(
+			mTextureImage,
+			mFormat,
+			fileData.width,
+			fileData.height,
+			mMipLevels);
+	} else {
+		mDevice.uploadQueue().uploadImageLevels(
+			mTextureImage,
+			fileData.texels.data(),
+			fileData.texels.size(),
+			mExtent.width,
+			mExtent.height,
+			fileData.levelOffsets);
+		mDevice.transitionImageLayoutBatched(
+			mTextureImage,
+			mFormat,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			mMipLevels,
+			mLayerCount);
+	}
+	mTextureLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
 
+void Texture::createCompressedTextureImage(const TextureCooker::MappedTexture& cooked) {
+	uint32_t fullMipLevels = cooked.getLevelCount();
+	mFirstMip = std::min(mFirstMip, fullMipLevels - 1);
+	mMipLevels = fullMipLevels - mFirstMip;
+	mFormat = cooked.getFormat();
+	mExtent = {
+		std::max(1u, cooked.getWidth() >> mFirstMip),
+		std::max(1u, cooked.getHeight() >> mFirstMip),
+		1};
+	createImage(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+	// levels are stored smallest first, so the kept ones are one range ending with mFirstMip
+	uint64_t begin = cooked.getLevelOffset(fullMipLevels - 1);
+	uint64_t end = cooked.getLevelOffset(mFirstMip) + cooked.getLevelSize(mFirstMip);
+	std::vector<uint64_t> levelOffsets(mMipLevels);
+	for (uint32_t level = 0; level < mMipLevels; level++) {
+		levelOffsets[level] = cooked.getLevelOffset(mFirstMip + level) - begin;
+	}
+	// the blocks are staged straight from the mapped file
+	mDevice.uploadQueue().uploadImageLevels(
+		mTextureImage,
+		cooked.levelData().data() + begin,
+		end - begin,
+		mExtent.width,
+		mExtent.height,
+		levelOffsets);
+	mDevice.transitionImageLayoutBatched(
+		mTextureImage,
+		mFormat,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		mMipLevels,
+		mLayerCount);
+	mTextureLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+void Texture::createImage(VkImageUsageFlags usage) {
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -179,8 +318,7 @@ void Texture::createTextureImage(const std::string& filepath) {
 	imageInfo.format = mFormat;
 	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-					  VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.usage = usage;
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
@@ -189,35 +327,6 @@ void Texture::createTextureImage(const std::string& filepath) {
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		mTextureImage,
 		mTextureImageMemory);
-	mDevice.transitionImageLayout(
-		mTextureImage,
-		VK_FORMAT_R8G8B8A8_SRGB,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		mMipLevels,
-		mLayerCount);
-	mDevice.copyBufferToImage(
-		stagingBuffer,
-		mTextureImage,
-		static_cast<uint32_t>(texWidth),
-		static_cast<uint32_t>(texHeight),
-		mLayerCount);
-
-	// comment this out if using mips
-	// mDevice.transitionImageLayout(
-	// 	mTextureImage,
-	// 	VK_FORMAT_R8G8B8A8_SRGB,
-	// 	VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-	// 	VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-	// 	mMipLevels,
-	// 	mLayerCount);
-
-	// If we generate mip maps then the final image will alerady be READ_ONLY_OPTIMAL
-	mDevice.generateMipmaps(mTextureImage, mFormat, texWidth, texHeight, mMipLevels);
-	mTextureLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-	vkDestroyBuffer(mDevice.device(), stagingBuffer, nullptr);
-	vkFreeMemory(mDevice.device(), stagingBufferMemory, nullptr);
 }
 
 void Texture::createTextureImageView(VkImageViewType viewType) {
@@ -225,7 +334,7 @@ void Texture::createTextureImageView(VkImageViewType viewType) {
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = mTextureImage;
 	viewInfo.viewType = viewType;
-	viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+	viewInfo.format = mFormat;
 	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	viewInfo.subresourceRange.baseMipLevel = 0;
 	viewInfo.subresourceRange.levelCount = mMipLevels;
@@ -261,7 +370,8 @@ void Texture::createTextureSampler() {
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = static_cast<float>(mMipLevels);
+	// the smallest level is mMipLevels - 1
+	samplerInfo.maxLod = static_cast<float>(mMipLevels - 1);
 
 	if (vkCreateSampler(mDevice.device(), &samplerInfo, nullptr, &mTextureSampler) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create texture sampler!");
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "device.h"
+#include "textures/texture_cooker.h"
 
 // libs
 #include <vulkan/vulkan.h>
@@ -8,11 +9,45 @@
 // std
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace lvr {
 class Texture {
    public:
-	Texture(Device &device, const std::string &textureFilepath);
+	// A file texture read and decoded on the CPU, ready to be uploaded
+	struct FileData {
+		std::string sourcePath;
+		TextureCooker::Usage usage;
+		uint32_t firstMip;
+		// the up to date cooked texture, when there is none the decoded source below is used
+		std::unique_ptr<TextureCooker::MappedTexture> cooked;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// RGBA8, the full size image when the GPU blits the mips, the kept levels of the chain
+		// built on the CPU otherwise
+		std::vector<uint8_t> texels;
+		// offsets of the kept levels into texels, empty when the GPU blits the mips
+		std::vector<uint64_t> levelOffsets;
+	};
+
+	// Reads the cooked texture or decodes the source image, throws when neither works. Creates no
+	// Vulkan objects, so it may run on a worker thread.
+	static FileData loadFile(
+		Device &device,
+		const std::string &textureFilepath,
+		TextureCooker::Usage usage,
+		uint32_t firstMip);
+
+	// Loads the cooked texture when there is an up to date one, the source image otherwise.
+	// `firstMip` levels are left out, a texture trimmed to fit the memory budget starts at a
+	// smaller mip of the same chain.
+	Texture(
+		Device &device,
+		const std::string &textureFilepath,
+		TextureCooker::Usage usage = TextureCooker::Usage::Color,
+		uint32_t firstMip = 0);
+	// Uploads a file texture loaded by loadFile, on the render thread
+	Texture(Device &device, FileData fileData);
 	Texture(
 		Device &device,
 		VkFormat format,
@@ -33,6 +68,19 @@ class Texture {
 	VkImageLayout getImageLayout() const { return mTextureLayout; }
 	VkExtent3D getExtent() const { return mExtent; }
 	VkFormat getFormat() const { return mFormat; }
+	// Device memory of the image
+	VkDeviceSize getMemorySize() const { return mTextureImageMemory.size; }
+	const std::string &getSourcePath() const { return mSourcePath; }
+	TextureCooker::Usage getUsage() const { return mUsage; }
+	// Levels of the full chain left out of the image, 0 when it is fully resident
+	uint32_t getFirstMip() const { return mFirstMip; }
+	uint32_t getMipLevels() const { return mMipLevels; }
+	// Changes every time the texture's image is replaced, descriptors written before are stale
+	uint32_t getGeneration() const { return mGeneration; }
+
+	// Takes over the image, view and sampler of `other`, which gets this texture's and can be
+	// destroyed once no frame in flight uses them
+	void swapResources(Texture &other);
 
 	void updateDescriptor();
 	void transitionLayout(
@@ -41,11 +89,18 @@ class Texture {
 		VkImageLayout newLayout,
 		bool before);
 
-	static std::unique_ptr<Texture> createTextureFromFile(
-		Device &device, const std::string &filepath);
+	// Shared through the device's texture cache, loading a file twice returns the same texture
+	static std::shared_ptr<Texture> createTextureFromFile(
+		Device &device,
+		const std::string &filepath,
+		TextureCooker::Usage usage = TextureCooker::Usage::Color);
 
    private:
-	void createTextureImage(const std::string &filepath);
+	void createTextureImage(const FileData &fileData);
+	// Uploads the blocks of a cooked texture with its mip chain as they are
+	void createCompressedTextureImage(const TextureCooker::MappedTexture &cooked);
+	// Device local image of mExtent, mFormat and mMipLevels
+	void createImage(VkImageUsageFlags usage);
 	void createTextureImageView(VkImageViewType viewType);
 	void createTextureSampler();
 
@@ -53,7 +108,7 @@ class Texture {
 
 	Device &mDevice;
 	VkImage mTextureImage = nullptr;
-	VkDeviceMemory mTextureImageMemory = nullptr;
+	Allocation mTextureImageMemory{};
 	VkImageView mTextureImageView = nullptr;
 	VkSampler mTextureSampler = nullptr;
 	VkFormat mFormat;
@@ -61,6 +116,15 @@ class Texture {
 	uint32_t mMipLevels{1};
 	uint32_t mLayerCount{1};
 	VkExtent3D mExtent{};
+
+	std::string mSourcePath{};
+	TextureCooker::Usage mUsage = TextureCooker::Usage::Color;
+	uint32_t mFirstMip = 0;
+	uint32_t mGeneration = 0;
+	// last frame the texture was drawn with, see TextureCache::touch
+	uint64_t mLastUsedFrame = 0;
+
+	friend class TextureCache;
 };
 
 }  // namespace lvr
\ No newline at end of file
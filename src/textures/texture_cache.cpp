@@ -0,0 +1,195 @@
+#include "texture_cache.h"
+
+#include "release_queue.h"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+namespace lvr {
+
+namespace {
+
+VkDeviceSize getDefaultBudget(Device &device) {
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(device.getPhysicalDevice(), &memoryProperties);
+	VkDeviceSize largestHeap = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		const VkMemoryHeap &heap = memoryProperties.memoryHeaps[i];
+		if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			largestHeap = std::max(largestHeap, heap.size);
+		}
+	}
+	return largestHeap / 2;
+}
+
+}  // namespace
+
+TextureCache::TextureCache(Device &lvrDevice, VkDeviceSize budget)
+	: lvrDevice{lvrDevice}, budget{budget > 0 ? budget : getDefaultBudget(lvrDevice)} {}
+
+TextureCache::~TextureCache() {
+	// every frame finished before the device goes away
+	reloads.clear();
+	textures.clear();
+}
+
+std::shared_ptr<Texture> TextureCache::get(const std::string &path, TextureCooker::Usage usage) {
+	// one entry for "textures/a.png" and "./textures/a.png"
+	std::error_code error;
+	std::filesystem::path canonicalPath = std::filesystem::weakly_canonical(path, error);
+	std::string key = (error ? path : canonicalPath.string()) + '|' +
+					  std::to_string(static_cast<int>(usage));
+
+	auto cached = textures.find(key);
+	if (cached != textures.end()) {
+		statistics.hits++;
+		return cached->second;
+	}
+
+	auto texture = std::make_shared<Texture>(lvrDevice, path, usage);
+	texture->mLastUsedFrame = frame;
+	textures.emplace(key, texture);
+	statistics.misses++;
+	return texture;
+}
+
+void TextureCache::update() {
+	frame++;
+	finishReloads();
+
+	// trimmed textures drawn last frame get their full chain back
+	uint32_t restores = 0;
+	for (auto &kv : textures) {
+		if (restores == MAX_RELOADS_PER_FRAME) break;
+		Texture &texture = *kv.second;
+		if (texture.mFirstMip == 0 || texture.mLastUsedFrame + 1 < frame) continue;
+		if (isReloading(texture)) continue;
+		startReload(kv.second, 0);
+		restores++;
+	}
+
+	// reloads still being read count with the size they will have
+	VkDeviceSize memoryUsage = getMemoryUsage();
+	for (const PendingReload &reload : reloads) {
+		memoryUsage = memoryUsage - reload.texture->getMemorySize() + reload.expectedSize;
+	}
+	if (memoryUsage <= budget) return;
+
+	// least recently drawn first
+	std::vector<std::string> candidates{};
+	for (const auto &kv : textures) {
+		candidates.push_back(kv.first);
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](const auto &a, const auto &b) {
+		return textures.at(a)->mLastUsedFrame < textures.at(b)->mLastUsedFrame;
+	});
+
+	uint32_t trims = 0;
+	for (const std::string &key : candidates) {
+		if (memoryUsage <= budget) break;
+		auto entry = textures.find(key);
+		Texture &texture = *entry->second;
+		VkDeviceSize size = texture.getMemorySize();
+
+		// nothing but the cache holds it, a frame in flight still might
+		if (entry->second.use_count() == 1) {
+			lvrDevice.releaseQueue().retire(std::move(entry->second));
+			textures.erase(entry);
+			memoryUsage -= size;
+			statistics.evictions++;
+			continue;
+		}
+
+		// recently drawn textures would be streamed right back in
+		if (trims == MAX_RELOADS_PER_FRAME || texture.mLastUsedFrame + TRIM_IDLE_FRAMES > frame) {
+			continue;
+		}
+		if (isReloading(texture)) continue;
+		uint32_t firstMip = texture.mFirstMip;
+		uint32_t largestSide = std::max(texture.mExtent.width, texture.mExtent.height);
+		for (uint32_t i = 0; i < TRIM_MIPS && (largestSide >> 1) >= MIN_TRIMMED_SIZE; i++) {
+			largestSide >>= 1;
+			firstMip++;
+		}
+		if (firstMip == texture.mFirstMip) continue;
+
+		startReload(entry->second, firstMip);
+		memoryUsage -= size - reloads.back().expectedSize;
+		trims++;
+	}
+}
+
+void TextureCache::startReload(const std::shared_ptr<Texture> &texture, uint32_t firstMip) {
+	// every level is about a quarter of the one above it
+	VkDeviceSize size = texture->getMemorySize();
+	VkDeviceSize expectedSize = firstMip < texture->mFirstMip
+									? size << (2 * (texture->mFirstMip - firstMip))
+									: size >> (2 * (firstMip - texture->mFirstMip));
+
+	auto fileData = workers.submit(
+		[&device = lvrDevice, path = texture->mSourcePath, usage = texture->mUsage, firstMip]() {
+			return Texture::loadFile(device, path, usage, firstMip);
+		});
+	reloads.push_back({texture, firstMip, expectedSize, std::move(fileData)});
+}
+
+void TextureCache::finishReloads() {
+	for (auto it = reloads.begin(); it != reloads.end();) {
+		if (it->fileData.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			++it;
+			continue;
+		}
+
+		Texture &texture = *it->texture;
+		bool trimmed = it->firstMip > texture.mFirstMip;
+		try {
+			auto replacement = std::make_shared<Texture>(lvrDevice, it->fileData.get());
+			texture.swapResources(*replacement);
+			lvrDevice.releaseQueue().retire(std::move(replacement));
+			if (trimmed) {
+				std::cout << "trimmed texture " << texture.mSourcePath << " to "
+						  << texture.mExtent.width << "x" << texture.mExtent.height << std::endl;
+				statistics.trims++;
+			} else {
+				std::cout << "restored texture " << texture.mSourcePath << std::endl;
+				statistics.restores++;
+			}
+		} catch (const std::exception &e) {
+			// the source went away or broke, keep what is resident
+			std::cerr << "failed to reload texture " << texture.mSourcePath << ": " << e.what()
+					  << std::endl;
+		}
+		it = reloads.erase(it);
+	}
+}
+
+bool TextureCache::isReloading(const Texture &texture) const {
+	return std::any_of(reloads.begin(), reloads.end(), [&texture](const PendingReload &reload) {
+		return reload.texture.get() == &texture;
+	});
+}
+
+VkDeviceSize TextureCache::getMemoryUsage() const {
+	VkDeviceSize memoryUsage = 0;
+	for (const auto &kv : textures) {
+		memoryUsage += kv.second->getMemorySize();
+	}
+	return memoryUsage;
+}
+
+TextureCache::Statistics TextureCache::getStatistics() const {
+	Statistics current = statistics;
+	current.textureCount = static_cast<uint32_t>(textures.size());
+	for (const auto &kv : textures) {
+		if (kv.second->mFirstMip > 0) current.trimmedCount++;
+	}
+	current.memoryUsage = getMemoryUsage();
+	current.budget = budget;
+	return current;
+}
+
+}  // namespace lvr
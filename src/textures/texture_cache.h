@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "device.h"
+#include "textures/texture.h"
+#include "utils/thread_pool.h"
+
+// std
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lvr {
+
+// Textures loaded from files, shared by canonical path and usage so a file is only uploaded once.
+// Their device memory is kept within a budget: over it, textures nothing else holds are released
+// and the least recently drawn ones are trimmed to a smaller mip of their chain. A trimmed texture
+// that is drawn again gets its full chain streamed back in. Trims and restores read the file on a
+// worker thread and the texture keeps its current image until the new one is uploaded. A texture
+// keeps its identity through this, only the image behind it is replaced and its generation
+// changes. Not thread safe, use it from the render thread.
+class TextureCache {
+   public:
+	// levels dropped from a texture each time it is trimmed
+	static constexpr uint32_t TRIM_MIPS = 2;
+	// textures aren't trimmed below this size
+	static constexpr uint32_t MIN_TRIMMED_SIZE = 64;
+	// frames a texture has to go undrawn before it is trimmed
+	static constexpr uint64_t TRIM_IDLE_FRAMES = 120;
+	// trims and restores started each frame
+	static constexpr uint32_t MAX_RELOADS_PER_FRAME = 2;
+
+	struct Statistics {
+		uint32_t textureCount = 0;
+		uint32_t trimmedCount = 0;
+		VkDeviceSize memoryUsage = 0;
+		VkDeviceSize budget = 0;
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+		uint32_t evictions = 0;
+		uint32_t trims = 0;
+		uint32_t restores = 0;
+	};
+
+	// A budget of 0 uses half of the largest device local heap
+	TextureCache(Device &lvrDevice, VkDeviceSize budget = 0);
+	~TextureCache();
+	TextureCache(const TextureCache &) = delete;
+	TextureCache &operator=(const TextureCache &) = delete;
+
+	std::shared_ptr<Texture> get(
+		const std::string &path,
+		TextureCooker::Usage usage = TextureCooker::Usage::Color);
+	// Marks `texture` as drawn this frame
+	void touch(Texture &texture) { texture.mLastUsedFrame = frame; }
+	// Call once per frame after its fence was waited on. Streams drawn textures back in and brings
+	// the memory use under the budget. Replaced images go to the device's release queue.
+	void update();
+
+	void setBudget(VkDeviceSize budget) { this->budget = budget; }
+	VkDeviceSize getBudget() const { return budget; }
+	// Counts update() calls
+	uint64_t getFrame() const { return frame; }
+	Statistics getStatistics() const;
+
+   private:
+	struct PendingReload {
+		std::shared_ptr<Texture> texture;
+		uint32_t firstMip;
+		// memory the texture is expected to use once it is reloaded
+		VkDeviceSize expectedSize;
+		std::future<Texture::FileData> fileData;
+	};
+
+	// Starts reading `texture` from `firstMip` on the worker
+	void startReload(const std::shared_ptr<Texture> &texture, uint32_t firstMip);
+	// Uploads the reloads whose files were read and retires the images they replace
+	void finishReloads();
+	bool isReloading(const Texture &texture) const;
+	VkDeviceSize getMemoryUsage() const;
+
+	Device &lvrDevice;
+	VkDeviceSize budget;
+	std::unordered_map<std::string, std::shared_ptr<Texture>> textures{};
+	std::vector<PendingReload> reloads{};
+	uint64_t frame = 0;
+	Statistics statistics{};
+	// a couple of reloads a frame don't need more than one worker
+	utils::ThreadPool workers{1};
+};
+
+}  // namespace lvr
@@ -0,0 +1,835 @@
+#include "texture_cooker.h"
+
+// libs
+#include <stb_image.h>
+
+// std
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <system_error>
+
+#include "utils/thread_pool.h"
+
+#if defined(LVR_PLATFORM_LINUX) || defined(LVR_PLATFORM_MACOS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LVR_TEXTURE_CACHE_MMAP
+#endif
+
+namespace lvr {
+
+namespace {
+
+// *************** KTX2 *********************
+
+constexpr uint8_t KTX2_IDENTIFIER[12] =
+	{0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+
+struct Ktx2Header {
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+struct Ktx2Level {
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+// data format descriptor constants of the Khronos Data Format spec
+constexpr uint32_t DF_MODEL_BC5 = 131;
+constexpr uint32_t DF_MODEL_BC7 = 134;
+constexpr uint32_t DF_PRIMARIES_BT709 = 1;
+constexpr uint32_t DF_TRANSFER_LINEAR = 1;
+constexpr uint32_t DF_TRANSFER_SRGB = 2;
+
+// level data has to start at a multiple of lcm(block size, 4)
+constexpr uint64_t BLOCK_BYTES = 16;
+
+// key of the key/value entry holding the SourceKey a file was cooked from
+constexpr char SOURCE_KEY_NAME[] = "LVRsource";
+
+struct SourceKey {
+	uint64_t pathHash;
+	uint64_t sourceSize;
+	int64_t sourceModifiedTime;
+	uint32_t version;
+	uint32_t usage;
+};
+
+uint64_t hashPath(const std::string &path) {
+	// FNV-1a, stable across runs unlike std::hash
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (unsigned char c : path) {
+		hash ^= c;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+std::string canonicalPath(const std::string &path) {
+	std::error_code ec;
+	auto canonical = std::filesystem::weakly_canonical(path, ec);
+	return ec ? path : canonical.string();
+}
+
+uint64_t alignOffset(uint64_t offset, uint64_t alignment) {
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+bool fillSourceKey(const std::string &sourcePath, SourceKey &key) {
+	std::error_code ec;
+	auto sourceSize = std::filesystem::file_size(sourcePath, ec);
+	if (ec) return false;
+	auto sourceTime = std::filesystem::last_write_time(sourcePath, ec);
+	if (ec) return false;
+
+	key.pathHash = hashPath(canonicalPath(sourcePath));
+	key.sourceSize = sourceSize;
+	key.sourceModifiedTime =
+		std::chrono::duration_cast<std::chrono::nanoseconds>(sourceTime.time_since_epoch())
+			.count();
+	key.version = TextureCooker::VERSION;
+	return true;
+}
+
+uint64_t getCompressedLevelSize(uint32_t width, uint32_t height, uint32_t level) {
+	uint64_t levelWidth = std::max(1u, width >> level);
+	uint64_t levelHeight = std::max(1u, height >> level);
+	return ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * BLOCK_BYTES;
+}
+
+std::vector<uint32_t> createDataFormatDescriptor(VkFormat format) {
+	bool bc7 = format == VK_FORMAT_BC7_SRGB_BLOCK;
+	uint32_t sampleCount = bc7 ? 1 : 2;
+	uint32_t blockSize = 24 + 16 * sampleCount;
+	uint32_t model = bc7 ? DF_MODEL_BC7 : DF_MODEL_BC5;
+	uint32_t transfer = bc7 ? DF_TRANSFER_SRGB : DF_TRANSFER_LINEAR;
+
+	std::vector<uint32_t> dfd{
+		4 + blockSize,
+		0,
+		(blockSize << 16) | 2,
+		model | (DF_PRIMARIES_BT709 << 8) | (transfer << 16),
+		3 | (3 << 8),
+		static_cast<uint32_t>(BLOCK_BYTES),
+		0};
+	// one sample per 64 bit channel for BC5, one covering the whole block for BC7
+	for (uint32_t sample = 0; sample < sampleCount; sample++) {
+		uint32_t bitOffset = bc7 ? 0 : 64 * sample;
+		uint32_t bitLength = bc7 ? 127 : 63;
+		dfd.insert(dfd.end(), {bitOffset | (bitLength << 16) | (sample << 24), 0, 0, UINT32_MAX});
+	}
+	return dfd;
+}
+
+void appendKeyValue(
+	std::vector<uint8_t> &kvd, const std::string &key, const void *value, size_t size) {
+	uint32_t length = static_cast<uint32_t>(key.size() + 1 + size);
+	const auto *lengthBytes = reinterpret_cast<const uint8_t *>(&length);
+	kvd.insert(kvd.end(), lengthBytes, lengthBytes + sizeof(length));
+	kvd.insert(kvd.end(), key.begin(), key.end());
+	kvd.push_back(0);
+	const auto *valueBytes = static_cast<const uint8_t *>(value);
+	kvd.insert(kvd.end(), valueBytes, valueBytes + size);
+	kvd.resize(alignOffset(kvd.size(), 4), 0);
+}
+
+// *************** Mip chain *********************
+
+struct Level {
+	uint32_t width;
+	uint32_t height;
+	// linear RGBA, normals in [-1, 1] for normal maps
+	std::vector<float> texels;
+};
+
+float srgbToLinear(float value) {
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float value) {
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+uint8_t toByte(float value) {
+	return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+Level decodeLevel(
+	const uint8_t *pixels, uint32_t width, uint32_t height, TextureCooker::Usage usage) {
+	std::array<float, 256> toLinear{};
+	for (uint32_t i = 0; i < 256; i++) {
+		toLinear[i] = srgbToLinear(i / 255.0f);
+	}
+
+	Level level{width, height, std::vector<float>(static_cast<size_t>(width) * height * 4)};
+	for (size_t i = 0; i < level.texels.size(); i += 4) {
+		for (size_t c = 0; c < 3; c++) {
+			level.texels[i + c] = usage == TextureCooker::Usage::Color
+									  ? toLinear[pixels[i + c]]
+									  : pixels[i + c] / 255.0f * 2.0f - 1.0f;
+		}
+		level.texels[i + 3] = pixels[i + 3] / 255.0f;
+	}
+	return level;
+}
+
+// 2x2 box filter, the last row or column is repeated for odd sizes
+Level downsample(const Level &source, TextureCooker::Usage usage) {
+	Level level{std::max(1u, source.width / 2), std::max(1u, source.height / 2), {}};
+	level.texels.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+	for (uint32_t y = 0; y < level.height; y++) {
+		for (uint32_t x = 0; x < level.width; x++) {
+			uint32_t x0 = std::min(2 * x, source.width - 1);
+			uint32_t x1 = std::min(2 * x + 1, source.width - 1);
+			uint32_t y0 = std::min(2 * y, source.height - 1);
+			uint32_t y1 = std::min(2 * y + 1, source.height - 1);
+			float *texel = &level.texels[(static_cast<size_t>(y) * level.width + x) * 4];
+			for (uint32_t c = 0; c < 4; c++) {
+				auto at = [&](uint32_t sx, uint32_t sy) {
+					return source.texels[(static_cast<size_t>(sy) * source.width + sx) * 4 + c];
+				};
+				texel[c] = 0.25f * (at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1));
+			}
+			if (usage == TextureCooker::Usage::Normal) {
+				float length = std::sqrt(
+					texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+				if (length > 0.0f) {
+					for (uint32_t c = 0; c < 3; c++) texel[c] /= length;
+				}
+			}
+		}
+	}
+	return level;
+}
+
+// 8 bit texels as the encoders take them, sRGB for color
+std::vector<uint8_t> encodeLevel(const Level &level, TextureCooker::Usage usage) {
+	std::vector<uint8_t> texels(level.texels.size());
+	for (size_t i = 0; i < texels.size(); i += 4) {
+		for (size_t c = 0; c < 3; c++) {
+			float value = level.texels[i + c];
+			texels[i + c] = toByte(
+				usage == TextureCooker::Usage::Color ? linearToSrgb(value) : value * 0.5f + 0.5f);
+		}
+		texels[i + 3] = toByte(level.texels[i + 3]);
+	}
+	return texels;
+}
+
+// *************** Block encoders *********************
+
+// texels of the 4x4 block at (blockX, blockY), edge texels repeated past the border
+void loadBlock(
+	const uint8_t *texels,
+	uint32_t width,
+	uint32_t height,
+	uint32_t blockX,
+	uint32_t blockY,
+	uint8_t block[16][4]) {
+	for (uint32_t y = 0; y < 4; y++) {
+		for (uint32_t x = 0; x < 4; x++) {
+			uint32_t sx = std::min(blockX * 4 + x, width - 1);
+			uint32_t sy = std::min(blockY * 4 + y, height - 1);
+			std::memcpy(block[y * 4 + x], &texels[(static_cast<size_t>(sy) * width + sx) * 4], 4);
+		}
+	}
+}
+
+class BitWriter {
+   public:
+	BitWriter(uint8_t *out) : out{out} { std::memset(out, 0, 16); }
+
+	void write(uint32_t value, uint32_t bits) {
+		for (uint32_t i = 0; i < bits; i++, position++) {
+			if ((value >> i) & 1) out[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+		}
+	}
+
+   private:
+	uint8_t *out;
+	uint32_t position = 0;
+};
+
+// BC4, eight interpolated values between the block's extremes
+void encodeBc4(const uint8_t block[16][4], uint32_t channel, uint8_t *out) {
+	uint8_t high = 0;
+	uint8_t low = 255;
+	for (uint32_t i = 0; i < 16; i++) {
+		high = std::max(high, block[i][channel]);
+		low = std::min(low, block[i][channel]);
+	}
+
+	int32_t palette[8] = {high, low};
+	for (int32_t i = 1; i < 7; i++) {
+		palette[i + 1] = ((7 - i) * high + i * low + 3) / 7;
+	}
+
+	out[0] = high;
+	out[1] = low;
+	uint64_t indices = 0;
+	for (uint32_t i = 0; i < 16; i++) {
+		uint32_t best = 0;
+		int32_t bestError = INT32_MAX;
+		for (uint32_t p = 0; p < 8; p++) {
+			int32_t error = std::abs(palette[p] - block[i][channel]);
+			if (error < bestError) {
+				bestError = error;
+				best = p;
+			}
+		}
+		indices |= static_cast<uint64_t>(best) << (3 * i);
+	}
+	for (uint32_t i = 0; i < 6; i++) {
+		out[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+	}
+}
+
+void encodeBc5(const uint8_t block[16][4], uint8_t *out) {
+	encodeBc4(block, 0, out);
+	encodeBc4(block, 1, out + 8);
+}
+
+// BC7 mode 6: one subset, 7 bit RGBA endpoints with a p-bit each and 4 bit indices
+constexpr int32_t BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Bc7Endpoints {
+	uint32_t quantized[2][4];
+	uint32_t pbits[2];
+	int32_t values[2][4];
+};
+
+// rounds each endpoint to 7 bits plus the p-bit that fits it best
+Bc7Endpoints quantizeBc7(const float endpoints[2][4]) {
+	Bc7Endpoints result{};
+	for (uint32_t e = 0; e < 2; e++) {
+		float bestError = INFINITY;
+		for (uint32_t p = 0; p < 2; p++) {
+			float error = 0.0f;
+			uint32_t quantized[4];
+			for (uint32_t c = 0; c < 4; c++) {
+				float value = std::clamp(endpoints[e][c], 0.0f, 255.0f);
+				quantized[c] = static_cast<uint32_t>(
+					std::clamp(std::lround((value - p) / 2.0f), 0l, 127l));
+				float difference = static_cast<float>((quantized[c] << 1) | p) - value;
+				error += difference * difference;
+			}
+			if (error < bestError) {
+				bestError = error;
+				result.pbits[e] = p;
+				for (uint32_t c = 0; c < 4; c++) {
+					result.quantized[e][c] = quantized[c];
+					result.values[e][c] = static_cast<int32_t>((quantized[c] << 1) | p);
+				}
+			}
+		}
+	}
+	return result;
+}
+
+// picks the nearest palette entry for every texel, returns the summed squared error
+uint32_t indexBc7(const uint8_t block[16][4], const Bc7Endpoints &endpoints, uint32_t indices[16]) {
+	int32_t palette[16][4];
+	for (uint32_t i = 0; i < 16; i++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			palette[i][c] = ((64 - BC7_WEIGHTS[i]) * endpoints.values[0][c] +
+							 BC7_WEIGHTS[i] * endpoints.values[1][c] + 32) >>
+							6;
+		}
+	}
+
+	uint32_t totalError = 0;
+	for (uint32_t t = 0; t < 16; t++) {
+		uint32_t bestError = UINT32_MAX;
+		for (uint32_t i = 0; i < 16; i++) {
+			uint32_t error = 0;
+			for (uint32_t c = 0; c < 4; c++) {
+				int32_t difference = palette[i][c] - block[t][c];
+				error += static_cast<uint32_t>(difference * difference);
+			}
+			if (error < bestError) {
+				bestError = error;
+				indices[t] = i;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+void encodeBc7(const uint8_t block[16][4], uint8_t *out) {
+	float mean[4] = {};
+	for (uint32_t t = 0; t < 16; t++) {
+		for (uint32_t c = 0; c < 4; c++) mean[c] += block[t][c] / 16.0f;
+	}
+
+	// principal axis of the texels by power iteration on their covariance
+	float covariance[4][4] = {};
+	for (uint32_t t = 0; t < 16; t++) {
+		for (uint32_t i = 0; i < 4; i++) {
+			for (uint32_t j = 0; j < 4; j++) {
+				covariance[i][j] += (block[t][i] - mean[i]) * (block[t][j] - mean[j]);
+			}
+		}
+	}
+	float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+	for (uint32_t iteration = 0; iteration < 8; iteration++) {
+		float next[4] = {};
+		float length = 0.0f;
+		for (uint32_t i = 0; i < 4; i++) {
+			for (uint32_t j = 0; j < 4; j++) next[i] += covariance[i][j] * axis[j];
+			length += next[i] * next[i];
+		}
+		if (length < 1e-8f) break;
+		length = std::sqrt(length);
+		for (uint32_t i = 0; i < 4; i++) axis[i] = next[i] / length;
+	}
+
+	float minProjection = 0.0f;
+	float maxProjection = 0.0f;
+	for (uint32_t t = 0; t < 16; t++) {
+		float projection = 0.0f;
+		for (uint32_t c = 0; c < 4; c++) projection += (block[t][c] - mean[c]) * axis[c];
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+
+	float endpoints[2][4];
+	for (uint32_t c = 0; c < 4; c++) {
+		endpoints[0][c] = mean[c] + axis[c] * minProjection;
+		endpoints[1][c] = mean[c] + axis[c] * maxProjection;
+	}
+	Bc7Endpoints quantized = quantizeBc7(endpoints);
+	uint32_t indices[16];
+	uint32_t error = indexBc7(block, quantized, indices);
+
+	// one least squares refit of the endpoints to the chosen indices
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = {}, bx[4] = {};
+	for (uint32_t t = 0; t < 16; t++) {
+		float b = BC7_WEIGHTS[indices[t]] / 64.0f;
+		float a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (uint32_t c = 0; c < 4; c++) {
+			ax[c] += a * block[t][c];
+			bx[c] += b * block[t][c];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (std::abs(determinant) > 1e-6f) {
+		float refit[2][4];
+		for (uint32_t c = 0; c < 4; c++) {
+			refit[0][c] = (bb * ax[c] - ab * bx[c]) / determinant;
+			refit[1][c] = (aa * bx[c] - ab * ax[c]) / determinant;
+		}
+		Bc7Endpoints refitQuantized = quantizeBc7(refit);
+		uint32_t refitIndices[16];
+		if (indexBc7(block, refitQuantized, refitIndices) < error) {
+			quantized = refitQuantized;
+			std::memcpy(indices, refitIndices, sizeof(indices));
+		}
+	}
+
+	// the first index is stored without its top bit, swap the endpoints to keep it clear
+	if (indices[0] & 8) {
+		std::swap(quantized.quantized[0], quantized.quantized[1]);
+		std::swap(quantized.pbits[0], quantized.pbits[1]);
+		for (uint32_t t = 0; t < 16; t++) indices[t] = 15 - indices[t];
+	}
+
+	BitWriter writer{out};
+	writer.write(1 << 6, 7);
+	for (uint32_t c = 0; c < 4; c++) {
+		writer.write(quantized.quantized[0][c], 7);
+		writer.write(quantized.quantized[1][c], 7);
+	}
+	writer.write(quantized.pbits[0], 1);
+	writer.write(quantized.pbits[1], 1);
+	writer.write(indices[0], 3);
+	for (uint32_t t = 1; t < 16; t++) writer.write(indices[t], 4);
+}
+
+std::vector<uint8_t> compressLevel(
+	const uint8_t *texels, uint32_t width, uint32_t height, VkFormat format) {
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	std::vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * BLOCK_BYTES);
+
+	uint8_t block[16][4];
+	for (uint32_t y = 0; y < blocksY; y++) {
+		for (uint32_t x = 0; x < blocksX; x++) {
+			loadBlock(texels, width, height, x, y, block);
+			uint8_t *out = &blocks[(static_cast<size_t>(y) * blocksX + x) * BLOCK_BYTES];
+			if (format == VK_FORMAT_BC7_SRGB_BLOCK) {
+				encodeBc7(block, out);
+			} else {
+				encodeBc5(block, out);
+			}
+		}
+	}
+	return blocks;
+}
+
+bool isImageFile(const std::filesystem::path &path) {
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
+		   extension == ".tga" || extension == ".bmp";
+}
+
+}  // namespace
+
+// *************** Mapped Texture *********************
+
+TextureCooker::MappedTexture::MappedTexture(const std::filesystem::path &cachePath) {
+#ifdef LVR_TEXTURE_CACHE_MMAP
+	int fd = open(cachePath.c_str(), O_RDONLY);
+	if (fd < 0) return;
+
+	struct stat fileStat {};
+	if (fstat(fd, &fileStat) == 0 && fileStat.st_size >= static_cast<off_t>(sizeof(Ktx2Header))) {
+		void *ptr = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED) {
+			data = static_cast<const std::byte *>(ptr);
+			size = static_cast<size_t>(fileStat.st_size);
+			mapped = true;
+		}
+	}
+	close(fd);
+#else
+	std::ifstream file{cachePath, std::ios::ate | std::ios::binary};
+	if (!file.is_open()) return;
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	if (fileSize < sizeof(Ktx2Header)) return;
+
+	fallbackData.resize(fileSize);
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(fallbackData.data()), fileSize);
+	data = fallbackData.data();
+	size = fileSize;
+#endif
+}
+
+TextureCooker::MappedTexture::~MappedTexture() {
+#ifdef LVR_TEXTURE_CACHE_MMAP
+	if (mapped) {
+		munmap(const_cast<std::byte *>(data), size);
+	}
+#endif
+}
+
+std::span<const std::byte> TextureCooker::MappedTexture::levelData() const {
+	return {data + dataBegin, static_cast<size_t>(dataEnd - dataBegin)};
+}
+
+uint64_t TextureCooker::MappedTexture::getLevelOffset(uint32_t level) const {
+	return levelOffsets[level];
+}
+
+uint64_t TextureCooker::MappedTexture::getLevelSize(uint32_t level) const {
+	return levelSizes[level];
+}
+
+bool TextureCooker::MappedTexture::parse(
+	uint64_t pathHash,
+	uint64_t sourceSize,
+	int64_t sourceModifiedTime,
+	Usage usage) {
+	if (data == nullptr) return false;
+
+	Ktx2Header header;
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 ||
+		(header.vkFormat != VK_FORMAT_BC7_SRGB_BLOCK &&
+		 header.vkFormat != VK_FORMAT_BC5_UNORM_BLOCK) ||
+		header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 ||
+		header.layerCount != 0 || header.faceCount != 1 || header.levelCount == 0 ||
+		header.levelCount > 32 || header.supercompressionScheme != 0) {
+		return false;
+	}
+	if (sizeof(Ktx2Header) + header.levelCount * sizeof(Ktx2Level) > size ||
+		static_cast<uint64_t>(header.kvdByteOffset) + header.kvdByteLength > size) {
+		return false;
+	}
+
+	// the source key entry has to match the source as it is now and the usage it is loaded for
+	bool sourceMatches = false;
+	for (uint64_t offset = header.kvdByteOffset;
+		 offset + sizeof(uint32_t) <= header.kvdByteOffset + header.kvdByteLength;) {
+		uint32_t length;
+		std::memcpy(&length, data + offset, sizeof(length));
+		offset += sizeof(length);
+		if (offset + length > header.kvdByteOffset + header.kvdByteLength) return false;
+
+		if (length == sizeof(SOURCE_KEY_NAME) + sizeof(SourceKey) &&
+			std::memcmp(data + offset, SOURCE_KEY_NAME, sizeof(SOURCE_KEY_NAME)) == 0) {
+			SourceKey key;
+			std::memcpy(&key, data + offset + sizeof(SOURCE_KEY_NAME), sizeof(key));
+			sourceMatches = key.pathHash == pathHash && key.sourceSize == sourceSize &&
+							key.sourceModifiedTime == sourceModifiedTime &&
+							key.version == VERSION && key.usage == static_cast<uint32_t>(usage);
+		}
+		offset = alignOffset(offset + length, 4);
+	}
+	if (!sourceMatches) return false;
+
+	std::vector<Ktx2Level> levels(header.levelCount);
+	std::memcpy(levels.data(), data + sizeof(Ktx2Header), levels.size() * sizeof(Ktx2Level));
+	dataBegin = UINT64_MAX;
+	dataEnd = 0;
+	for (uint32_t level = 0; level < header.levelCount; level++) {
+		const Ktx2Level &entry = levels[level];
+		if (entry.byteOffset % BLOCK_BYTES != 0 || entry.byteOffset + entry.byteLength > size ||
+			entry.byteLength !=
+				getCompressedLevelSize(header.pixelWidth, header.pixelHeight, level)) {
+			return false;
+		}
+		dataBegin = std::min(dataBegin, entry.byteOffset);
+		dataEnd = std::max(dataEnd, entry.byteOffset + entry.byteLength);
+	}
+	for (const Ktx2Level &entry : levels) {
+		levelOffsets.push_back(entry.byteOffset - dataBegin);
+		levelSizes.push_back(entry.byteLength);
+	}
+
+	format = static_cast<VkFormat>(header.vkFormat);
+	width = header.pixelWidth;
+	height = header.pixelHeight;
+	levelCount = header.levelCount;
+	return true;
+}
+
+// *************** Texture Cooker *********************
+
+std::filesystem::path TextureCooker::getCachePath(const std::string &sourcePath, Usage usage) {
+	char hashString[17];
+	snprintf(
+		hashString,
+		sizeof(hashString),
+		"%016llx",
+		static_cast<unsigned long long>(hashPath(canonicalPath(sourcePath))));
+
+	std::filesystem::path source{sourcePath};
+	const char *usageSuffix = usage == Usage::Color ? "-color" : "-normal";
+	return getCacheDirectory() /
+		   (source.stem().string() + "-" + hashString + usageSuffix + ".ktx2");
+}
+
+TextureCooker::Usage TextureCooker::usageFromPath(const std::filesystem::path &sourcePath) {
+	std::string stem = sourcePath.stem().string();
+	std::transform(stem.begin(), stem.end(), stem.begin(), ::tolower);
+	auto endsWith = [&stem](const std::string &suffix) {
+		return stem.size() >= suffix.size() &&
+			   stem.compare(stem.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+	return endsWith("_normal") || endsWith("_n") || endsWith("_nrm") ? Usage::Normal
+																	 : Usage::Color;
+}
+
+uint32_t TextureCooker::getMipLevelCount(uint32_t width, uint32_t height) {
+	return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+}
+
+std::vector<uint8_t> TextureCooker::createMipChain(
+	const uint8_t *pixels,
+	uint32_t width,
+	uint32_t height,
+	Usage usage,
+	std::vector<uint64_t> &levelOffsets) {
+	uint32_t levelCount = getMipLevelCount(width, height);
+	std::vector<uint8_t> mipChain{};
+	levelOffsets.clear();
+
+	Level level = decodeLevel(pixels, width, height, usage);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		if (i > 0) level = downsample(level, usage);
+		std::vector<uint8_t> texels = encodeLevel(level, usage);
+		levelOffsets.push_back(mipChain.size());
+		mipChain.insert(mipChain.end(), texels.begin(), texels.end());
+	}
+	return mipChain;
+}
+
+std::unique_ptr<TextureCooker::MappedTexture> TextureCooker::load(
+	const std::string &sourcePath, Usage usage) {
+	SourceKey sourceKey{};
+	if (!fillSourceKey(sourcePath, sourceKey)) return nullptr;
+
+	auto texture = std::make_unique<MappedTexture>(getCachePath(sourcePath, usage));
+	if (!texture->parse(
+			sourceKey.pathHash,
+			sourceKey.sourceSize,
+			sourceKey.sourceModifiedTime,
+			usage)) {
+		return nullptr;
+	}
+	return texture;
+}
+
+bool TextureCooker::cook(const std::string &sourcePath, Usage usage) {
+	auto start = std::chrono::high_resolution_clock::now();
+	SourceKey sourceKey{};
+	if (!fillSourceKey(sourcePath, sourceKey)) return false;
+	sourceKey.usage = static_cast<uint32_t>(usage);
+
+	int texWidth, texHeight, texChannels;
+	stbi_uc *pixels =
+		stbi_load(sourcePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	if (!pixels) {
+		std::cerr << "failed to cook " << sourcePath << ": " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+	uint32_t width = static_cast<uint32_t>(texWidth);
+	uint32_t height = static_cast<uint32_t>(texHeight);
+	std::vector<uint64_t> texelOffsets{};
+	std::vector<uint8_t> mipChain = createMipChain(pixels, width, height, usage, texelOffsets);
+	stbi_image_free(pixels);
+
+	VkFormat format =
+		usage == Usage::Color ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC5_UNORM_BLOCK;
+	uint32_t levelCount = static_cast<uint32_t>(texelOffsets.size());
+	std::vector<std::vector<uint8_t>> levelBlocks{};
+	for (uint32_t i = 0; i < levelCount; i++) {
+		levelBlocks.push_back(compressLevel(
+			mipChain.data() + texelOffsets[i],
+			std::max(1u, width >> i),
+			std::max(1u, height >> i),
+			format));
+	}
+
+	std::vector<uint32_t> dfd = createDataFormatDescriptor(format);
+	std::vector<uint8_t> kvd{};
+	const char writer[] = "littlevulkanrenderer texture cooker";
+	appendKeyValue(kvd, "KTXwriter", writer, sizeof(writer));
+	appendKeyValue(kvd, SOURCE_KEY_NAME, &sourceKey, sizeof(sourceKey));
+
+	Ktx2Header header{};
+	std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = format;
+	header.typeSize = 1;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.faceCount = 1;
+	header.levelCount = levelCount;
+	header.dfdByteOffset =
+		static_cast<uint32_t>(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level));
+	header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+	header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+	header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+	// KTX2 stores the smallest level first
+	std::vector<Ktx2Level> levels(levelCount);
+	uint64_t offset = alignOffset(header.kvdByteOffset + header.kvdByteLength, BLOCK_BYTES);
+	for (uint32_t i = levelCount; i-- > 0;) {
+		levels[i] = {offset, levelBlocks[i].size(), levelBlocks[i].size()};
+		offset += levelBlocks[i].size();
+	}
+
+	std::filesystem::path cachePath = getCachePath(sourcePath, usage);
+	std::error_code ec;
+	std::filesystem::create_directories(cachePath.parent_path(), ec);
+
+	// write next to the final file and rename so readers never map a half written texture
+	std::filesystem::path tempPath = cachePath;
+	tempPath += ".tmp";
+	{
+		std::ofstream out{tempPath, std::ios::out | std::ios::binary | std::ios::trunc};
+		if (!out.is_open()) {
+			std::cerr << "failed to write cooked texture " << cachePath << std::endl;
+			return false;
+		}
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char *>(levels.data()), levels.size() * sizeof(Ktx2Level));
+		out.write(reinterpret_cast<const char *>(dfd.data()), header.dfdByteLength);
+		out.write(reinterpret_cast<const char *>(kvd.data()), kvd.size());
+
+		uint64_t headerEnd = header.kvdByteOffset + kvd.size();
+		std::vector<char> padding(levels.back().byteOffset - headerEnd, 0);
+		out.write(padding.data(), padding.size());
+		for (uint32_t i = levelCount; i-- > 0;) {
+			out.write(reinterpret_cast<const char *>(levelBlocks[i].data()), levelBlocks[i].size());
+		}
+	}
+
+	std::filesystem::rename(tempPath, cachePath, ec);
+	if (ec) {
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "cooked " << sourcePath << ": " << width << "x" << height << ", " << levelCount
+			  << " mips, " << (usage == Usage::Color ? "BC7" : "BC5") << ", " << offset / 1024
+			  << " KiB in " << std::chrono::duration<double, std::milli>(end - start).count()
+			  << " ms" << std::endl;
+	return true;
+}
+
+bool TextureCooker::cookDirectory(const std::filesystem::path &directory) {
+	utils::ThreadPool pool{};
+	std::vector<std::future<bool>> results{};
+	uint32_t upToDate = 0;
+
+	std::error_code ec;
+	for (auto it = std::filesystem::recursive_directory_iterator(directory, ec);
+		 it != std::filesystem::recursive_directory_iterator();
+		 it.increment(ec)) {
+		if (ec) break;
+		if (it->is_directory() && it->path().filename() == "cache") {
+			it.disable_recursion_pending();
+			continue;
+		}
+		if (!it->is_regular_file() || !isImageFile(it->path())) continue;
+
+		std::string sourcePath = it->path().string();
+		Usage usage = usageFromPath(sourcePath);
+		if (load(sourcePath, usage) != nullptr) {
+			upToDate++;
+			continue;
+		}
+		results.push_back(pool.submit([sourcePath, usage]() { return cook(sourcePath, usage); }));
+	}
+	if (ec) {
+		std::cerr << "failed to read " << directory << ": " << ec.message() << std::endl;
+		return false;
+	}
+
+	uint32_t failed = 0;
+	for (auto &result : results) {
+		if (!result.get()) failed++;
+	}
+	std::cout << "cooked " << results.size() - failed << " textures, " << upToDate
+			  << " up to date, " << failed << " failed" << std::endl;
+	return failed == 0;
+}
+
+}  // namespace lvr
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace lvr {
+
+// Offline texture cooking. A source image is decoded once, given a full mip chain and encoded to
+// block compressed texels, BC7 for color and BC5 for normal maps, then stored as a KTX2 file under
+// textures/cache/. At runtime the cooked file is memory mapped and its blocks are uploaded as they
+// are. A cooked file is only used while its source still has the same path, size and modification
+// time and was cooked for the same usage, anything else falls back to decoding the source.
+class TextureCooker {
+   public:
+	static constexpr uint32_t VERSION = 1;
+
+	enum class Usage {
+		// sRGB color with alpha, BC7
+		Color,
+		// tangent space normals, BC5 keeps x and y and shaders rebuild z
+		Normal,
+	};
+
+	class MappedTexture {
+	   public:
+		MappedTexture(const std::filesystem::path &cachePath);
+		~MappedTexture();
+
+		MappedTexture(const MappedTexture &) = delete;
+		MappedTexture &operator=(const MappedTexture &) = delete;
+
+		bool isValid() const { return levelCount > 0; }
+		VkFormat getFormat() const { return format; }
+		uint32_t getWidth() const { return width; }
+		uint32_t getHeight() const { return height; }
+		uint32_t getLevelCount() const { return levelCount; }
+
+		// Every level's blocks, smallest level first as KTX2 lays them out
+		std::span<const std::byte> levelData() const;
+		// Offset of `level` into levelData()
+		uint64_t getLevelOffset(uint32_t level) const;
+		uint64_t getLevelSize(uint32_t level) const;
+
+	   private:
+		bool parse(
+			uint64_t pathHash,
+			uint64_t sourceSize,
+			int64_t sourceModifiedTime,
+			Usage usage);
+
+		const std::byte *data = nullptr;
+		size_t size = 0;
+		bool mapped = false;
+		std::vector<std::byte> fallbackData{};
+
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t levelCount = 0;
+		std::vector<uint64_t> levelOffsets{};
+		std::vector<uint64_t> levelSizes{};
+		uint64_t dataBegin = 0;
+		uint64_t dataEnd = 0;
+
+		friend class TextureCooker;
+	};
+
+	// Returns the mapped texture cooked from the source file for `usage`, or nullptr when it is
+	// missing or stale
+	static std::unique_ptr<MappedTexture> load(const std::string &sourcePath, Usage usage);
+	// Cooks one source image, returns false when it couldn't be decoded or written
+	static bool cook(const std::string &sourcePath, Usage usage);
+	// Cooks every image in `directory` that has no up to date cooked file, in parallel. Returns
+	// false when any of them failed.
+	static bool cookDirectory(const std::filesystem::path &directory);
+
+	// Full mip chain of tightly packed RGBA8 levels, largest first. Color is filtered in linear
+	// space, normals are renormalized. `levelOffsets` receives each level's offset.
+	static std::vector<uint8_t> createMipChain(
+		const uint8_t *pixels,
+		uint32_t width,
+		uint32_t height,
+		Usage usage,
+		std::vector<uint64_t> &levelOffsets);
+	// log2(max(width, height)) + 1
+	static uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+	// Normal maps are recognised by name, e.g. brick_normal.png or brick_n.png
+	static Usage usageFromPath(const std::filesystem::path &sourcePath);
+	// Each usage of a source gets its own cooked file
+	static std::filesystem::path getCachePath(const std::string &sourcePath, Usage usage);
+	static std::filesystem::path getCacheDirectory() { return "textures/cache/"; }
+};
+
+}  // namespace lvr
@@ -0,0 +1,234 @@
+#include "transform_kernel.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "gameobject.h"
+
+namespace lvr {
+
+namespace {
+
+GameObjectBufferData *outputAt(GameObjectBufferData *matrices, size_t stride, uint32_t index) {
+	return reinterpret_cast<GameObjectBufferData *>(
+		reinterpret_cast<char *>(matrices) + static_cast<size_t>(index) * stride);
+}
+
+#ifdef __AVX2__
+struct SinCos8 {
+	__m256 sin;
+	__m256 cos;
+};
+
+// Cephes style sincos of 8 floats. The angle is reduced by the nearest multiple of pi/2 in three
+// parts, both polynomials are evaluated on [-pi/4, pi/4] and the quadrant picks and negates them.
+// Accurate to a couple of ulp for the angles game objects are rotated by.
+SinCos8 sincos8(__m256 x) {
+	const __m256 quadrant = _mm256_round_ps(
+		_mm256_mul_ps(x, _mm256_set1_ps(0.636619772367581f)),
+		_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_fnmadd_ps(quadrant, _mm256_set1_ps(1.5703125f), x);
+	r = _mm256_fnmadd_ps(quadrant, _mm256_set1_ps(4.837512969970703125e-4f), r);
+	r = _mm256_fnmadd_ps(quadrant, _mm256_set1_ps(7.54978995489188216e-8f), r);
+	const __m256 r2 = _mm256_mul_ps(r, r);
+
+	__m256 s = _mm256_fmadd_ps(
+		_mm256_set1_ps(-1.9515295891e-4f), r2, _mm256_set1_ps(8.3321608736e-3f));
+	s = _mm256_fmadd_ps(s, r2, _mm256_set1_ps(-1.6666654611e-1f));
+	s = _mm256_fmadd_ps(_mm256_mul_ps(s, r2), r, r);
+
+	__m256 c = _mm256_fmadd_ps(
+		_mm256_set1_ps(2.443315711809948e-5f), r2, _mm256_set1_ps(-1.388731625493765e-3f));
+	c = _mm256_fmadd_ps(c, r2, _mm256_set1_ps(4.166664568298827e-2f));
+	c = _mm256_fmadd_ps(
+		_mm256_mul_ps(c, r2), r2, _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), r2, _mm256_set1_ps(1.0f)));
+
+	// odd quadrants swap sin and cos, sin is negative in quadrants 2 and 3, cos in 1 and 2
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i two = _mm256_set1_epi32(2);
+	const __m256i q = _mm256_cvtps_epi32(quadrant);
+	const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, one), one));
+	const __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, two), 30));
+	const __m256 cosSign = _mm256_castsi256_ps(
+		_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, one), two), 30));
+	return {
+		_mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sinSign),
+		_mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosSign)};
+}
+
+// rows[i] holds component i of 8 objects, afterwards rows[i] holds the 8 components of object i
+void transpose8(__m256 rows[8]) {
+	const __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+	const __m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+	const __m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+	const __m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+	const __m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]);
+	const __m256 t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+	const __m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]);
+	const __m256 t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+	const __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	rows[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+	rows[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+	rows[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+	rows[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+	rows[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+	rows[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+	rows[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+	rows[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+// Transposes 8 half matrices (two columns each) and stores them `offset` bytes into each output
+void storeHalves(
+	__m256 rows[8], GameObjectBufferData *matrices, size_t stride, uint32_t first, size_t offset) {
+	transpose8(rows);
+	for (uint32_t lane = 0; lane < 8; lane++) {
+		char *output = reinterpret_cast<char *>(outputAt(matrices, stride, first + lane));
+		_mm256_storeu_ps(reinterpret_cast<float *>(output + offset), rows[lane]);
+	}
+}
+#endif
+
+}  // namespace
+
+void computeTransformMatricesScalar(
+	const glm::vec3 *translations,
+	const glm::vec3 *rotations,
+	const glm::vec3 *scales,
+	uint32_t count,
+	GameObjectBufferData *matrices,
+	size_t stride) {
+	for (uint32_t i = 0; i < count; i++) {
+		const glm::vec3 &rotation = rotations[i];
+		const float c3 = glm::cos(rotation.z);
+		const float s3 = glm::sin(rotation.z);
+		const float c2 = glm::cos(rotation.x);
+		const float s2 = glm::sin(rotation.x);
+		const float c1 = glm::cos(rotation.y);
+		const float s1 = glm::sin(rotation.y);
+		const glm::vec3 column0{c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1};
+		const glm::vec3 column1{c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3};
+		const glm::vec3 column2{c2 * s1, -s2, c1 * c2};
+
+		const glm::vec3 &scale = scales[i];
+		const glm::vec3 invScale = 1.0f / scale;
+		GameObjectBufferData *output = outputAt(matrices, stride, i);
+		output->modelMatrix = glm::mat4{
+			glm::vec4{scale.x * column0, 0.0f},
+			glm::vec4{scale.y * column1, 0.0f},
+			glm::vec4{scale.z * column2, 0.0f},
+			glm::vec4{translations[i], 1.0f}};
+		output->normalMatrix = glm::mat4{
+			glm::vec4{invScale.x * column0, 0.0f},
+			glm::vec4{invScale.y * column1, 0.0f},
+			glm::vec4{invScale.z * column2, 0.0f},
+			glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+	}
+}
+
+void computeTransformMatrices(
+	const glm::vec3 *translations,
+	const glm::vec3 *rotations,
+	const glm::vec3 *scales,
+	uint32_t count,
+	GameObjectBufferData *matrices,
+	size_t stride) {
+	uint32_t i = 0;
+#ifdef __AVX2__
+	// the inputs are packed vec3s, gather every component of 8 objects into its own register
+	const __m256i lanes = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	auto gather = [&](const glm::vec3 *values, int component) {
+		return _mm256_i32gather_ps(&values[i].x + component, lanes, sizeof(float));
+	};
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	for (; i + 8 <= count; i += 8) {
+		const auto [s2, c2] = sincos8(gather(rotations, 0));
+		const auto [s1, c1] = sincos8(gather(rotations, 1));
+		const auto [s3, c3] = sincos8(gather(rotations, 2));
+		const __m256 s1s2 = _mm256_mul_ps(s1, s2);
+		const __m256 c1s2 = _mm256_mul_ps(c1, s2);
+		const __m256 rotation[9] = {
+			_mm256_fmadd_ps(s1s2, s3, _mm256_mul_ps(c1, c3)),
+			_mm256_mul_ps(c2, s3),
+			_mm256_fmsub_ps(c1s2, s3, _mm256_mul_ps(c3, s1)),
+			_mm256_fmsub_ps(c3, s1s2, _mm256_mul_ps(c1, s3)),
+			_mm256_mul_ps(c2, c3),
+			_mm256_fmadd_ps(c1s2, c3, _mm256_mul_ps(s1, s3)),
+			_mm256_mul_ps(c2, s1),
+			_mm256_sub_ps(zero, s2),
+			_mm256_mul_ps(c1, c2)};
+
+		const __m256 scale[3] = {gather(scales, 0), gather(scales, 1), gather(scales, 2)};
+		const __m256 invScale[3] = {
+			_mm256_div_ps(one, scale[0]),
+			_mm256_div_ps(one, scale[1]),
+			_mm256_div_ps(one, scale[2])};
+		auto scaled = [&](const __m256 *factors, int column, int row) {
+			return _mm256_mul_ps(factors[column], rotation[column * 3 + row]);
+		};
+
+		__m256 model01[8] = {
+			scaled(scale, 0, 0),
+			scaled(scale, 0, 1),
+			scaled(scale, 0, 2),
+			zero,
+			scaled(scale, 1, 0),
+			scaled(scale, 1, 1),
+			scaled(scale, 1, 2),
+			zero};
+		__m256 model23[8] = {
+			scaled(scale, 2, 0),
+			scaled(scale, 2, 1),
+			scaled(scale, 2, 2),
+			zero,
+			gather(translations, 0),
+			gather(translations, 1),
+			gather(translations, 2),
+			one};
+		__m256 normal01[8] = {
+			scaled(invScale, 0, 0),
+			scaled(invScale, 0, 1),
+			scaled(invScale, 0, 2),
+			zero,
+			scaled(invScale, 1, 0),
+			scaled(invScale, 1, 1),
+			scaled(invScale, 1, 2),
+			zero};
+		__m256 normal23[8] = {
+			scaled(invScale, 2, 0),
+			scaled(invScale, 2, 1),
+			scaled(invScale, 2, 2),
+			zero,
+			zero,
+			zero,
+			zero,
+			one};
+
+		constexpr size_t modelOffset = offsetof(GameObjectBufferData, modelMatrix);
+		constexpr size_t normalOffset = offsetof(GameObjectBufferData, normalMatrix);
+		constexpr size_t halfSize = 8 * sizeof(float);
+		storeHalves(model01, matrices, stride, i, modelOffset);
+		storeHalves(model23, matrices, stride, i, modelOffset + halfSize);
+		storeHalves(normal01, matrices, stride, i, normalOffset);
+		storeHalves(normal23, matrices, stride, i, normalOffset + halfSize);
+	}
+#endif
+	computeTransformMatricesScalar(
+		translations + i,
+		rotations + i,
+		scales + i,
+		count - i,
+		outputAt(matrices, stride, i),
+		stride);
+}
+
+}  // namespace lvr
@@ -0,0 +1,559 @@
+#include "upload_queue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include "buffer.h"
+#include "device.h"
+
+namespace lvr {
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+UploadQueue::UploadQueue(Device &device, VkDeviceSize arenaSize) : lvrDevice{device} {
+	createCommandPools();
+	createArena(arenaSize);
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+	if (vkCreateSemaphore(lvrDevice.device(), &semaphoreInfo, nullptr, &timelineSemaphore) !=
+		VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload timeline semaphore!");
+	}
+}
+
+UploadQueue::~UploadQueue() {
+	waitIdle();
+	for (auto &batch : freeBatches) {
+		vkDestroyFence(lvrDevice.device(), batch.fence, nullptr);
+		vkFreeCommandBuffers(lvrDevice.device(), commandPool, 1, &batch.commandBuffer);
+		if (dedicatedTransfer) {
+			vkDestroySemaphore(lvrDevice.device(), batch.transferSemaphore, nullptr);
+			vkFreeCommandBuffers(
+				lvrDevice.device(),
+				transferCommandPool,
+				1,
+				&batch.transferCommandBuffer);
+		}
+	}
+	vkDestroySemaphore(lvrDevice.device(), timelineSemaphore, nullptr);
+	vkDestroyBuffer(lvrDevice.device(), arenaBuffer, nullptr);
+	lvrDevice.allocator().free(arenaAllocation);
+	vkDestroyCommandPool(lvrDevice.device(), commandPool, nullptr);
+	if (dedicatedTransfer) {
+		vkDestroyCommandPool(lvrDevice.device(), transferCommandPool, nullptr);
+	}
+}
+
+void UploadQueue::createCommandPools() {
+	QueueFamilyIndices queueFamilyIndices = lvrDevice.findPhysicalQueueFamilies();
+	graphicsFamily = queueFamilyIndices.graphicsAndComputeFamily.value();
+	transferFamily = queueFamilyIndices.transferFamily.value_or(graphicsFamily);
+	dedicatedTransfer = lvrDevice.hasDedicatedTransferQueue();
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = graphicsFamily;
+	poolInfo.flags =
+		VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(lvrDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload queue command pool!");
+	}
+
+	if (dedicatedTransfer) {
+		poolInfo.queueFamilyIndex = transferFamily;
+		if (vkCreateCommandPool(lvrDevice.device(), &poolInfo, nullptr, &transferCommandPool) !=
+			VK_SUCCESS) {
+			throw std::runtime_error("failed to create transfer command pool!");
+		}
+	}
+}
+
+void UploadQueue::createArena(VkDeviceSize size) {
+	arenaSize = size;
+	// keeps every staging offset valid for buffer to image copies of any texel size
+	arenaAlignment = std::max<VkDeviceSize>(
+		16,
+		lvrDevice.properties.limits.optimalBufferCopyOffsetAlignment);
+
+	lvrDevice.createBuffer(
+		arenaSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		arenaBuffer,
+		arenaAllocation);
+}
+
+VkCommandBuffer UploadQueue::allocateCommandBuffer(VkCommandPool pool) {
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = pool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(lvrDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate upload command buffer!");
+	}
+	return commandBuffer;
+}
+
+void UploadQueue::beginBatch() {
+	if (!freeBatches.empty()) {
+		openBatch = std::move(freeBatches.back());
+		freeBatches.pop_back();
+		vkResetCommandBuffer(openBatch.commandBuffer, 0);
+		if (dedicatedTransfer) vkResetCommandBuffer(openBatch.transferCommandBuffer, 0);
+		vkResetFences(lvrDevice.device(), 1, &openBatch.fence);
+	} else {
+		openBatch.commandBuffer = allocateCommandBuffer(commandPool);
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(lvrDevice.device(), &fenceInfo, nullptr, &openBatch.fence) !=
+			VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+
+		if (dedicatedTransfer) {
+			openBatch.transferCommandBuffer = allocateCommandBuffer(transferCommandPool);
+
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			if (vkCreateSemaphore(
+					lvrDevice.device(),
+					&semaphoreInfo,
+					nullptr,
+					&openBatch.transferSemaphore) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create upload semaphore!");
+			}
+		}
+	}
+
+	openBatch.ticket = nextTicket;
+	openBatch.arenaBytes = 0;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(openBatch.commandBuffer, &beginInfo);
+	if (dedicatedTransfer) vkBeginCommandBuffer(openBatch.transferCommandBuffer, &beginInfo);
+}
+
+VkCommandBuffer UploadQueue::getCommandBuffer() {
+	if (openBatch.commandBuffer == VK_NULL_HANDLE) beginBatch();
+	return openBatch.commandBuffer;
+}
+
+bool UploadQueue::tryAllocateArena(VkDeviceSize size, VkDeviceSize &offset) {
+	if (arenaUsed == 0) {
+		arenaHead = 0;
+		arenaTail = 0;
+	}
+
+	VkDeviceSize start = alignUp(arenaHead, arenaAlignment);
+	VkDeviceSize padding = 0;
+	if (arenaUsed == 0 || arenaHead > arenaTail) {
+		// free space is [head, end) and [0, tail)
+		if (start + size <= arenaSize) {
+			offset = start;
+			padding = start - arenaHead;
+		} else if (size <= arenaTail) {
+			offset = 0;
+			padding = arenaSize - arenaHead;
+		} else {
+			return false;
+		}
+	} else {
+		// free space is [head, tail), empty when the ring is full
+		if (start + size > arenaTail) return false;
+		offset = start;
+		padding = start - arenaHead;
+	}
+
+	arenaHead = offset + size;
+	arenaUsed += padding + size;
+	getCommandBuffer();
+	openBatch.arenaBytes += padding + size;
+	return true;
+}
+
+VkCommandBuffer UploadQueue::stage(
+	const void *data,
+	VkDeviceSize size,
+	VkBuffer &stagingBuffer,
+	VkDeviceSize &stagingOffset) {
+	if (size > arenaSize) {
+		Allocation allocation{};
+		lvrDevice.createBuffer(
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer,
+			allocation);
+		memcpy(allocation.mapped, data, static_cast<size_t>(size));
+		stagingOffset = 0;
+
+		getCommandBuffer();
+		openBatch.overflowBuffers.emplace_back(stagingBuffer, allocation);
+		return dedicatedTransfer ? openBatch.transferCommandBuffer : openBatch.commandBuffer;
+	}
+
+	// make room by pushing out what is recorded so far and waiting on the oldest batches
+	while (!tryAllocateArena(size, stagingOffset)) {
+		if (openBatch.arenaBytes > 0) {
+			submit();
+		} else {
+			retireBatches(true);
+		}
+	}
+
+	memcpy(static_cast<char *>(arenaAllocation.mapped) + stagingOffset, data, size);
+	stagingBuffer = arenaBuffer;
+	return dedicatedTransfer ? openBatch.transferCommandBuffer : openBatch.commandBuffer;
+}
+
+void UploadQueue::uploadBuffer(
+	Buffer &dstBuffer,
+	const void *data,
+	VkDeviceSize size,
+	VkDeviceSize dstOffset) {
+	if (size == 0) return;
+
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	VkCommandBuffer commandBuffer = stage(data, size, stagingBuffer, stagingOffset);
+
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = stagingOffset;
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, dstBuffer.getBuffer(), 1, &copyRegion);
+
+	if (dstBuffer.getSharingMode() == VK_SHARING_MODE_EXCLUSIVE) {
+		transferOwnership(dstBuffer.getBuffer(), dstOffset, size);
+	}
+}
+
+void UploadQueue::uploadImage(
+	VkImage image,
+	const void *data,
+	VkDeviceSize size,
+	uint32_t width,
+	uint32_t height,
+	uint32_t layerCount,
+	uint32_t mipLevels) {
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	VkCommandBuffer commandBuffer = stage(data, size, stagingBuffer, stagingOffset);
+
+	VkImageSubresourceRange range{};
+	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.baseMipLevel = 0;
+	range.levelCount = mipLevels;
+	range.baseArrayLayer = 0;
+	range.layerCount = layerCount;
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = stagingOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = layerCount;
+
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {width, height, 1};
+
+	copyToImage(commandBuffer, stagingBuffer, image, range, {region});
+}
+
+void UploadQueue::uploadImageLevels(
+	VkImage image,
+	const void *data,
+	VkDeviceSize size,
+	uint32_t width,
+	uint32_t height,
+	std::span<const uint64_t> levelOffsets) {
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	VkCommandBuffer commandBuffer = stage(data, size, stagingBuffer, stagingOffset);
+
+	VkImageSubresourceRange range{};
+	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.baseMipLevel = 0;
+	range.levelCount = static_cast<uint32_t>(levelOffsets.size());
+	range.baseArrayLayer = 0;
+	range.layerCount = 1;
+
+	std::vector<VkBufferImageCopy> regions(levelOffsets.size());
+	for (uint32_t level = 0; level < regions.size(); level++) {
+		VkBufferImageCopy &region = regions[level];
+		region.bufferOffset = stagingOffset + levelOffsets[level];
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = {std::max(1u, width >> level), std::max(1u, height >> level), 1};
+	}
+
+	copyToImage(commandBuffer, stagingBuffer, image, range, regions);
+}
+
+void UploadQueue::copyToImage(
+	VkCommandBuffer commandBuffer,
+	VkBuffer stagingBuffer,
+	VkImage image,
+	const VkImageSubresourceRange &range,
+	const std::vector<VkBufferImageCopy> &regions) {
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0,
+		nullptr,
+		0,
+		nullptr,
+		1,
+		&barrier);
+
+	vkCmdCopyBufferToImage(
+		commandBuffer,
+		stagingBuffer,
+		image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()),
+		regions.data());
+
+	transferOwnership(image, range);
+}
+
+void UploadQueue::transferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+	if (!dedicatedTransfer) return;
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	// release, the access masks of the other queue are ignored
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(
+		openBatch.transferCommandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0,
+		nullptr,
+		1,
+		&barrier,
+		0,
+		nullptr);
+
+	// acquire, visibility for the readers comes from the end of batch barrier
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(
+		openBatch.commandBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0,
+		nullptr,
+		1,
+		&barrier,
+		0,
+		nullptr);
+}
+
+void UploadQueue::transferOwnership(VkImage image, const VkImageSubresourceRange &range) {
+	if (!dedicatedTransfer) return;
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(
+		openBatch.transferCommandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0,
+		nullptr,
+		0,
+		nullptr,
+		1,
+		&barrier);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(
+		openBatch.commandBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0,
+		nullptr,
+		0,
+		nullptr,
+		1,
+		&barrier);
+}
+
+UploadQueue::Ticket UploadQueue::submit() {
+	retireBatches(false);
+	if (openBatch.commandBuffer == VK_NULL_HANDLE) return nextTicket - 1;
+
+	// one barrier for the whole batch instead of one per copy
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+							VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+							VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(
+		openBatch.commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0,
+		1,
+		&barrier,
+		0,
+		nullptr,
+		0,
+		nullptr);
+	vkEndCommandBuffer(openBatch.commandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+	// the staged copies go first on the transfer queue, the graphics side waits for them
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	if (dedicatedTransfer) {
+		vkEndCommandBuffer(openBatch.transferCommandBuffer);
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &openBatch.transferCommandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &openBatch.transferSemaphore;
+		if (vkQueueSubmit(lvrDevice.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) !=
+			VK_SUCCESS) {
+			throw std::runtime_error("failed to submit transfer command buffer!");
+		}
+
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &openBatch.transferSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+	}
+
+	// other queues wait for the batch on the timeline reaching its ticket
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &openBatch.ticket;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &timelineSemaphore;
+
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &openBatch.commandBuffer;
+	if (vkQueueSubmit(lvrDevice.graphicsQueue(), 1, &submitInfo, openBatch.fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload command buffer!");
+	}
+
+	openBatch.arenaEnd = arenaHead;
+	inFlightBatches.push_back(std::move(openBatch));
+	openBatch = Batch{};
+	return nextTicket++;
+}
+
+bool UploadQueue::isComplete(Ticket ticket) {
+	retireBatches(false);
+	return ticket <= completedTicket;
+}
+
+void UploadQueue::wait(Ticket ticket) {
+	if (ticket >= nextTicket) submit();
+	while (completedTicket < ticket && !inFlightBatches.empty()) {
+		retireBatches(true);
+	}
+}
+
+void UploadQueue::waitIdle() {
+	submit();
+	while (!inFlightBatches.empty()) {
+		retireBatches(true);
+	}
+}
+
+void UploadQueue::retireBatches(bool waitForOldest) {
+	if (waitForOldest && !inFlightBatches.empty()) {
+		vkWaitForFences(
+			lvrDevice.device(),
+			1,
+			&inFlightBatches.front().fence,
+			VK_TRUE,
+			UINT64_MAX);
+	}
+
+	// batches on one queue complete in submission order
+	while (!inFlightBatches.empty() &&
+		   vkGetFenceStatus(lvrDevice.device(), inFlightBatches.front().fence) == VK_SUCCESS) {
+		Batch &batch = inFlightBatches.front();
+		completedTicket = batch.ticket;
+		arenaUsed -= batch.arenaBytes;
+		arenaTail = batch.arenaEnd;
+
+		releaseBatch(batch);
+		freeBatches.push_back(std::move(batch));
+		inFlightBatches.pop_front();
+	}
+}
+
+void UploadQueue::releaseBatch(Batch &batch) {
+	for (auto &[buffer, allocation] : batch.overflowBuffers) {
+		vkDestroyBuffer(lvrDevice.device(), buffer, nullptr);
+		lvrDevice.allocator().free(allocation);
+	}
+	batch.overflowBuffers.clear();
+}
+
+}  // namespace lvr
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "memory_allocator.h"
+
+namespace lvr {
+
+class Buffer;
+class Device;
+
+// Collects transfers into one command buffer per batch instead of one submit-and-wait per copy.
+// Source data is copied into a persistently mapped ring of staging memory; a batch's part of the
+// ring is reused once the fence of its submission signals. Every batch ends with a barrier that
+// makes its writes visible to all later work on the graphics queue.
+//
+// With a dedicated transfer queue the staged copies run there and the batch's graphics command
+// buffer waits for them on a semaphore. Ownership of every uploaded range is released by the
+// transfer family and acquired by the graphics family before any graphics work of the batch.
+//
+// Not thread safe, record and submit from the render thread. Don't hold on to the handle returned
+// by getCommandBuffer() across other calls: running out of staging space submits the open batch.
+class UploadQueue {
+   public:
+	// Identifies a batch, tickets increase monotonically with every submit.
+	using Ticket = uint64_t;
+
+	static constexpr VkDeviceSize DEFAULT_ARENA_SIZE = 32 * 1024 * 1024;
+
+	UploadQueue(Device &device, VkDeviceSize arenaSize = DEFAULT_ARENA_SIZE);
+	~UploadQueue();
+
+	UploadQueue(const UploadQueue &) = delete;
+	UploadQueue &operator=(const UploadQueue &) = delete;
+
+	// Stages `data` and records a copy into `dstBuffer` at `dstOffset`. Concurrently shared buffers
+	// skip the ownership transfer.
+	void uploadBuffer(
+		Buffer &dstBuffer,
+		const void *data,
+		VkDeviceSize size,
+		VkDeviceSize dstOffset = 0);
+	// Stages tightly packed texels and records a copy into mip 0 of `image`. All `mipLevels` are
+	// moved from an undefined layout to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL first and are left in
+	// that layout for the graphics work of the batch, e.g. mip generation.
+	void uploadImage(
+		VkImage image,
+		const void *data,
+		VkDeviceSize size,
+		uint32_t width,
+		uint32_t height,
+		uint32_t layerCount,
+		uint32_t mipLevels = 1);
+	// Stages every mip level at once and copies level i from `levelOffsets[i]` bytes into `data`.
+	// Levels are tightly packed, block compressed ones as rows of blocks. Leaves the levels in
+	// VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL like uploadImage().
+	void uploadImageLevels(
+		VkImage image,
+		const void *data,
+		VkDeviceSize size,
+		uint32_t width,
+		uint32_t height,
+		std::span<const uint64_t> levelOffsets);
+
+	// Graphics queue command buffer of the open batch, for copies, layout transitions and blits
+	// without staging data. Runs after the batch's staged copies.
+	VkCommandBuffer getCommandBuffer();
+
+	// Ticket the open batch will be submitted with.
+	Ticket getCurrentTicket() const { return nextTicket; }
+	// Ticket of the newest submitted batch, 0 before the first submit.
+	Ticket getSubmittedTicket() const { return nextTicket - 1; }
+	// Timeline semaphore that reaches a batch's ticket once its graphics queue work finished. Work
+	// on other queues that reads uploaded data waits on it, the batch's final barrier only covers
+	// the graphics queue.
+	VkSemaphore getTimelineSemaphore() const { return timelineSemaphore; }
+	bool hasPendingWork() const { return openBatch.commandBuffer != VK_NULL_HANDLE; }
+
+	// Submits the open batch, if any, and returns the ticket of the newest submitted batch.
+	Ticket submit();
+	bool isComplete(Ticket ticket);
+	// Submits first if `ticket` belongs to the open batch.
+	void wait(Ticket ticket);
+	void waitIdle();
+
+   private:
+	struct Batch {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		// only used with a dedicated transfer queue, the staged copies go to commandBuffer otherwise
+		VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+		VkSemaphore transferSemaphore = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		Ticket ticket = 0;
+		// ring position after this batch's data and the bytes it holds, wrap padding included
+		VkDeviceSize arenaEnd = 0;
+		VkDeviceSize arenaBytes = 0;
+		// uploads too large for the ring get their own staging buffer
+		std::vector<std::pair<VkBuffer, Allocation>> overflowBuffers{};
+	};
+
+	void createCommandPools();
+	void createArena(VkDeviceSize arenaSize);
+	VkCommandBuffer allocateCommandBuffer(VkCommandPool pool);
+	void beginBatch();
+	// Returns the command buffer and the staging buffer/offset holding a copy of `data`.
+	VkCommandBuffer stage(
+		const void *data,
+		VkDeviceSize size,
+		VkBuffer &stagingBuffer,
+		VkDeviceSize &stagingOffset);
+	bool tryAllocateArena(VkDeviceSize size, VkDeviceSize &offset);
+	void transferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+	void transferOwnership(VkImage image, const VkImageSubresourceRange &range);
+	// Moves `range` to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, records the copies and hands the
+	// image over to the graphics family
+	void copyToImage(
+		VkCommandBuffer commandBuffer,
+		VkBuffer stagingBuffer,
+		VkImage image,
+		const VkImageSubresourceRange &range,
+		const std::vector<VkBufferImageCopy> &regions);
+	void retireBatches(bool waitForOldest);
+	void releaseBatch(Batch &batch);
+
+	Device &lvrDevice;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+	uint32_t graphicsFamily = 0;
+	uint32_t transferFamily = 0;
+	bool dedicatedTransfer = false;
+
+	VkBuffer arenaBuffer = VK_NULL_HANDLE;
+	Allocation arenaAllocation{};
+	VkDeviceSize arenaSize = 0;
+	VkDeviceSize arenaAlignment = 16;
+	VkDeviceSize arenaHead = 0;
+	VkDeviceSize arenaTail = 0;
+	VkDeviceSize arenaUsed = 0;
+
+	VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+	Batch openBatch{};
+	std::deque<Batch> inFlightBatches{};
+	std::vector<Batch> freeBatches{};
+	Ticket nextTicket = 1;
+	Ticket completedTicket = 0;
+};
+
+}  // namespace lvr
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+// Open addressing hash map with linear probing over a single flat allocation. Meant for hot
+// loops over small trivially copyable keys: there is no erase, and clear() keeps the storage so a
+// map can be reused without touching the allocator. Capacity is a power of two, so `Hash` has to
+// spread entropy into the low bits.
+template <
+	typename Key,
+	typename Value,
+	typename Hash = std::hash<Key>,
+	typename KeyEqual = std::equal_to<Key>>
+class FlatHashMap {
+   public:
+	FlatHashMap() = default;
+	explicit FlatHashMap(size_t expectedCount) { reserve(expectedCount); }
+
+	void reserve(size_t expectedCount) {
+		size_t required = capacityFor(expectedCount);
+		if (required > slots.size()) rehash(required);
+	}
+
+	void clear() {
+		std::fill(used.begin(), used.end(), uint8_t{0});
+		count = 0;
+	}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	// Inserts `value` if `key` is absent. Returns the stored value and whether it was inserted.
+	std::pair<Value *, bool> tryEmplace(const Key &key, const Value &value) {
+		if ((count + 1) * 4 > slots.size() * 3) rehash(std::max<size_t>(16, slots.size() * 2));
+
+		size_t index = hasher(key) & mask;
+		while (used[index]) {
+			if (equal(slots[index].first, key)) return {&slots[index].second, false};
+			index = (index + 1) & mask;
+		}
+
+		used[index] = 1;
+		slots[index] = {key, value};
+		count++;
+		return {&slots[index].second, true};
+	}
+
+	Value *find(const Key &key) {
+		if (slots.empty()) return nullptr;
+
+		size_t index = hasher(key) & mask;
+		while (used[index]) {
+			if (equal(slots[index].first, key)) return &slots[index].second;
+			index = (index + 1) & mask;
+		}
+		return nullptr;
+	}
+
+   private:
+	static size_t capacityFor(size_t expectedCount) {
+		size_t capacity = 16;
+		while (capacity * 3 < expectedCount * 4) capacity *= 2;
+		return capacity;
+	}
+
+	void rehash(size_t newCapacity) {
+		std::vector<std::pair<Key, Value>> oldSlots = std::move(slots);
+		std::vector<uint8_t> oldUsed = std::move(used);
+
+		slots.assign(newCapacity, {});
+		used.assign(newCapacity, 0);
+		mask = newCapacity - 1;
+		count = 0;
+
+		for (size_t i = 0; i < oldSlots.size(); i++) {
+			if (oldUsed[i]) tryEmplace(oldSlots[i].first, oldSlots[i].second);
+		}
+	}
+
+	std::vector<std::pair<Key, Value>> slots{};
+	std::vector<uint8_t> used{};
+	size_t count = 0;
+	size_t mask = 0;
+	Hash hasher{};
+	KeyEqual equal{};
+};
+
+}  // namespace utils
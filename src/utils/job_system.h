@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+// Work stealing scheduler for short, CPU bound jobs that fan out over every core each frame, like
+// per object updates. Each worker owns a deque, it runs its own jobs newest first and steals the
+// oldest jobs of the other workers when it runs dry. A thread waiting on a counter runs jobs
+// instead of blocking, so jobs can schedule and wait on jobs of their own. Blocking work such as
+// file IO belongs on a ThreadPool.
+class JobSystem {
+   public:
+	// Jobs of a batch still pending, wait() returns once it drops to zero
+	class Counter {
+	   public:
+		Counter() = default;
+		Counter(const Counter &) = delete;
+		Counter &operator=(const Counter &) = delete;
+
+		bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+	   private:
+		std::atomic<uint32_t> pending{0};
+
+		friend class JobSystem;
+	};
+
+	explicit JobSystem(uint32_t workerCount = 0) {
+		if (workerCount == 0) {
+			workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		}
+		queues.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++) {
+			queues.push_back(std::make_unique<Queue>());
+		}
+		workers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++) {
+			workers.emplace_back([this, i]() { workerLoop(i); });
+		}
+	}
+
+	~JobSystem() {
+		{
+			std::lock_guard<std::mutex> lock{sleepMutex};
+			stopping = true;
+		}
+		sleepCondition.notify_all();
+		for (auto &worker : workers) {
+			worker.join();
+		}
+	}
+
+	JobSystem(const JobSystem &) = delete;
+	JobSystem &operator=(const JobSystem &) = delete;
+
+	// Jobs scheduled from a worker go to its own queue, others are spread over the workers
+	void schedule(Counter &counter, std::function<void()> fn) {
+		counter.pending.fetch_add(1, std::memory_order_relaxed);
+		queuedJobs.fetch_add(1, std::memory_order_release);
+		uint32_t queueIndex = currentQueue;
+		if (!isWorkerThread()) {
+			queueIndex = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+		}
+		{
+			std::lock_guard<std::mutex> lock{queues[queueIndex]->mutex};
+			queues[queueIndex]->jobs.push_back({std::move(fn), &counter});
+		}
+
+		// taking the lock orders this with a worker between checking for jobs and sleeping
+		{ std::lock_guard<std::mutex> lock{sleepMutex}; }
+		sleepCondition.notify_one();
+	}
+
+	// Runs queued jobs on the calling thread until every job of `counter` finished
+	void wait(Counter &counter) {
+		while (!counter.isDone()) {
+			Job job;
+			if (take(job)) {
+				execute(job);
+			} else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	// Calls fn(begin, end) for consecutive ranges of at most grainSize items covering [0, count),
+	// spread over the workers and the calling thread. Ranges that don't overlap may write to the
+	// same array without locking. Returns once every range is done.
+	template <typename Fn>
+	void parallelFor(uint32_t count, uint32_t grainSize, Fn &&fn) {
+		grainSize = std::max(grainSize, 1u);
+		if (count <= grainSize || queues.empty()) {
+			if (count > 0) fn(0u, count);
+			return;
+		}
+
+		Counter counter;
+		// the calling thread takes the first range itself
+		for (uint32_t begin = grainSize; begin < count;) {
+			uint32_t end = begin + std::min(grainSize, count - begin);
+			schedule(counter, [&fn, begin, end]() { fn(begin, end); });
+			begin = end;
+		}
+		fn(0u, grainSize);
+		wait(counter);
+	}
+
+	uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+	// Threads that can run jobs, the workers and the thread that waits on them
+	uint32_t getThreadCount() const { return getWorkerCount() + 1; }
+	// 1 + the worker's index on this system's workers, 0 on any other thread. Indexes per thread
+	// scratch data of getThreadCount() entries.
+	uint32_t getThreadIndex() const { return isWorkerThread() ? currentQueue + 1 : 0; }
+
+   private:
+	struct Job {
+		std::function<void()> fn;
+		Counter *counter = nullptr;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	bool isWorkerThread() const { return currentSystem == this; }
+
+	// Own queue newest first, then the oldest job of another queue
+	bool take(Job &job) {
+		if (queuedJobs.load(std::memory_order_acquire) == 0) return false;
+
+		uint32_t queueCount = static_cast<uint32_t>(queues.size());
+		uint32_t first = isWorkerThread() ? currentQueue : 0;
+		if (isWorkerThread()) {
+			auto &queue = *queues[first];
+			std::lock_guard<std::mutex> lock{queue.mutex};
+			if (!queue.jobs.empty()) {
+				job = std::move(queue.jobs.back());
+				queue.jobs.pop_back();
+				queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		for (uint32_t i = 1; i <= queueCount; i++) {
+			auto &queue = *queues[(first + i) % queueCount];
+			std::lock_guard<std::mutex> lock{queue.mutex};
+			if (!queue.jobs.empty()) {
+				job = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+				queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void execute(Job &job) {
+		job.fn();
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	void workerLoop(uint32_t queueIndex) {
+		currentSystem = this;
+		currentQueue = queueIndex;
+		while (true) {
+			Job job;
+			if (take(job)) {
+				execute(job);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock{sleepMutex};
+			sleepCondition.wait(lock, [this]() {
+				return stopping || queuedJobs.load(std::memory_order_acquire) > 0;
+			});
+			if (stopping && queuedJobs.load(std::memory_order_acquire) == 0) return;
+		}
+	}
+
+	// set on worker threads only
+	inline static thread_local const JobSystem *currentSystem = nullptr;
+	inline static thread_local uint32_t currentQueue = 0;
+
+	std::vector<std::unique_ptr<Queue>> queues{};
+	std::vector<std::thread> workers{};
+	std::atomic<uint32_t> queuedJobs{0};
+	std::atomic<uint32_t> nextQueue{0};
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	bool stopping = false;
+};
+
+}  // namespace utils
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+// Values keyed by small integer ids, kept densely packed so iterating them is a linear scan. A
+// sparse id -> slot table makes lookups O(1); erase() moves the last value into the hole, so slots
+// are not stable across erases but ids are.
+template <typename T>
+class SparseSet {
+   public:
+	static constexpr uint32_t INVALID_SLOT = std::numeric_limits<uint32_t>::max();
+
+	bool contains(uint32_t id) const { return id < slots.size() && slots[id] != INVALID_SLOT; }
+	size_t size() const { return values_.size(); }
+	bool empty() const { return values_.empty(); }
+
+	T &insert(uint32_t id, T value) {
+		if (contains(id)) {
+			return values_[slots[id]] = std::move(value);
+		}
+		if (id >= slots.size()) slots.resize(id + 1, INVALID_SLOT);
+		slots[id] = static_cast<uint32_t>(values_.size());
+		ids_.push_back(id);
+		values_.push_back(std::move(value));
+		return values_.back();
+	}
+
+	void erase(uint32_t id) {
+		if (!contains(id)) return;
+		uint32_t slot = slots[id];
+		uint32_t last = static_cast<uint32_t>(values_.size() - 1);
+		if (slot != last) {
+			values_[slot] = std::move(values_[last]);
+			ids_[slot] = ids_[last];
+			slots[ids_[slot]] = slot;
+		}
+		values_.pop_back();
+		ids_.pop_back();
+		slots[id] = INVALID_SLOT;
+	}
+
+	T *find(uint32_t id) { return contains(id) ? &values_[slots[id]] : nullptr; }
+	const T *find(uint32_t id) const { return contains(id) ? &values_[slots[id]] : nullptr; }
+
+	// Dense storage, ids()[i] owns values()[i]
+	const std::vector<uint32_t> &ids() const { return ids_; }
+	std::vector<T> &values() { return values_; }
+	const std::vector<T> &values() const { return values_; }
+
+   private:
+	std::vector<uint32_t> slots{};
+	std::vector<uint32_t> ids_{};
+	std::vector<T> values_{};
+};
+
+}  // namespace utils
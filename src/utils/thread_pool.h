@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+// Fixed set of worker threads pulling from one FIFO queue. Used for blocking, coarse grained work
+// (file IO, parsing) that must stay off the render thread.
+class ThreadPool {
+   public:
+	explicit ThreadPool(uint32_t workerCount = 0) {
+		if (workerCount == 0) {
+			workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		}
+		workers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++) {
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			stopping = true;
+		}
+		condition.notify_all();
+		for (auto &worker : workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	template <typename Fn>
+	std::future<std::invoke_result_t<Fn>> submit(Fn &&fn) {
+		using Result = std::invoke_result_t<Fn>;
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+		std::future<Result> future = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			tasks.emplace_back([task]() { (*task)(); });
+		}
+		condition.notify_one();
+		return future;
+	}
+
+	uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+   private:
+	void workerLoop() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock{mutex};
+				condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (stopping && tasks.empty()) return;
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::vector<std::thread> workers{};
+	std::deque<std::function<void()>> tasks{};
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+};
+
+}  // namespace utils